@@ -0,0 +1,319 @@
+/*
+  ==============================================================================
+
+    CaptureRecorder.cpp
+    Created: 5 Aug 2022 7:31:12pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "CaptureRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    //Black, white, dark grey and light grey, indexed by plane 0's bit | plane 1's bit << 1, like FramebufferRenderer
+    constexpr std::array<uint8_t, 4> planeLuma {0x00, 0xFF, 0x55, 0xD3};
+
+    void writeLittleEndian(std::FILE* file, uint32_t value, int numBytes)
+    {
+        for(int byte = 0; byte < numBytes; ++byte)
+        {
+            std::fputc(int((value >> (byte * 8)) & 0xFF), file);
+        }
+    }
+}
+
+CaptureRecorder::~CaptureRecorder()
+{
+    stop();
+}
+
+bool CaptureRecorder::start(const std::string& videoPath, const std::string& audioPath, int scale, double sampleRate)
+{
+    stop();
+
+    videoFile = std::fopen(videoPath.c_str(), "wb");
+
+    if(videoFile == nullptr)
+    {
+        return false;
+    }
+
+    //No audio device, no audio file
+    if(sampleRate > 0.0)
+    {
+        audioFile = std::fopen(audioPath.c_str(), "wb");
+
+        if(audioFile == nullptr)
+        {
+            std::fclose(videoFile);
+            videoFile = nullptr;
+            return false;
+        }
+    }
+
+    videoScale = std::max(scale, 1);
+    const int width = Chip8Core::maxWidthPixels * videoScale;
+    const int height = Chip8Core::maxHeightPixels * videoScale;
+
+    std::fprintf(videoFile, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", width, height);
+
+    lumaRow.assign(size_t(width), 0);
+    chroma.assign(size_t(width / 2) * size_t(height / 2) * 2, 0x80);
+
+    audioSampleRate = uint32_t(sampleRate);
+    samplesWritten = 0;
+
+    if(audioFile != nullptr)
+    {
+        //The sizes are filled in by stop()
+        writeWavHeader(0);
+    }
+
+    frameRing.resize(frameRingCapacity);
+    audioRing.assign(audioRingCapacity, 0.0f);
+
+    frameWriteIndex = 0;
+    frameReadIndex = 0;
+    audioWriteIndex = 0;
+    audioReadIndex = 0;
+    droppedFrames = 0;
+    droppedSamples = 0;
+
+    stopRequested = false;
+    writerThread = std::thread([this]()
+    {
+        writerLoop();
+    });
+
+    acceptingAudio = audioFile != nullptr;
+    return true;
+}
+
+void CaptureRecorder::stop()
+{
+    if(videoFile == nullptr)
+    {
+        return;
+    }
+
+    //Once no push is in flight the audio thread can't touch the ring again
+    acceptingAudio = false;
+
+    while(audioPushing)
+    {
+        std::this_thread::yield();
+    }
+
+    stopRequested = true;
+    writerThread.join();
+
+    //Both producers have stopped by now, so anything left is safe to take
+    writeAvailableFrames();
+    std::fclose(videoFile);
+    videoFile = nullptr;
+
+    if(audioFile != nullptr)
+    {
+        writeAvailableAudio();
+
+        std::fseek(audioFile, 0, SEEK_SET);
+        writeWavHeader(uint32_t(samplesWritten));
+
+        std::fclose(audioFile);
+        audioFile = nullptr;
+    }
+}
+
+void CaptureRecorder::pushFrame(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels)
+{
+    if(videoFile == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t write = frameWriteIndex.load(std::memory_order_relaxed);
+
+    if(write - frameReadIndex.load(std::memory_order_acquire) >= frameRingCapacity)
+    {
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    PackedFrame& frame = frameRing[write & (frameRingCapacity - 1)];
+    frame.hiRes = widthPixels > Chip8Core::loResWidthPixels;
+
+    const int wordsPerRow = frame.hiRes ? Chip8Core::wordsPerPlane : 1;
+    size_t numWords = 0;
+    uint64_t secondPlaneBits = 0;
+
+    for(int row = 0; row < heightPixels; ++row)
+    {
+        for(int word = 0; word < wordsPerRow; ++word)
+        {
+            frame.words[numWords++] = framebuffer[row][word];
+            secondPlaneBits |= framebuffer[row][Chip8Core::wordsPerPlane + word];
+        }
+    }
+
+    frame.hasSecondPlane = secondPlaneBits != 0;
+
+    if(frame.hasSecondPlane)
+    {
+        for(int row = 0; row < heightPixels; ++row)
+        {
+            for(int word = 0; word < wordsPerRow; ++word)
+            {
+                frame.words[numWords++] = framebuffer[row][Chip8Core::wordsPerPlane + word];
+            }
+        }
+    }
+
+    frameWriteIndex.store(write + 1, std::memory_order_release);
+}
+
+void CaptureRecorder::pushAudio(const float* samples, int numSamples)
+{
+    audioPushing = true;
+
+    if(acceptingAudio)
+    {
+        const uint64_t write = audioWriteIndex.load(std::memory_order_relaxed);
+        const uint64_t space = audioRingCapacity - (write - audioReadIndex.load(std::memory_order_acquire));
+        const uint64_t numToCopy = std::min(uint64_t(numSamples), space);
+
+        //At most two runs, either side of the wrap
+        const uint64_t firstIndex = write & (audioRingCapacity - 1);
+        const uint64_t firstCount = std::min(numToCopy, audioRingCapacity - firstIndex);
+
+        std::memcpy(audioRing.data() + firstIndex, samples, firstCount * sizeof(float));
+        std::memcpy(audioRing.data(), samples + firstCount, (numToCopy - firstCount) * sizeof(float));
+
+        audioWriteIndex.store(write + numToCopy, std::memory_order_release);
+
+        if(numToCopy < uint64_t(numSamples))
+        {
+            droppedSamples.fetch_add(uint64_t(numSamples) - numToCopy, std::memory_order_relaxed);
+        }
+    }
+
+    audioPushing = false;
+}
+
+void CaptureRecorder::writerLoop()
+{
+    while(!stopRequested)
+    {
+        const bool wroteFrames = writeAvailableFrames();
+        const bool wroteAudio = audioFile != nullptr && writeAvailableAudio();
+
+        if(!wroteFrames && !wroteAudio)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool CaptureRecorder::writeAvailableFrames()
+{
+    uint64_t read = frameReadIndex.load(std::memory_order_relaxed);
+    const uint64_t write = frameWriteIndex.load(std::memory_order_acquire);
+
+    if(read == write)
+    {
+        return false;
+    }
+
+    for(; read != write; ++read)
+    {
+        writeFrame(frameRing[read & (frameRingCapacity - 1)]);
+
+        //Hand each slot back as soon as it's written, the ring is only a second long
+        frameReadIndex.store(read + 1, std::memory_order_release);
+    }
+
+    return true;
+}
+
+bool CaptureRecorder::writeAvailableAudio()
+{
+    const uint64_t read = audioReadIndex.load(std::memory_order_relaxed);
+    const uint64_t write = audioWriteIndex.load(std::memory_order_acquire);
+
+    if(read == write)
+    {
+        return false;
+    }
+
+    for(uint64_t index = read; index != write; ++index)
+    {
+        const float sample = std::clamp(audioRing[index & (audioRingCapacity - 1)], -1.0f, 1.0f);
+        writeLittleEndian(audioFile, uint32_t(int16_t(sample * 32767.0f)), 2);
+    }
+
+    samplesWritten += write - read;
+    audioReadIndex.store(write, std::memory_order_release);
+    return true;
+}
+
+void CaptureRecorder::writeFrame(const PackedFrame& frame)
+{
+    const int wordsPerRow = frame.hiRes ? Chip8Core::wordsPerPlane : 1;
+    const int numRows = frame.hiRes ? Chip8Core::maxHeightPixels : Chip8Core::loResHeightPixels;
+    const int rowPixels = wordsPerRow * 64;
+    const int pixelSize = frame.hiRes ? videoScale : videoScale * 2;
+    const size_t secondPlaneOffset = size_t(numRows) * size_t(wordsPerRow);
+
+    std::fputs("FRAME\n", videoFile);
+
+    for(int row = 0; row < numRows; ++row)
+    {
+        const uint64_t* firstPlane = frame.words.data() + row * wordsPerRow;
+        const uint64_t* secondPlane = firstPlane + secondPlaneOffset;
+
+        for(int x = 0; x < rowPixels; ++x)
+        {
+            const int shift = 63 - (x % 64);
+            int planes = int((firstPlane[x / 64] >> shift) & 1);
+
+            if(frame.hasSecondPlane)
+            {
+                planes |= int((secondPlane[x / 64] >> shift) & 1) << 1;
+            }
+
+            std::memset(lumaRow.data() + x * pixelSize, planeLuma[planes], size_t(pixelSize));
+        }
+
+        for(int repeat = 0; repeat < pixelSize; ++repeat)
+        {
+            std::fwrite(lumaRow.data(), 1, lumaRow.size(), videoFile);
+        }
+    }
+
+    std::fwrite(chroma.data(), 1, chroma.size(), videoFile);
+}
+
+void CaptureRecorder::writeWavHeader(uint32_t numSamples)
+{
+    const uint32_t dataBytes = numSamples * 2;
+
+    std::fwrite("RIFF", 1, 4, audioFile);
+    writeLittleEndian(audioFile, 36 + dataBytes, 4);
+    std::fwrite("WAVEfmt ", 1, 8, audioFile);
+
+    //PCM, mono, 16 bit
+    writeLittleEndian(audioFile, 16, 4);
+    writeLittleEndian(audioFile, 1, 2);
+    writeLittleEndian(audioFile, 1, 2);
+    writeLittleEndian(audioFile, audioSampleRate, 4);
+    writeLittleEndian(audioFile, audioSampleRate * 2, 4);
+    writeLittleEndian(audioFile, 2, 2);
+    writeLittleEndian(audioFile, 16, 2);
+
+    std::fwrite("data", 1, 4, audioFile);
+    writeLittleEndian(audioFile, dataBytes, 4);
+}
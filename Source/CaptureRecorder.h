@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    CaptureRecorder.h
+    Created: 5 Aug 2022 7:31:12pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Core.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Writes two files side by side:
+
+        video   Uncompressed YUV4MPEG2, 4:2:0 with flat chroma, 60 frames a second. Always the
+                hi-res screen's shape scaled up, lo-res frames get pixels twice the size.
+                XO-CHIP's plane colours are shown in grey as the renderer does
+        audio   16 bit mono PCM WAV at the audio device's rate
+
+    Both play back with anything built on ffmpeg.
+*/
+
+//Records the frames shown and the beeper to disk. Each frame is packed down to the words on screen and
+//each block of samples copied into single producer rings, which a background thread scales and writes
+//out, so neither the frame timer nor the audio callback ever waits on it. A full ring drops what didn't fit
+class CaptureRecorder
+{
+public:
+    CaptureRecorder() {};
+    ~CaptureRecorder();
+
+    CaptureRecorder(const CaptureRecorder&) = delete;
+    CaptureRecorder& operator=(const CaptureRecorder&) = delete;
+
+    //Each CHIP-8 pixel becomes scale by scale video pixels in hi-res
+    bool start(const std::string& videoPath, const std::string& audioPath, int scale, double sampleRate);
+
+    //Writes out everything still in the rings and closes the files
+    void stop();
+
+    bool getIsRecording() const {return videoFile != nullptr;}
+
+    uint64_t getDroppedFrameCount() const {return droppedFrames.load(std::memory_order_relaxed);}
+    uint64_t getDroppedSampleCount() const {return droppedSamples.load(std::memory_order_relaxed);}
+
+    //Frame timer thread only, the same one that calls start() and stop()
+    void pushFrame(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels);
+
+    //Audio thread only, does nothing while not recording
+    void pushAudio(const float* samples, int numSamples);
+
+private:
+    struct PackedFrame
+    {
+        //The words of each row on screen, plane 0's rows then plane 1's if it has anything lit.
+        //A lo-res CHIP-8 frame is 32 of them, 256 bytes
+        std::array<uint64_t, Chip8Core::numPlanes * Chip8Core::maxHeightPixels * Chip8Core::wordsPerPlane> words;
+        bool hiRes;
+        bool hasSecondPlane;
+    };
+
+    static constexpr size_t frameRingCapacity = 64;
+    static constexpr size_t audioRingCapacity = 1 << 17;
+
+    void writerLoop();
+
+    //Write everything the producers have published so far, return false if there was nothing
+    bool writeAvailableFrames();
+    bool writeAvailableAudio();
+
+    void writeFrame(const PackedFrame& frame);
+    void writeWavHeader(uint32_t numSamples);
+
+    std::vector<PackedFrame> frameRing;
+    std::atomic<uint64_t> frameWriteIndex {0};
+    std::atomic<uint64_t> frameReadIndex {0};
+
+    std::vector<float> audioRing;
+    std::atomic<uint64_t> audioWriteIndex {0};
+    std::atomic<uint64_t> audioReadIndex {0};
+
+    //stop() waits for a push already past the check to finish before tearing the ring down
+    std::atomic<bool> acceptingAudio {false};
+    std::atomic<bool> audioPushing {false};
+
+    std::atomic<uint64_t> droppedFrames {0};
+    std::atomic<uint64_t> droppedSamples {0};
+
+    std::FILE* videoFile = nullptr;
+    std::FILE* audioFile = nullptr;
+    int videoScale = 1;
+    uint32_t audioSampleRate = 0;
+    uint64_t samplesWritten = 0;
+
+    //Writer thread scratch, one scaled row of luma and a frame's worth of flat chroma
+    std::vector<uint8_t> lumaRow;
+    std::vector<uint8_t> chroma;
+
+    std::thread writerThread;
+    std::atomic<bool> stopRequested {false};
+};
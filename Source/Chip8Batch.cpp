@@ -0,0 +1,676 @@
+/*
+  ==============================================================================
+
+    Chip8Batch.cpp
+    Created: 4 Jun 2022 10:02:18am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "Chip8Batch.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+
+namespace
+{
+    template <typename Function>
+    inline void forEachInstance(const uint32_t* instances, int count, Function&& function)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            function(instances[i]);
+        }
+    }
+
+    //References, so X or Y being VF behaves exactly as it does in the core. The flag is written last
+    inline void executeAluOpcode(uint16_t opcode, uint8_t& vx, uint8_t& vy, uint8_t& vf)
+    {
+        const uint8_t nn = 0x00FF & opcode;
+
+        if((0xF000 & opcode) == 0x6000)
+        {
+            vx = nn;
+            return;
+        }
+
+        if((0xF000 & opcode) == 0x7000)
+        {
+            vx += nn;
+            return;
+        }
+
+        uint8_t flag;
+
+        switch(0x000F & opcode)
+        {
+            case 0x0: vx = vy; return;
+            case 0x1: vx |= vy; return;
+            case 0x2: vx &= vy; return;
+            case 0x3: vx ^= vy; return;
+            case 0x4: flag = (vx + vy) > 0xFF; vx += vy; break;
+            case 0x5: flag = vy <= vx; vx -= vy; break;
+            case 0x6: flag = vx & 0x1; vx >>= 1; break;
+            case 0x7: flag = vx <= vy; vx = vy - vx; break;
+            default:  flag = (vx & 0x80) >> 7; vx <<= 1; break;
+        }
+
+        vf = flag;
+    }
+}
+
+Chip8Batch::Chip8Batch(int numInstances, int numThreads)  : numInstances(std::max(numInstances, 1))
+{
+    numShards = (this->numInstances + instancesPerShard - 1) / instancesPerShard;
+
+    if(numThreads <= 0)
+    {
+        numThreads = int(std::thread::hardware_concurrency());
+    }
+
+    //No point having more threads than there are shards to hand out
+    pool = std::make_unique<WorkStealingPool>(std::min(numThreads, numShards));
+
+    const size_t n = size_t(this->numInstances);
+
+    vRegisters.assign(16 * n, 0);
+    indexRegisters.assign(n, 0);
+    programCounters.assign(n, programStart);
+    stacks.assign(16 * n, 0);
+    stackPointers.assign(n, 0);
+    delayTimers.assign(n, 0);
+    soundTimers.assign(n, 0);
+    keyStates.assign(n, 0);
+    waitingForKey.assign(n, 0);
+    keyWaitRegisters.assign(n, 0);
+    randomStates.assign(n, 0);
+    unknownOpcodes.resize(n);
+    memory.assign(memorySize * n, 0);
+    framebuffers.assign(size_t(heightPixels) * n, 0);
+    dirtyRows.assign(n, ~uint32_t(0));
+    runningInstances.assign(n, 0);
+
+    std::random_device randomDevice;
+
+    for(int instance = 0; instance < this->numInstances; ++instance)
+    {
+        setSeed(instance, randomDevice());
+        load(instance, nullptr, 0);
+    }
+}
+
+void Chip8Batch::load(const uint8_t* programData, size_t programSize)
+{
+    for(int instance = 0; instance < numInstances; ++instance)
+    {
+        load(instance, programData, programSize);
+    }
+
+    cyclesThisFrame = 0;
+}
+
+void Chip8Batch::load(int instance, const uint8_t* programData, size_t programSize)
+{
+    //Reset System State
+    programCounters[instance] = programStart;
+    indexRegisters[instance] = 0;
+    stackPointers[instance] = 0;
+
+    for(int level = 0; level < 16; ++level)
+    {
+        vRegister(level, instance) = 0;
+        stacks[size_t(level) * numInstances + instance] = 0;
+    }
+
+    delayTimers[instance] = 0;
+    soundTimers[instance] = 0;
+    waitingForKey[instance] = 0;
+
+    uint8_t* instanceMemory = memory.data() + size_t(instance) * memorySize;
+    std::fill(instanceMemory, instanceMemory + memorySize, 0);
+
+    const auto fontset = Chip8Core::getFontset();
+    std::copy(fontset.cbegin(), fontset.cend(), instanceMemory);
+
+    const auto hiResFontset = Chip8Core::getHiResFontset();
+    std::copy(hiResFontset.cbegin(), hiResFontset.cend(), instanceMemory + Chip8Core::hiResFontStart);
+
+    //Anything past the end of memory is dropped
+    programSize = std::min(programSize, memorySize - programStart);
+    std::copy(programData, programData + programSize, instanceMemory + programStart);
+
+    uint64_t* framebuffer = framebuffers.data() + size_t(instance) * heightPixels;
+    std::fill(framebuffer, framebuffer + heightPixels, 0);
+    dirtyRows[instance] = ~uint32_t(0);
+
+    unknownOpcodes[instance].clear();
+}
+
+void Chip8Batch::setSeed(int instance, uint32_t seed)
+{
+    //Spread the seed out, xorshift gets stuck on zero
+    const uint32_t state = seed * 0x9E3779B1u + 0x7F4A7C15u;
+    randomStates[instance] = state != 0 ? state : 1;
+}
+
+void Chip8Batch::setCyclesPerFrame(int newCyclesPerFrame)
+{
+    cyclesPerFrame = std::max(newCyclesPerFrame, 1);
+    cyclesThisFrame = std::min(cyclesThisFrame, cyclesPerFrame - 1);
+}
+
+void Chip8Batch::runCycles(int numCycles)
+{
+    if(numCycles <= 0)
+    {
+        return;
+    }
+
+    const int firstFrameCycle = cyclesThisFrame;
+
+    //Shards never share an instance, so each can run every cycle on its own before syncing up
+    pool->parallelFor(numShards, [this, numCycles, firstFrameCycle](int shard)
+    {
+        runShard(shard, numCycles, firstFrameCycle);
+    });
+
+    cyclesThisFrame = int((int64_t(firstFrameCycle) + numCycles) % cyclesPerFrame);
+}
+
+void Chip8Batch::runFrames(int numFrames)
+{
+    if(numFrames > 0)
+    {
+        runCycles(numFrames * cyclesPerFrame - cyclesThisFrame);
+    }
+}
+
+void Chip8Batch::setKeyState(int instance, uint16_t newKeyState)
+{
+    const uint16_t newlyPressed = newKeyState & ~keyStates[instance];
+
+    keyStates[instance] = newKeyState;
+
+    if(waitingForKey[instance] != 0 && newlyPressed != 0)
+    {
+        //Take the lowest key that went down
+        uint8_t key = 0;
+
+        while((newlyPressed & (1 << key)) == 0)
+        {
+            ++key;
+        }
+
+        vRegister(keyWaitRegisters[instance], instance) = key;
+        waitingForKey[instance] = 0;
+    }
+}
+
+bool Chip8Batch::getPixel(int instance, int x, int y) const
+{
+    return ((getFramebuffer(instance)[y] >> (63 - x)) & 0x1) != 0;
+}
+
+uint32_t Chip8Batch::takeDirtyRows(int instance)
+{
+    const uint32_t rows = dirtyRows[instance];
+    dirtyRows[instance] = 0;
+    return rows;
+}
+
+void Chip8Batch::runShard(int shard, int numCycles, int firstFrameCycle)
+{
+    const uint32_t begin = uint32_t(shard) * instancesPerShard;
+    const uint32_t end = std::min(begin + instancesPerShard, uint32_t(numInstances));
+
+    uint32_t* running = runningInstances.data() + begin;
+
+    int frameCycle = firstFrameCycle;
+
+    //Lockstep while every running instance is on the same opcode, as when they start from one state with the same keys
+    for(int cycle = 0; cycle < numCycles; ++cycle)
+    {
+        int count = 0;
+        bool allSame = true;
+        uint16_t opcode = 0;
+
+        for(uint32_t instance = begin; instance < end && allSame; ++instance)
+        {
+            if(waitingForKey[instance] != 0)
+            {
+                continue;
+            }
+
+            const uint16_t programCounter = programCounters[instance];
+            const uint16_t instanceOpcode = uint16_t((memoryAt(instance, programCounter) << 8) | memoryAt(instance, programCounter + 1u));
+
+            allSame = count == 0 || instanceOpcode == opcode;
+            opcode = instanceOpcode;
+            running[count++] = instance;
+        }
+
+        //Once they differ each instance runs the rest of the cycles alone, so its state stays in cache and the branches
+        //predict. Grouping every cycle costs more than the decoding it shares
+        if(!allSame)
+        {
+            for(uint32_t instance = begin; instance < end; ++instance)
+            {
+                runInstance(instance, numCycles - cycle, frameCycle);
+            }
+
+            return;
+        }
+
+        if(count > 0)
+        {
+            executeGroup(opcode, running, count);
+        }
+
+        if(++frameCycle >= cyclesPerFrame)
+        {
+            frameCycle = 0;
+            updateTimers(begin, end);
+        }
+    }
+}
+
+void Chip8Batch::runInstance(uint32_t instance, int numCycles, int firstFrameCycle)
+{
+    int frameCycle = firstFrameCycle;
+
+    for(int cycle = 0; cycle < numCycles; ++cycle)
+    {
+        if(waitingForKey[instance] == 0)
+        {
+            const uint16_t programCounter = programCounters[instance];
+            const uint16_t opcode = uint16_t((memoryAt(instance, programCounter) << 8) | memoryAt(instance, programCounter + 1u));
+
+            executeGroup(opcode, &instance, 1);
+        }
+
+        if(++frameCycle >= cyclesPerFrame)
+        {
+            frameCycle = 0;
+            updateTimers(instance, instance + 1);
+        }
+    }
+}
+
+void Chip8Batch::executeGroup(uint16_t opcode, const uint32_t* instances, int count)
+{
+    //Decoded once for the whole group
+    const uint8_t x = (0x0F00 & opcode) >> 8;
+    const uint8_t y = (0x00F0 & opcode) >> 4;
+    const uint8_t n = 0x000F & opcode;
+    const uint8_t nn = 0x00FF & opcode;
+    const uint16_t nnn = 0x0FFF & opcode;
+
+    switch(0xF000 & opcode)
+    {
+        case 0x0000:
+        {
+            if(opcode == 0x00E0)
+            {
+                forEachInstance(instances, count, [this](uint32_t instance)
+                {
+                    uint64_t* framebuffer = framebuffers.data() + size_t(instance) * heightPixels;
+                    std::fill(framebuffer, framebuffer + heightPixels, 0);
+                    dirtyRows[instance] = ~uint32_t(0);
+                    programCounters[instance] += 2;
+                });
+
+                return;
+            }
+
+            if(opcode == 0x00EE)
+            {
+                //The stack wraps rather than letting one instance write into another's
+                forEachInstance(instances, count, [this](uint32_t instance)
+                {
+                    stackPointers[instance] = (stackPointers[instance] - 1) & 0xF;
+                    programCounters[instance] = stacks[size_t(stackPointers[instance]) * numInstances + instance] + 2;
+                });
+
+                return;
+            }
+
+            break;
+        }
+
+        case 0x1000:
+        {
+            forEachInstance(instances, count, [this, nnn](uint32_t instance)
+            {
+                programCounters[instance] = nnn;
+            });
+
+            return;
+        }
+
+        case 0x2000:
+        {
+            forEachInstance(instances, count, [this, nnn](uint32_t instance)
+            {
+                stacks[size_t(stackPointers[instance]) * numInstances + instance] = programCounters[instance];
+                stackPointers[instance] = (stackPointers[instance] + 1) & 0xF;
+                programCounters[instance] = nnn;
+            });
+
+            return;
+        }
+
+        case 0x3000:
+        {
+            forEachInstance(instances, count, [this, x, nn](uint32_t instance)
+            {
+                skipNextInstructionIf(instance, vRegister(x, instance) == nn);
+            });
+
+            return;
+        }
+
+        case 0x4000:
+        {
+            forEachInstance(instances, count, [this, x, nn](uint32_t instance)
+            {
+                skipNextInstructionIf(instance, vRegister(x, instance) != nn);
+            });
+
+            return;
+        }
+
+        case 0x5000:
+        {
+            forEachInstance(instances, count, [this, x, y](uint32_t instance)
+            {
+                skipNextInstructionIf(instance, vRegister(x, instance) == vRegister(y, instance));
+            });
+
+            return;
+        }
+
+        case 0x6000:
+        case 0x7000:
+        case 0x8000:
+        {
+            if((0xF000 & opcode) == 0x8000 && n > 0x7 && n != 0xE)
+            {
+                break;
+            }
+
+            forEachInstance(instances, count, [this, opcode, x, y](uint32_t instance)
+            {
+                executeAluOpcode(opcode, vRegister(x, instance), vRegister(y, instance), vRegister(0xF, instance));
+                programCounters[instance] += 2;
+            });
+
+            return;
+        }
+
+        case 0x9000:
+        {
+            forEachInstance(instances, count, [this, x, y](uint32_t instance)
+            {
+                skipNextInstructionIf(instance, vRegister(x, instance) != vRegister(y, instance));
+            });
+
+            return;
+        }
+
+        case 0xA000:
+        {
+            forEachInstance(instances, count, [this, nnn](uint32_t instance)
+            {
+                indexRegisters[instance] = nnn;
+                programCounters[instance] += 2;
+            });
+
+            return;
+        }
+
+        case 0xB000:
+        {
+            forEachInstance(instances, count, [this, nnn](uint32_t instance)
+            {
+                programCounters[instance] = nnn + vRegister(0, instance);
+            });
+
+            return;
+        }
+
+        case 0xC000:
+        {
+            forEachInstance(instances, count, [this, x, nn](uint32_t instance)
+            {
+                vRegister(x, instance) = nextRandom(instance) & nn;
+                programCounters[instance] += 2;
+            });
+
+            return;
+        }
+
+        case 0xD000:
+        {
+            forEachInstance(instances, count, [this, x, y, n](uint32_t instance)
+            {
+                drawSprite(instance, vRegister(x, instance), vRegister(y, instance), n);
+                programCounters[instance] += 2;
+            });
+
+            return;
+        }
+
+        case 0xE000:
+        {
+            if(nn != 0x9E && nn != 0xA1)
+            {
+                break;
+            }
+
+            const bool skipIfDown = nn == 0x9E;
+
+            forEachInstance(instances, count, [this, x, skipIfDown](uint32_t instance)
+            {
+                const uint8_t key = vRegister(x, instance);
+                const bool down = key < 16 && (keyStates[instance] & (1 << key)) != 0;
+
+                skipNextInstructionIf(instance, key < 16 && down == skipIfDown);
+            });
+
+            return;
+        }
+
+        case 0xF000:
+        {
+            switch(nn)
+            {
+                case 0x07:
+                {
+                    forEachInstance(instances, count, [this, x](uint32_t instance)
+                    {
+                        vRegister(x, instance) = delayTimers[instance];
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                case 0x0A:
+                {
+                    //Stop fetching until setKeyState() sees a key go down
+                    forEachInstance(instances, count, [this, x](uint32_t instance)
+                    {
+                        waitingForKey[instance] = 1;
+                        keyWaitRegisters[instance] = x;
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                case 0x15:
+                {
+                    forEachInstance(instances, count, [this, x](uint32_t instance)
+                    {
+                        delayTimers[instance] = vRegister(x, instance);
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                case 0x18:
+                {
+                    forEachInstance(instances, count, [this, x](uint32_t instance)
+                    {
+                        soundTimers[instance] = vRegister(x, instance);
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                case 0x1E:
+                {
+                    forEachInstance(instances, count, [this, x](uint32_t instance)
+                    {
+                        indexRegisters[instance] += vRegister(x, instance);
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                case 0x29:
+                {
+                    forEachInstance(instances, count, [this, x](uint32_t instance)
+                    {
+                        indexRegisters[instance] = vRegister(x, instance) * 0x5;
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                case 0x33:
+                {
+                    forEachInstance(instances, count, [this, x](uint32_t instance)
+                    {
+                        const uint8_t value = vRegister(x, instance);
+                        const uint16_t address = indexRegisters[instance];
+
+                        memoryAt(instance, address)      = value / 100;
+                        memoryAt(instance, address + 1u) = (value / 10) % 10;
+                        memoryAt(instance, address + 2u) = value % 10;
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                case 0x55:
+                case 0x65:
+                {
+                    const bool save = nn == 0x55;
+
+                    forEachInstance(instances, count, [this, x, save](uint32_t instance)
+                    {
+                        const uint16_t address = indexRegisters[instance];
+
+                        for(int registerIndex = 0; registerIndex <= x; ++registerIndex)
+                        {
+                            if(save)
+                            {
+                                memoryAt(instance, address + registerIndex) = vRegister(registerIndex, instance);
+                            }
+                            else
+                            {
+                                vRegister(registerIndex, instance) = memoryAt(instance, address + registerIndex);
+                            }
+                        }
+
+                        programCounters[instance] += 2;
+                    });
+
+                    return;
+                }
+
+                default:
+                {
+                    break;
+                }
+            }
+
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+
+    //Unrecognised, step over it like the core does
+    forEachInstance(instances, count, [this, opcode](uint32_t instance)
+    {
+        unknownOpcodes[instance].record(opcode);
+        programCounters[instance] += 2;
+    });
+}
+
+void Chip8Batch::updateTimers(uint32_t begin, uint32_t end)
+{
+    for(uint32_t instance = begin; instance < end; ++instance)
+    {
+        delayTimers[instance] -= delayTimers[instance] > 0;
+        soundTimers[instance] -= soundTimers[instance] > 0;
+    }
+}
+
+void Chip8Batch::skipNextInstructionIf(uint32_t instance, bool condition)
+{
+    programCounters[instance] += condition ? 4 : 2;
+}
+
+void Chip8Batch::drawSprite(uint32_t instance, uint8_t xPos, uint8_t yPos, uint8_t height)
+{
+    uint64_t* framebuffer = framebuffers.data() + size_t(instance) * heightPixels;
+    const uint16_t spriteAddress = indexRegisters[instance];
+
+    //The start position wraps, anything running off the edge is clipped
+    const int x = xPos % widthPixels;
+    const int startY = yPos % heightPixels;
+    const int endY = std::min(startY + int(height), heightPixels);
+
+    if(endY <= startY)
+    {
+        vRegister(0xF, instance) = 0;
+        return;
+    }
+
+    uint8_t collision = 0;
+
+    for(int y = startY; y < endY; ++y)
+    {
+        const uint64_t spriteBits = (uint64_t(memoryAt(instance, spriteAddress + uint32_t(y - startY))) << 56) >> x;
+
+        collision |= (framebuffer[y] & spriteBits) != 0;
+        framebuffer[y] ^= spriteBits;
+    }
+
+    dirtyRows[instance] |= ((uint32_t(1) << (endY - startY)) - 1) << startY;
+    vRegister(0xF, instance) = collision;
+}
+
+uint8_t Chip8Batch::nextRandom(uint32_t instance)
+{
+    //xorshift32, small enough to keep one per instance
+    uint32_t state = randomStates[instance];
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    randomStates[instance] = state;
+
+    return uint8_t(state >> 24);
+}
@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    Chip8Batch.h
+    Created: 4 Jun 2022 10:02:18am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Core.h"
+#include "WorkStealingPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//Many CHIP-8 machines stepped in lockstep, for ROM corpus runs and training agents.
+//State is stored structure-of-arrays, so the same register of every instance sits together.
+//While every instance in a shard is on the same opcode it's decoded once for all of them. Once they split up, each runs the
+//rest of the call on its own like a separate core would.
+//Only the original CHIP-8 instruction set is supported, with the same behaviour as Chip8Core's chip8 profile
+class Chip8Batch
+{
+public:
+    static constexpr uint16_t programStart = Chip8Core::programStart;
+    static constexpr size_t memorySize = Chip8Core::memorySize;
+    static constexpr int widthPixels = Chip8Core::loResWidthPixels;
+    static constexpr int heightPixels = Chip8Core::loResHeightPixels;
+
+    //Instances are split into shards of this size, a shard is the unit of work handed to the pool
+    static constexpr int instancesPerShard = 64;
+
+    //0 threads uses one per hardware thread
+    explicit Chip8Batch(int numInstances, int numThreads = 0);
+
+    int getNumInstances() const {return numInstances;}
+
+    //Loads the same program into every instance, or into just one
+    void load(const uint8_t* programData, size_t programSize);
+    void load(int instance, const uint8_t* programData, size_t programSize);
+
+    //CXNN draws from a per-instance generator, seeding it makes a run repeatable
+    void setSeed(int instance, uint32_t seed);
+
+    void setCyclesPerFrame(int newCyclesPerFrame);
+    int getCyclesPerFrame() const {return cyclesPerFrame;}
+
+    //Every instance runs the same number of instructions, the timers tick every cyclesPerFrame of them
+    void runCycles(int numCycles);
+
+    //Runs up to the end of the numFrames-th timer tick from now
+    void runFrames(int numFrames);
+
+    //Bit n is set while key n is held down
+    void setKeyState(int instance, uint16_t newKeyState);
+    uint16_t getKeyState(int instance) const {return keyStates[instance];}
+
+    //One word per row, the leftmost pixel is the most significant bit
+    const uint64_t* getFramebuffer(int instance) const {return framebuffers.data() + size_t(instance) * heightPixels;}
+    bool getPixel(int instance, int x, int y) const;
+
+    //Bit n is set if row n has been drawn to or cleared since the last call
+    uint32_t takeDirtyRows(int instance);
+
+    uint16_t getProgramCounter(int instance) const {return programCounters[instance];}
+    uint16_t getIndexRegister(int instance) const {return indexRegisters[instance];}
+    uint8_t getRegister(int instance, int registerIndex) const {return vRegisters[size_t(registerIndex) * numInstances + instance];}
+    const uint8_t* getMemory(int instance) const {return memory.data() + size_t(instance) * memorySize;}
+
+    bool isSoundActive(int instance) const {return soundTimers[instance] != 0;}
+    bool isWaitingForKey(int instance) const {return waitingForKey[instance] != 0;}
+
+    UnknownOpcodeTable& getUnknownOpcodes(int instance) {return unknownOpcodes[instance];}
+
+private:
+    void runShard(int shard, int numCycles, int firstFrameCycle);
+
+    //Runs one instance on its own, for when a shard's instances are on different opcodes
+    void runInstance(uint32_t instance, int numCycles, int firstFrameCycle);
+
+    //Executes one opcode on every listed instance
+    void executeGroup(uint16_t opcode, const uint32_t* instances, int count);
+
+    void updateTimers(uint32_t begin, uint32_t end);
+
+    uint8_t& vRegister(int registerIndex, uint32_t instance) {return vRegisters[size_t(registerIndex) * numInstances + instance];}
+    uint8_t& memoryAt(uint32_t instance, uint32_t address) {return memory[size_t(instance) * memorySize + (address & (memorySize - 1))];}
+
+    void skipNextInstructionIf(uint32_t instance, bool condition);
+    void drawSprite(uint32_t instance, uint8_t xPos, uint8_t yPos, uint8_t height);
+    uint8_t nextRandom(uint32_t instance);
+
+    int numInstances;
+    int numShards;
+
+    std::unique_ptr<WorkStealingPool> pool;
+
+    //Registers, indexed [registerIndex * numInstances + instance]
+    std::vector<uint8_t> vRegisters;
+
+    std::vector<uint16_t> indexRegisters;
+    std::vector<uint16_t> programCounters;
+
+    //Indexed [level * numInstances + instance]
+    std::vector<uint16_t> stacks;
+    std::vector<uint8_t> stackPointers;
+
+    std::vector<uint8_t> delayTimers;
+    std::vector<uint8_t> soundTimers;
+
+    std::vector<uint16_t> keyStates;
+    std::vector<uint8_t> waitingForKey;
+    std::vector<uint8_t> keyWaitRegisters;
+
+    std::vector<uint32_t> randomStates;
+
+    std::vector<UnknownOpcodeTable> unknownOpcodes;
+
+    //Each instance's memory and framebuffer are contiguous
+    std::vector<uint8_t> memory;
+    std::vector<uint64_t> framebuffers;
+    std::vector<uint32_t> dirtyRows;
+
+    //Per instance scratch for the lockstep step, each shard only touches its own slice
+    std::vector<uint32_t> runningInstances;
+
+    int cyclesPerFrame = 1;
+    int cyclesThisFrame = 0;
+};
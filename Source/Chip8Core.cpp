@@ -0,0 +1,1668 @@
+/*
+  ==============================================================================
+
+    Chip8Core.cpp
+    Created: 2 May 2022 7:12:40pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "Chip8Core.h"
+#include "RecompiledProgram.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+//Define as 1 to fuse common sequences in the plain loop. Off by default, it costs more than it saves on the golden ROMs
+#ifndef CHIP8_FUSE_INSTRUCTIONS
+ #define CHIP8_FUSE_INSTRUCTIONS 0
+#endif
+
+Chip8Core::Chip8Core()  : randomGenerator(std::random_device()())
+{
+    load(nullptr, 0);
+}
+
+void Chip8Core::load(std::istream& programData)
+{
+    programData.unsetf(std::ios_base::skipws);
+
+    const std::vector<uint8_t> program {std::istream_iterator<uint8_t>(programData), std::istream_iterator<uint8_t>()};
+
+    load(program.data(), program.size());
+}
+
+void Chip8Core::load(const uint8_t* programData, size_t programSize)
+{
+    loadedProfile = profile;
+    memory.assign(isXoChip() ? xoChipMemorySize : memorySize, 0);
+    addressMask = uint32_t(memory.size() - 1);
+
+    //Load the fontsets
+    const auto fontset = getFontset();
+    std::copy(fontset.cbegin(), fontset.cend(), memory.begin());
+
+    const auto hiResFontset = getHiResFontset();
+    std::copy(hiResFontset.cbegin(), hiResFontset.cend(), memory.begin() + hiResFontStart);
+
+    //Load program into memory, anything past the end of memory is dropped
+    programSize = std::min(programSize, memory.size() - programStart);
+    std::copy(programData, programData + programSize, memory.begin() + programStart);
+
+    loadedProgramHash = chip8RecompiledHash(programData, programSize);
+
+    //Everything reset() goes back to, so it never needs the program again
+    bootMemory = Chip8PagedMemory().withChanges(memory, Chip8PagedMemory::allPages());
+    memoryPages = bootMemory;
+    changedPages = {};
+
+    resetMachine();
+}
+
+void Chip8Core::reset()
+{
+    //Only the pages written since the last load, fork, restore or reset can differ from the boot image
+    bootMemory.copyTo(memory, memoryPages, changedPages);
+    memoryPages = bootMemory;
+    changedPages = {};
+    addressMask = uint32_t(memory.size() - 1);
+
+    resetMachine();
+}
+
+void Chip8Core::resetMachine()
+{
+    programCounter = programStart;
+    currentOpcode = 0;
+    indexRegister = 0;
+    stackPointer = 0;
+
+    std::fill(vRegisters.begin(), vRegisters.end(), 0);
+    std::fill(stack.begin(), stack.end(), 0);
+
+    delayTimer = 0;
+    soundTimer = 0;
+
+    keyPressWaitFlag = false;
+    halted = false;
+
+    cyclesThisFrame = 0;
+    cycleCount = 0;
+    frameHash = 0;
+    pagesToHash = Chip8PagedMemory::allPages();
+    resetIdleLoopDetection();
+
+    //Slots are never given back otherwise, so a few ROMs in the table would fill up
+    unknownOpcodes.clear();
+
+    hiRes = false;
+    selectedPlanes = 1;
+    std::fill(framebuffer.begin(), framebuffer.end(), FramebufferRow {});
+    dirtyRows = allRows;
+
+    programModified = false;
+    updateRecompiledActive();
+}
+
+void Chip8Core::runCycle()
+{
+    bool ran;
+
+    if(debugger != nullptr)
+    {
+        ran = tracer != nullptr ? executeInstruction<true, true>() : executeInstruction<false, true>();
+    }
+    else
+    {
+        ran = tracer != nullptr ? executeInstruction<true, false>() : executeInstruction<false, false>();
+    }
+
+    if(!ran)
+    {
+        return;
+    }
+
+    ++cycleCount;
+
+    if(++cyclesThisFrame >= cyclesPerFrame)
+    {
+        endFrame();
+    }
+}
+
+void Chip8Core::runFrame()
+{
+    if(debugger != nullptr)
+    {
+        tracer != nullptr ? runFrameInstructions<true, true>() : runFrameInstructions<false, true>();
+
+        //The timers wait for the rest of the frame
+        if(debugger->isPaused())
+        {
+            return;
+        }
+    }
+    else if(recompiledActive && tracer == nullptr)
+    {
+        runFrameRecompiled();
+    }
+    else
+    {
+        tracer != nullptr ? runFrameInstructions<true, false>() : runFrameInstructions<false, false>();
+    }
+
+    endFrame();
+}
+
+template <bool tracing, bool debugging>
+void Chip8Core::runFrameInstructions()
+{
+    while(cyclesThisFrame < cyclesPerFrame)
+    {
+        if constexpr (!tracing && !debugging && CHIP8_FUSE_INSTRUCTIONS)
+        {
+            const int numRun = executeFusedInstructions(cyclesPerFrame - cyclesThisFrame);
+
+            cycleCount += numRun;
+            cyclesThisFrame += numRun;
+        }
+        else
+        {
+            if(!executeInstruction<tracing, debugging>())
+            {
+                break;
+            }
+
+            ++cycleCount;
+            ++cyclesThisFrame;
+        }
+
+        //Nothing can change until the timers tick or a key changes, so skip the rest of the frame
+        if(idleLoopDetected || keyPressWaitFlag || halted)
+        {
+            break;
+        }
+
+        //A watchpoint or the end of a step
+        if constexpr (debugging)
+        {
+            if(debugger->isPaused())
+            {
+                break;
+            }
+        }
+    }
+}
+
+void Chip8Core::setCyclesPerFrame(int newCyclesPerFrame)
+{
+    cyclesPerFrame = std::max(newCyclesPerFrame, 1);
+}
+
+void Chip8Core::setKeyState(uint16_t newKeyState)
+{
+    const uint16_t newlyPressed = newKeyState & ~keyState;
+
+    if(newKeyState != keyState)
+    {
+        resetIdleLoopDetection();
+    }
+
+    keyState = newKeyState;
+
+    if(keyPressWaitFlag && newlyPressed != 0)
+    {
+        //Take the lowest key that went down
+        uint8_t key = 0;
+
+        while((newlyPressed & (1 << key)) == 0)
+        {
+            ++key;
+        }
+
+        vRegisters[keyPressWaitRegister] = key;
+        keyPressWaitFlag = false;
+    }
+}
+
+bool Chip8Core::getPixel(int x, int y) const
+{
+    return getPixelPlanes(x, y) != 0;
+}
+
+int Chip8Core::getPixelPlanes(int x, int y) const
+{
+    int planes = 0;
+
+    for(int plane = 0; plane < numPlanes; ++plane)
+    {
+        planes |= int((framebuffer[y][plane * wordsPerPlane + x / 64] >> (63 - x % 64)) & 0x1) << plane;
+    }
+
+    return planes;
+}
+
+uint64_t Chip8Core::takeDirtyRows()
+{
+    const uint64_t rows = dirtyRows;
+    dirtyRows = 0;
+    return rows;
+}
+
+template <bool tracing, bool debugging>
+bool Chip8Core::executeInstruction()
+{
+    if(keyPressWaitFlag || halted)
+    {
+        return true;
+    }
+
+    if constexpr (debugging)
+    {
+        if(!debugger->canExecute(uint16_t(programCounter & addressMask)))
+        {
+            return false;
+        }
+    }
+
+    fetchOpcode();
+
+    const uint16_t indexBefore = indexRegister;
+
+    if constexpr (tracing)
+    {
+        const uint16_t fetchedFrom = programCounter;
+        const std::array<uint8_t, 16> registersBefore = vRegisters;
+
+        decodeAndExecuteOpcode();
+
+        tracer->recordInstruction(cycleCount, fetchedFrom, currentOpcode, indexRegister, registersBefore, vRegisters);
+    }
+    else
+    {
+        decodeAndExecuteOpcode();
+    }
+
+    if constexpr (debugging)
+    {
+        checkWatchpoints(indexBefore);
+        debugger->instructionFinished(programCounter);
+    }
+
+    return true;
+}
+
+int Chip8Core::executeFusedInstructions(int cyclesLeft)
+{
+    if(keyPressWaitFlag || halted)
+    {
+        return 1;
+    }
+
+    fetchOpcode();
+
+    if(cyclesLeft < 2)
+    {
+        decodeAndExecuteOpcode();
+        return 1;
+    }
+
+    //None of the sequences store to memory, so the later words can't change under the earlier ones.
+    //Only the instructions that can start one pay for looking at the next word
+    const uint16_t firstOpcode = currentOpcode;
+    const uint16_t firstKind = 0xF000 & firstOpcode;
+
+    //Of the F opcodes only FX07 starts one
+    if(firstKind != 0xA000 && firstKind != 0x6000 && firstKind != 0x7000 && (0xF0FF & firstOpcode) != 0xF007)
+    {
+        decodeAndExecuteOpcode();
+        return 1;
+    }
+
+    const uint16_t secondOpcode = uint16_t((memory[(programCounter + 2) & addressMask] << 8) | memory[(programCounter + 3) & addressMask]);
+
+    const int firstX = (0x0F00 & firstOpcode) >> 8;
+    const int secondX = (0x0F00 & secondOpcode) >> 8;
+
+    switch(0xF000 & firstOpcode)
+    {
+        case 0xA000:
+        {
+            //Point at a sprite then draw it
+            if((0xF000 & secondOpcode) != 0xD000)
+            {
+                break;
+            }
+
+            indexRegister = 0x0FFF & firstOpcode;
+            currentOpcode = secondOpcode;
+            drawSprite(vRegisters[secondX], vRegisters[(0x00F0 & secondOpcode) >> 4], 0x000F & secondOpcode);
+            programCounter += 4;
+            return 2;
+        }
+
+        case 0x6000:
+        {
+            //Load a register then start the delay timer from it
+            if((0xF0FF & secondOpcode) != 0xF015)
+            {
+                break;
+            }
+
+            vRegisters[firstX] = 0x00FF & firstOpcode;
+            currentOpcode = secondOpcode;
+            delayTimer = vRegisters[secondX];
+            ++sideEffectCount;
+            programCounter += 4;
+            return 2;
+        }
+
+        case 0x7000:
+        case 0xF000:
+        {
+            //Read the delay timer or bump a counter, then test it. A counter loop carries on into the jump back
+            const bool isCounter = (0xF000 & firstOpcode) == 0x7000;
+
+            if((!isCounter && (0xF0FF & firstOpcode) != 0xF007) || (0xF000 & secondOpcode) != 0x3000)
+            {
+                break;
+            }
+
+            if(isCounter)
+            {
+                vRegisters[firstX] += 0x00FF & firstOpcode;
+            }
+            else
+            {
+                vRegisters[firstX] = delayTimer;
+            }
+
+            currentOpcode = secondOpcode;
+            programCounter += 2;
+
+            if(vRegisters[secondX] == (0x00FF & secondOpcode))
+            {
+                skipNextInstruction();
+                programCounter += 2;
+                return 2;
+            }
+
+            programCounter += 2;
+
+            const uint16_t thirdOpcode = uint16_t((memory[programCounter & addressMask] << 8) | memory[(programCounter + 1) & addressMask]);
+
+            if(!isCounter || cyclesLeft < 3 || (0xF000 & thirdOpcode) != 0x1000)
+            {
+                return 2;
+            }
+
+            currentOpcode = thirdOpcode;
+            checkForIdleLoop(0x0FFF & thirdOpcode);
+            programCounter = 0x0FFF & thirdOpcode;
+            return 3;
+        }
+    }
+
+    decodeAndExecuteOpcode();
+    return 1;
+}
+
+void Chip8Core::checkWatchpoints(uint16_t indexBefore)
+{
+    const int numStored = getStoredByteCount();
+
+    for(int offset = 0; offset < numStored; ++offset)
+    {
+        debugger->checkWrite(uint16_t((indexBefore + offset) & addressMask));
+    }
+}
+
+int Chip8Core::getStoredByteCount() const
+{
+    const int firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
+    const int secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
+
+    //Only these store to memory, all of them starting at I as it was before the instruction
+    if((currentOpcode & 0xF0FF) == 0xF033)
+    {
+        return 3;
+    }
+
+    if((currentOpcode & 0xF0FF) == 0xF055)
+    {
+        return firstRegisterIndex + 1;
+    }
+
+    if(isXoChip() && (currentOpcode & 0xF00F) == 0x5002)
+    {
+        return std::abs(secondRegisterIndex - firstRegisterIndex) + 1;
+    }
+
+    return 0;
+}
+
+void Chip8Core::setRecompiledProgram(const RecompiledProgram* program)
+{
+    recompiledProgram = program;
+    updateRecompiledActive();
+}
+
+void Chip8Core::updateRecompiledActive()
+{
+    recompiledActive = recompiledProgram != nullptr && !programModified && recompiledProgram->matches(loadedProgramHash, loadedProfile, memory.size());
+}
+
+void Chip8Core::runFrameRecompiled()
+{
+    //The compiled code doesn't know about either, the interpreter does the right thing for both
+    if(keyPressWaitFlag || halted)
+    {
+        runFrameInstructions<false, false>();
+        return;
+    }
+
+    Chip8RecompiledState state {memory.data(), addressMask, vRegisters.data(), &indexRegister, &programCounter, stack.data(), &stackPointer,
+                                &delayTimer, &soundTimer, &keyState, &sideEffectCount, &Chip8Core::checkForIdleLoopRecompiled, this, false};
+
+    while(cyclesThisFrame < cyclesPerFrame)
+    {
+        //Code only reached through computed jumps was never compiled, so don't bother asking
+        if(recompiledProgram->isCompiledCode(programCounter & addressMask))
+        {
+            const uint32_t sideEffectsBefore = sideEffectCount;
+            const int cyclesRun = recompiledProgram->run(state, cyclesPerFrame - cyclesThisFrame);
+            cycleCount += cyclesRun;
+            cyclesThisFrame += cyclesRun;
+
+            //Compiled stores only say that something happened, not where, so the next fork copies everything
+            if(sideEffectCount != sideEffectsBefore)
+            {
+                changedPages = Chip8PagedMemory::allPages();
+                pagesToHash = Chip8PagedMemory::allPages();
+            }
+
+            if(state.codeModified)
+            {
+                programModified = true;
+                recompiledActive = false;
+                runFrameInstructions<false, false>();
+                return;
+            }
+
+            if(idleLoopDetected || cyclesThisFrame >= cyclesPerFrame)
+            {
+                return;
+            }
+        }
+
+        //The PC is on something the compiled code leaves to the interpreter
+        const uint16_t indexBefore = indexRegister;
+
+        executeInstruction<false, false>();
+        ++cycleCount;
+        ++cyclesThisFrame;
+
+        if(storeHitRecompiledCode(indexBefore))
+        {
+            programModified = true;
+            recompiledActive = false;
+            runFrameInstructions<false, false>();
+            return;
+        }
+
+        if(idleLoopDetected || keyPressWaitFlag || halted)
+        {
+            return;
+        }
+    }
+}
+
+bool Chip8Core::storeHitRecompiledCode(uint16_t indexBefore) const
+{
+    const int numStored = getStoredByteCount();
+
+    for(int offset = 0; offset < numStored; ++offset)
+    {
+        if(recompiledProgram->isCompiledCode((indexBefore + offset) & addressMask))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Chip8Core::checkForIdleLoopRecompiled(void* core, uint16_t target)
+{
+    auto* self = static_cast<Chip8Core*>(core);
+
+    self->checkForIdleLoop(target);
+    return self->idleLoopDetected;
+}
+
+Chip8Core::Fork Chip8Core::fork()
+{
+    //Anything written since the last fork goes into fresh pages, the rest is shared with it
+    memoryPages = memoryPages.withChanges(memory, changedPages);
+    changedPages = {};
+
+    Fork fork;
+    fork.memory = memoryPages;
+    fork.profile = loadedProfile;
+    fork.vRegisters = vRegisters;
+    fork.indexRegister = indexRegister;
+    fork.programCounter = programCounter;
+    fork.stack = stack;
+    fork.stackPointer = stackPointer;
+    fork.delayTimer = delayTimer;
+    fork.soundTimer = soundTimer;
+    fork.framebuffer = framebuffer;
+    fork.hiRes = hiRes;
+    fork.selectedPlanes = selectedPlanes;
+    fork.halted = halted;
+    fork.rplFlags = rplFlags;
+    fork.keyState = keyState;
+    fork.keyPressWaitFlag = keyPressWaitFlag;
+    fork.keyPressWaitRegister = keyPressWaitRegister;
+    fork.cyclesThisFrame = cyclesThisFrame;
+    fork.cycleCount = cycleCount;
+    fork.frameHash = frameHash;
+    fork.loadedProgramHash = loadedProgramHash;
+    fork.programModified = programModified;
+    fork.sideEffectCount = sideEffectCount;
+    fork.idleLoopArmed = idleLoopArmed;
+    fork.idleLoopDetected = idleLoopDetected;
+    fork.idleLoopTarget = idleLoopTarget;
+    fork.idleLoopSideEffectCount = idleLoopSideEffectCount;
+    fork.idleLoopIndexRegister = idleLoopIndexRegister;
+    fork.idleLoopStackPointer = idleLoopStackPointer;
+    fork.idleLoopRegisters = idleLoopRegisters;
+
+    //Shared until CXNN or setSeed() moves it on
+    if(randomGeneratorChanged)
+    {
+        forkedRandomGenerator = std::make_shared<const std::mt19937>(randomGenerator);
+        randomGeneratorChanged = false;
+    }
+
+    fork.randomGenerator = forkedRandomGenerator;
+    return fork;
+}
+
+void Chip8Core::restore(const Fork& fork)
+{
+    fork.memory.copyTo(memory, memoryPages, changedPages);
+    memoryPages = fork.memory;
+    changedPages = {};
+    pagesToHash = Chip8PagedMemory::allPages();
+    addressMask = uint32_t(memory.size() - 1);
+
+    loadedProfile = fork.profile;
+    vRegisters = fork.vRegisters;
+    indexRegister = fork.indexRegister;
+    programCounter = fork.programCounter;
+    stack = fork.stack;
+    stackPointer = fork.stackPointer;
+    delayTimer = fork.delayTimer;
+    soundTimer = fork.soundTimer;
+    framebuffer = fork.framebuffer;
+    hiRes = fork.hiRes;
+    selectedPlanes = fork.selectedPlanes;
+    halted = fork.halted;
+    rplFlags = fork.rplFlags;
+    keyState = fork.keyState;
+    keyPressWaitFlag = fork.keyPressWaitFlag;
+    keyPressWaitRegister = fork.keyPressWaitRegister;
+    cyclesThisFrame = fork.cyclesThisFrame;
+    cycleCount = fork.cycleCount;
+    frameHash = fork.frameHash;
+    loadedProgramHash = fork.loadedProgramHash;
+    programModified = fork.programModified;
+    sideEffectCount = fork.sideEffectCount;
+    idleLoopArmed = fork.idleLoopArmed;
+    idleLoopDetected = fork.idleLoopDetected;
+    idleLoopTarget = fork.idleLoopTarget;
+    idleLoopSideEffectCount = fork.idleLoopSideEffectCount;
+    idleLoopIndexRegister = fork.idleLoopIndexRegister;
+    idleLoopStackPointer = fork.idleLoopStackPointer;
+    idleLoopRegisters = fork.idleLoopRegisters;
+
+    if(randomGeneratorChanged || forkedRandomGenerator != fork.randomGenerator)
+    {
+        randomGenerator = *fork.randomGenerator;
+        forkedRandomGenerator = fork.randomGenerator;
+        randomGeneratorChanged = false;
+    }
+
+    //Whatever was on screen before has nothing to do with the fork
+    dirtyRows = allRows;
+    updateRecompiledActive();
+}
+
+void Chip8Core::markPagesWritten(uint16_t address, int numBytes)
+{
+    //Stores are at most 16 bytes, so they touch two pages at most
+    Chip8PagedMemory::markPage(changedPages, address & addressMask);
+    Chip8PagedMemory::markPage(changedPages, (address + numBytes - 1) & addressMask);
+    Chip8PagedMemory::markPage(pagesToHash, address & addressMask);
+    Chip8PagedMemory::markPage(pagesToHash, (address + numBytes - 1) & addressMask);
+}
+
+void Chip8Core::endFrame()
+{
+    cyclesThisFrame = 0;
+
+    updateTimers();
+
+    if(frameHashing)
+    {
+        updateMemoryHash();
+        frameHash = mixHash(frameHash, hashMachine(memoryHash));
+    }
+
+    resetIdleLoopDetection();
+}
+
+uint64_t Chip8Core::computeStateHash() const
+{
+    uint64_t digest = 0;
+
+    for(int page = 0; page < int(memory.size() / Chip8PagedMemory::pageSize); ++page)
+    {
+        digest += hashPage(page);
+    }
+
+    return hashMachine(digest);
+}
+
+void Chip8Core::updateMemoryHash()
+{
+    const int numPages = int(memory.size() / Chip8PagedMemory::pageSize);
+
+    if(int(pageHashes.size()) != numPages)
+    {
+        pageHashes.assign(numPages, 0);
+        memoryHash = 0;
+        pagesToHash = Chip8PagedMemory::allPages();
+    }
+
+    //Pages are summed, so each one written can be swapped out on its own
+    for(int page = 0; page < numPages; ++page)
+    {
+        if((pagesToHash[page / 64] >> (page % 64)) & 1)
+        {
+            const uint64_t pageHash = hashPage(page);
+            memoryHash += pageHash - pageHashes[page];
+            pageHashes[page] = pageHash;
+        }
+    }
+
+    pagesToHash = {};
+}
+
+uint64_t Chip8Core::hashPage(int page) const
+{
+    uint64_t hash = mixHash(0, uint64_t(page) + 1);
+
+    for(int offset = 0; offset < Chip8PagedMemory::pageSize; offset += int(sizeof(uint64_t)))
+    {
+        uint64_t word;
+        std::memcpy(&word, memory.data() + page * Chip8PagedMemory::pageSize + offset, sizeof(word));
+        hash = mixHash(hash, word);
+    }
+
+    return hash;
+}
+
+uint64_t Chip8Core::hashMachine(uint64_t memoryDigest) const
+{
+    uint64_t hash = mixHash(0, memoryDigest);
+
+    //Only what's on screen, lo-res leaves the rest of the framebuffer as it was
+    const int wordsShown = hiRes ? wordsPerPlane : 1;
+
+    for(int row = 0; row < getDisplayHeight(); ++row)
+    {
+        for(int plane = 0; plane < numPlanes; ++plane)
+        {
+            for(int word = 0; word < wordsShown; ++word)
+            {
+                hash = mixHash(hash, framebuffer[row][plane * wordsPerPlane + word]);
+            }
+        }
+    }
+
+    uint64_t registers[2];
+    std::memcpy(registers, vRegisters.data(), sizeof(registers));
+    hash = mixHash(mixHash(hash, registers[0]), registers[1]);
+
+    std::memcpy(registers, rplFlags.data(), sizeof(registers));
+    hash = mixHash(mixHash(hash, registers[0]), registers[1]);
+
+    for(const uint16_t address : stack)
+    {
+        hash = mixHash(hash, address);
+    }
+
+    hash = mixHash(hash, uint64_t(indexRegister) | uint64_t(programCounter) << 16 | uint64_t(stackPointer) << 32
+                         | uint64_t(delayTimer) << 48 | uint64_t(soundTimer) << 56);
+
+    return mixHash(hash, uint64_t(hiRes) | uint64_t(selectedPlanes) << 1 | uint64_t(halted) << 3
+                         | uint64_t(keyPressWaitFlag) << 4 | uint64_t(keyPressWaitRegister) << 8);
+}
+
+uint64_t Chip8Core::mixHash(uint64_t hash, uint64_t value)
+{
+    //Multiply and fold the high half back down, each word moves every bit of the result
+    hash = (hash ^ value) * 0x9E3779B97F4A7C15;
+    return hash ^ (hash >> 32);
+}
+
+void Chip8Core::checkForIdleLoop(uint16_t jumpTarget)
+{
+    //Only backward jumps can close a loop
+    if(jumpTarget > programCounter)
+    {
+        return;
+    }
+
+    //If everything is the same as last time round, the loop can only repeat until something outside changes
+    const bool sameState = idleLoopArmed
+                        && idleLoopTarget == jumpTarget
+                        && idleLoopSideEffectCount == sideEffectCount
+                        && idleLoopIndexRegister == indexRegister
+                        && idleLoopStackPointer == stackPointer
+                        && idleLoopRegisters == vRegisters;
+
+    if(sameState)
+    {
+        idleLoopDetected = true;
+        return;
+    }
+
+    idleLoopArmed = true;
+    idleLoopTarget = jumpTarget;
+    idleLoopSideEffectCount = sideEffectCount;
+    idleLoopIndexRegister = indexRegister;
+    idleLoopStackPointer = stackPointer;
+    idleLoopRegisters = vRegisters;
+}
+
+void Chip8Core::resetIdleLoopDetection()
+{
+    idleLoopArmed = false;
+    idleLoopDetected = false;
+}
+
+void Chip8Core::fetchOpcode()
+{
+    const uint8_t firstByte = memory[programCounter & addressMask];
+    const uint8_t secondByte = memory[(programCounter + 1) & addressMask];
+
+    //Shift the first byte to the start
+    currentOpcode = firstByte << 8;
+    currentOpcode |= secondByte;
+}
+
+void Chip8Core::decodeAndExecuteOpcode()
+{
+    //Look at the first digit of the opcode
+    switch(0xF000 & currentOpcode)
+    {
+        case 0x0000:
+        {
+            switch(currentOpcode)
+            {
+                case 0x00E0:
+                {
+                    clearScreen();
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x00EE:
+                {
+                    //The stack wraps rather than running off either end
+                    stackPointer = (stackPointer - 1) & 0xF;
+                    programCounter = stack[stackPointer];
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x00FB:
+                case 0x00FC:
+                case 0x00FD:
+                case 0x00FE:
+                case 0x00FF:
+                {
+                    if(!isSuperChip())
+                    {
+                        break;
+                    }
+
+                    if(currentOpcode == 0x00FB)
+                    {
+                        scrollRight();
+                    }
+                    else if(currentOpcode == 0x00FC)
+                    {
+                        scrollLeft();
+                    }
+                    else if(currentOpcode == 0x00FD)
+                    {
+                        //Stays on this instruction for good
+                        halted = true;
+                        return;
+                    }
+                    else
+                    {
+                        setHiRes(currentOpcode == 0x00FF);
+                    }
+
+                    programCounter += 2;
+                    return;
+                }
+
+                default:
+                {
+                    if(isSuperChip() && (0xFFF0 & currentOpcode) == 0x00C0)
+                    {
+                        scrollDown(0x000F & currentOpcode);
+                        programCounter += 2;
+                        return;
+                    }
+
+                    if(isXoChip() && (0xFFF0 & currentOpcode) == 0x00D0)
+                    {
+                        scrollUp(0x000F & currentOpcode);
+                        programCounter += 2;
+                        return;
+                    }
+
+                    break;
+                }
+            }
+
+            reportUnrecognisedOpcode();
+            programCounter += 2;
+            return;
+        }
+
+        case 0x1000:
+        {
+            checkForIdleLoop(0x0FFF & currentOpcode);
+            programCounter = 0x0FFF & currentOpcode;
+            return;
+        }
+
+        case 0x2000:
+        {
+            //CALL SUBROUTINE
+            stack[stackPointer] = programCounter;
+            stackPointer = (stackPointer + 1) & 0xF;
+            programCounter = 0x0FFF & currentOpcode;
+            return;
+        }
+
+        case 0x3000:
+        {
+            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t val = 0x00FF & currentOpcode;
+
+            if(vRegisters[registerIndex] == val)
+            {
+                skipNextInstruction();
+            }
+
+            programCounter += 2;
+            return;
+        }
+
+        case 0x4000:
+        {
+            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t val = 0x00FF & currentOpcode;
+
+            if(vRegisters[registerIndex] != val)
+            {
+                skipNextInstruction();
+            }
+
+            programCounter += 2;
+            return;
+        }
+
+        case 0x5000:
+        {
+            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
+
+            if(isXoChip() && ((0x000F & currentOpcode) == 0x0002 || (0x000F & currentOpcode) == 0x0003))
+            {
+                //Save or load VX to VY at I, counting down if Y is below X. I doesn't change
+                const bool save = (0x000F & currentOpcode) == 0x0002;
+                const int step = secondRegisterIndex >= firstRegisterIndex ? 1 : -1;
+                uint32_t currentLocation = indexRegister;
+
+                for(int registerIndex = firstRegisterIndex; ; registerIndex += step)
+                {
+                    if(save)
+                    {
+                        memory[currentLocation++ & addressMask] = vRegisters[registerIndex];
+                    }
+                    else
+                    {
+                        vRegisters[registerIndex] = memory[currentLocation++ & addressMask];
+                    }
+
+                    if(registerIndex == secondRegisterIndex)
+                    {
+                        break;
+                    }
+                }
+
+                sideEffectCount += save;
+
+                if(save)
+                {
+                    markPagesWritten(indexRegister, std::abs(secondRegisterIndex - firstRegisterIndex) + 1);
+                }
+                programCounter += 2;
+                return;
+            }
+
+            if(vRegisters[firstRegisterIndex] == vRegisters[secondRegisterIndex])
+            {
+                skipNextInstruction();
+            }
+
+            programCounter += 2;
+            return;
+        };
+
+        case 0x6000:
+        {
+            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t val = 0x00FF & currentOpcode;
+
+            vRegisters[registerIndex] = val;
+
+            programCounter += 2;
+            return;
+        }
+
+        case 0x7000:
+        {
+            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t val = 0x00FF & currentOpcode;
+
+            vRegisters[registerIndex] += val;
+
+            programCounter += 2;
+            return;
+        }
+
+        case 0x8000:
+        {
+            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
+
+            switch(0x000F & currentOpcode)
+            {
+                case 0x0000:
+                {
+                    vRegisters[firstRegisterIndex] = vRegisters[secondRegisterIndex];
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0001:
+                {
+                    vRegisters[firstRegisterIndex] |= vRegisters[secondRegisterIndex];
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0002:
+                {
+                    vRegisters[firstRegisterIndex] &= vRegisters[secondRegisterIndex];
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0003:
+                {
+                    vRegisters[firstRegisterIndex] ^= vRegisters[secondRegisterIndex];
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0004:
+                {
+                    //The flag goes in last, so it's what's left in VF when VF is X
+                    const bool carry = checkForCarry(vRegisters[firstRegisterIndex], vRegisters[secondRegisterIndex]);
+
+                    vRegisters[firstRegisterIndex] += vRegisters[secondRegisterIndex];
+                    vRegisters.back() = carry;
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0005:
+                {
+                    const bool noBorrow = !checkForBorrow(vRegisters[firstRegisterIndex], vRegisters[secondRegisterIndex]);
+
+                    vRegisters[firstRegisterIndex] -= vRegisters[secondRegisterIndex];
+                    vRegisters.back() = noBorrow;
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0006:
+                {
+                    //The bit shifted out goes in the carry flag
+                    const uint8_t shiftedOut = 0x1 & vRegisters[firstRegisterIndex];
+
+                    vRegisters[firstRegisterIndex] >>= 1;
+                    vRegisters.back() = shiftedOut;
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0007:
+                {
+                    const bool noBorrow = !checkForBorrow(vRegisters[secondRegisterIndex], vRegisters[firstRegisterIndex]);
+
+                    vRegisters[firstRegisterIndex] = vRegisters[secondRegisterIndex] - vRegisters[firstRegisterIndex];
+                    vRegisters.back() = noBorrow;
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x000E:
+                {
+                    const uint8_t shiftedOut = (0x80 & vRegisters[firstRegisterIndex]) >> 7;
+
+                    vRegisters[firstRegisterIndex] <<= 1;
+                    vRegisters.back() = shiftedOut;
+
+                    programCounter += 2;
+                    return;
+                }
+
+                default:
+                {
+                    reportUnrecognisedOpcode();
+                    programCounter += 2;
+                    return;
+                }
+            }
+        }
+
+        case 0x9000:
+        {
+            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
+
+            if(vRegisters[firstRegisterIndex] != vRegisters[secondRegisterIndex])
+            {
+                skipNextInstruction();
+            }
+
+            programCounter +=2;
+            return;
+        }
+
+        case 0xA000:
+        {
+            indexRegister = 0x0FFF & currentOpcode;
+            programCounter += 2;
+            return;
+        }
+
+        case 0xB000:
+        {
+            uint8_t offset = vRegisters[0];
+            uint16_t newMemoryLocation = 0x0FFF & currentOpcode;
+
+            programCounter = newMemoryLocation + offset;
+
+            return;
+        }
+
+        case 0xC000:
+        {
+            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t value = 0x00FF & currentOpcode;
+
+            //The top byte of the raw output rather than a distribution, whose results differ between standard
+            //libraries, so a seeded run draws the same numbers everywhere and golden frame hashes carry over
+            uint8_t randomVal = uint8_t(randomGenerator() >> 24);
+            randomGeneratorChanged = true;
+
+            vRegisters[registerIndex] = value & randomVal;
+            ++sideEffectCount;
+
+            programCounter += 2;
+
+            return;
+        }
+
+        case 0xD000:
+        {
+            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
+            uint8_t spriteXPos = vRegisters[firstRegisterIndex];
+
+            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
+            uint8_t spriteYPos = vRegisters[secondRegisterIndex];
+
+            uint8_t spriteHeight = 0x000F & currentOpcode;
+
+            //DXY0 is a 16x16 sprite on SUPER-CHIP, drawSprite() takes 0 to mean that
+            drawSprite(spriteXPos, spriteYPos, spriteHeight);
+
+            programCounter += 2;
+
+            return;
+        }
+
+        case 0xE000:
+        {
+            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
+
+            switch(0x00FF & currentOpcode)
+            {
+                case 0x009E:
+                {
+                    uint8_t keyToCheck = vRegisters[registerIndex];
+
+                    if(keyToCheck < 16 && (keyState & (1 << keyToCheck)) != 0)
+                    {
+                        skipNextInstruction();
+                    }
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x00A1:
+                {
+                    uint8_t keyToCheck = vRegisters[registerIndex];
+
+                    if(keyToCheck < 16 && (keyState & (1 << keyToCheck)) == 0)
+                    {
+                        skipNextInstruction();
+                    }
+
+                    programCounter += 2;
+                    return;
+                }
+
+                default:
+                {
+                    reportUnrecognisedOpcode();
+                    programCounter += 2;
+                    return;
+                }
+            }
+        }
+
+        case 0xF000:
+        {
+            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
+
+            switch(0x00FF & currentOpcode)
+            {
+                case 0x0000:
+                {
+                    if(!isXoChip() || currentOpcode != 0xF000)
+                    {
+                        break;
+                    }
+
+                    //Long load, the address is the whole next word
+                    indexRegister = (memory[(programCounter + 2) & addressMask] << 8) | memory[(programCounter + 3) & addressMask];
+                    programCounter += 4;
+                    return;
+                }
+
+                case 0x0001:
+                {
+                    if(!isXoChip())
+                    {
+                        break;
+                    }
+
+                    //X is the plane mask here, not a register
+                    selectedPlanes = registerIndex & 0x3;
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0007:
+                {
+                    vRegisters[registerIndex] = delayTimer;
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x000A:
+                {
+                    //Stop fetching until setKeyState() sees a key go down
+                    keyPressWaitFlag = true;
+                    keyPressWaitRegister = registerIndex;
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0015:
+                {
+                    delayTimer = vRegisters[registerIndex];
+                    ++sideEffectCount;
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0018:
+                {
+                    soundTimer = vRegisters[registerIndex];
+                    ++sideEffectCount;
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x001E:
+                {
+                    indexRegister += vRegisters[registerIndex];
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0029:
+                {
+                    indexRegister = vRegisters[registerIndex] * 0x5;
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0030:
+                {
+                    if(!isSuperChip())
+                    {
+                        break;
+                    }
+
+                    indexRegister = hiResFontStart + (0x0F & vRegisters[registerIndex]) * 10;
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0033:
+                {
+                    uint8_t registerValue = vRegisters[registerIndex];
+
+                    memory[indexRegister & addressMask]       = registerValue / 100;
+                    memory[(indexRegister + 1) & addressMask] = (registerValue / 10) % 10;
+                    memory[(indexRegister + 2) & addressMask] = (registerValue % 100) % 10;
+                    ++sideEffectCount;
+                    markPagesWritten(indexRegister, 3);
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0055:
+                {
+                    uint16_t currentLocation = indexRegister;
+
+                    std::for_each(vRegisters.cbegin(), vRegisters.cbegin() + registerIndex + 1, [&currentLocation, this](uint8_t registerValue)
+                    {
+                        memory[currentLocation++ & addressMask] = registerValue;
+                    });
+                    ++sideEffectCount;
+                    markPagesWritten(indexRegister, registerIndex + 1);
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0065:
+                {
+                    uint16_t currentLocation = indexRegister;
+
+                    std::for_each(vRegisters.begin(), vRegisters.begin() + registerIndex + 1, [&currentLocation, this](uint8_t& registerValue)
+                    {
+                        registerValue = memory[currentLocation++ & addressMask];
+                    });
+
+
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0075:
+                {
+                    if(!isSuperChip())
+                    {
+                        break;
+                    }
+
+                    std::copy(vRegisters.cbegin(), vRegisters.cbegin() + registerIndex + 1, rplFlags.begin());
+                    ++sideEffectCount;
+                    programCounter += 2;
+                    return;
+                }
+
+                case 0x0085:
+                {
+                    if(!isSuperChip())
+                    {
+                        break;
+                    }
+
+                    std::copy(rplFlags.cbegin(), rplFlags.cbegin() + registerIndex + 1, vRegisters.begin());
+                    programCounter += 2;
+                    return;
+                }
+
+                default:
+                {
+                    break;
+                }
+            }
+
+            reportUnrecognisedOpcode();
+            programCounter += 2;
+            return;
+        }
+
+        default:
+        {
+            reportUnrecognisedOpcode();
+            programCounter += 2;
+            return;
+        }
+    }
+}
+
+void Chip8Core::updateTimers()
+{
+    if(delayTimer > 0)
+    {
+        --delayTimer;
+    }
+
+    if(soundTimer > 0)
+    {
+        --soundTimer;
+    }
+}
+
+bool Chip8Core::checkForCarry(uint8_t first, uint8_t second) const
+{
+    uint16_t result = first + second;
+    return result > std::numeric_limits<uint8_t>::max();
+}
+
+bool Chip8Core::checkForBorrow(uint8_t first, uint8_t second) const
+{
+    return second > first;
+}
+
+std::array<uint8_t, 80> Chip8Core::getFontset()
+{
+    return {
+        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+        0x20, 0x60, 0x20, 0x20, 0x70, // 1
+        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+      };
+}
+
+std::array<uint8_t, 160> Chip8Core::getHiResFontset()
+{
+    return {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+      };
+}
+
+void Chip8Core::skipNextInstruction()
+{
+    //On XO-CHIP a long load is four bytes, so skipping it has to jump over both words
+    const bool nextIsLongLoad = isXoChip() && memory[(programCounter + 2) & addressMask] == 0xF0 && memory[(programCounter + 3) & addressMask] == 0x00;
+
+    programCounter += nextIsLongLoad ? 4 : 2;
+}
+
+Chip8Core::FramebufferRow Chip8Core::getSelectedPlaneMask() const
+{
+    FramebufferRow planeMask;
+
+    for(int word = 0; word < int(planeMask.size()); ++word)
+    {
+        planeMask[word] = (selectedPlanes & (1 << (word / wordsPerPlane))) != 0 ? ~uint64_t(0) : 0;
+    }
+
+    return planeMask;
+}
+
+void Chip8Core::clearScreen()
+{
+    const FramebufferRow planeMask = getSelectedPlaneMask();
+
+    for(auto& row : framebuffer)
+    {
+        for(int word = 0; word < int(row.size()); ++word)
+        {
+            row[word] &= ~planeMask[word];
+        }
+    }
+
+    dirtyRows = allRows;
+    ++sideEffectCount;
+}
+
+void Chip8Core::setHiRes(bool shouldBeHiRes)
+{
+    hiRes = shouldBeHiRes;
+
+    //A resolution change clears every plane, not just the selected ones
+    std::fill(framebuffer.begin(), framebuffer.end(), FramebufferRow {});
+    dirtyRows = allRows;
+    ++sideEffectCount;
+}
+
+void Chip8Core::drawSprite(uint8_t xPos, uint8_t yPos, uint8_t height)
+{
+    vRegisters.back() = 0;
+
+    const int width = getDisplayWidth();
+    const bool wideSprite = height == 0 && isSuperChip();
+    const int spriteWidth = wideSprite ? 16 : 8;
+    const int spriteHeight = wideSprite ? 16 : height;
+    const int bytesPerRow = spriteWidth / 8;
+
+    //The start position wraps, anything running off the edge is clipped
+    const int x = xPos % width;
+    const int startY = yPos % getDisplayHeight();
+    const int endY = std::min(startY + spriteHeight, getDisplayHeight());
+
+    //With more than one plane selected, each plane's sprite data follows on from the last
+    uint32_t spriteAddress = indexRegister;
+
+    for(int plane = 0; plane < numPlanes; ++plane)
+    {
+        if((selectedPlanes & (1 << plane)) == 0)
+        {
+            continue;
+        }
+
+        for(int y = startY; y < endY; ++y)
+        {
+            const uint32_t rowAddress = spriteAddress + (y - startY) * bytesPerRow;
+            uint64_t spriteRow = memory[rowAddress & addressMask];
+
+            if(wideSprite)
+            {
+                spriteRow = (spriteRow << 8) | memory[(rowAddress + 1) & addressMask];
+            }
+
+            //Line the sprite up with x across the plane's two words, the bits shifted past the right edge fall off
+            const uint64_t leftAligned = spriteRow << (64 - spriteWidth);
+            uint64_t leftBits;
+            uint64_t rightBits;
+
+            if(x < 64)
+            {
+                leftBits = leftAligned >> x;
+                rightBits = x == 0 || !hiRes ? 0 : leftAligned << (64 - x);
+            }
+            else
+            {
+                leftBits = 0;
+                rightBits = leftAligned >> (x - 64);
+            }
+
+            uint64_t& leftWord = framebuffer[y][plane * wordsPerPlane];
+            uint64_t& rightWord = framebuffer[y][plane * wordsPerPlane + 1];
+
+            if((leftWord & leftBits) != 0 || (rightWord & rightBits) != 0)
+            {
+                //Set the carry flag to true
+                vRegisters.back() = 1;
+            }
+
+            leftWord ^= leftBits;
+            rightWord ^= rightBits;
+            dirtyRows |= uint64_t(1) << y;
+        }
+
+        spriteAddress += spriteHeight * bytesPerRow;
+    }
+
+    ++sideEffectCount;
+}
+
+void Chip8Core::scrollDown(int numRows)
+{
+    const int height = getDisplayHeight();
+    numRows = std::min(numRows, height);
+
+    const FramebufferRow planeMask = getSelectedPlaneMask();
+
+    //Whole rows move, masked so unselected planes stay put. The rows uncovered at the top are blank
+    for(int y = height - 1; y >= 0; --y)
+    {
+        for(int word = 0; word < int(planeMask.size()); ++word)
+        {
+            const uint64_t moved = y >= numRows ? framebuffer[y - numRows][word] : 0;
+            framebuffer[y][word] = (framebuffer[y][word] & ~planeMask[word]) | (moved & planeMask[word]);
+        }
+    }
+
+    dirtyRows = allRows;
+    ++sideEffectCount;
+}
+
+void Chip8Core::scrollUp(int numRows)
+{
+    const int height = getDisplayHeight();
+    numRows = std::min(numRows, height);
+
+    const FramebufferRow planeMask = getSelectedPlaneMask();
+
+    for(int y = 0; y < height; ++y)
+    {
+        for(int word = 0; word < int(planeMask.size()); ++word)
+        {
+            const uint64_t moved = y + numRows < height ? framebuffer[y + numRows][word] : 0;
+            framebuffer[y][word] = (framebuffer[y][word] & ~planeMask[word]) | (moved & planeMask[word]);
+        }
+    }
+
+    dirtyRows = allRows;
+    ++sideEffectCount;
+}
+
+void Chip8Core::scrollRight()
+{
+    for(int y = 0; y < getDisplayHeight(); ++y)
+    {
+        for(int plane = 0; plane < numPlanes; ++plane)
+        {
+            if((selectedPlanes & (1 << plane)) == 0)
+            {
+                continue;
+            }
+
+            uint64_t& leftWord = framebuffer[y][plane * wordsPerPlane];
+            uint64_t& rightWord = framebuffer[y][plane * wordsPerPlane + 1];
+
+            //In lo-res the second word stays empty, so this clips at 64 pixels too
+            rightWord = hiRes ? (rightWord >> 4) | (leftWord << 60) : 0;
+            leftWord >>= 4;
+        }
+    }
+
+    dirtyRows = allRows;
+    ++sideEffectCount;
+}
+
+void Chip8Core::scrollLeft()
+{
+    for(int y = 0; y < getDisplayHeight(); ++y)
+    {
+        for(int plane = 0; plane < numPlanes; ++plane)
+        {
+            if((selectedPlanes & (1 << plane)) == 0)
+            {
+                continue;
+            }
+
+            uint64_t& leftWord = framebuffer[y][plane * wordsPerPlane];
+            uint64_t& rightWord = framebuffer[y][plane * wordsPerPlane + 1];
+
+            leftWord = (leftWord << 4) | (rightWord >> 60);
+            rightWord <<= 4;
+        }
+    }
+
+    dirtyRows = allRows;
+    ++sideEffectCount;
+}
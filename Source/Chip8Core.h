@@ -0,0 +1,375 @@
+/*
+  ==============================================================================
+
+    Chip8Core.h
+    Created: 2 May 2022 7:12:40pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Debugger.h"
+#include "Chip8PagedMemory.h"
+#include "TraceRecorder.h"
+#include "UnknownOpcodeTable.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <random>
+#include <vector>
+
+class RecompiledProgram;
+
+//Which instruction set the core decodes, also stored per ROM in RomArchiveEntry::quirkProfile
+enum class Chip8Profile : uint32_t
+{
+    chip8 = 0,
+    superChip = 1,
+    xoChip = 2
+};
+
+//The machine itself, with no dependency on JUCE so it can be run headless
+class Chip8Core
+{
+public:
+    static constexpr uint16_t programStart = 0x200;
+    static constexpr size_t memorySize = 4096;
+    static constexpr size_t xoChipMemorySize = 0x10000;
+
+    Chip8Core();
+
+    void load(std::istream& programData);
+    void load(const uint8_t* programData, size_t programSize);
+
+    //Back to how the last load() left the machine, from an image of memory taken then. Only pages
+    //the program has written to are copied back, the key state and CXNN's generator carry on as they are
+    void reset();
+
+    //Takes effect on the next load(), XO-CHIP also gets 64KB of memory. reset() keeps the loaded one
+    void setProfile(Chip8Profile newProfile) {profile = newProfile;}
+    Chip8Profile getProfile() const {return profile;}
+
+    //The profile the current program was loaded with, which decodes and sizes memory until the next load()
+    Chip8Profile getLoadedProfile() const {return loadedProfile;}
+
+    //Runs a single instruction, the timers tick every cyclesPerFrame instructions
+    void runCycle();
+
+    //Runs to the next 60Hz timer tick, finishing early if the program is spinning in an idle loop
+    void runFrame();
+
+    void setCyclesPerFrame(int newCyclesPerFrame);
+    int getCyclesPerFrame() const {return cyclesPerFrame;}
+
+    //Cycles run since the last load()
+    uint64_t getCycleCount() const {return cycleCount;}
+
+    //Every instruction run is recorded while a tracer is set, nullptr turns tracing off
+    void setTracer(TraceRecorder* newTracer) {tracer = newTracer;}
+
+    //Breakpoints and watchpoints are only checked while a debugger is set. While it is paused
+    //runCycle() and runFrame() do nothing, a frame that stopped part way finishes after resuming
+    void setDebugger(Chip8Debugger* newDebugger) {debugger = newDebugger;}
+
+    //Runs the program natively where Tools/Recompile could compile it, interpreting the rest. It is only
+    //used if it was compiled from the loaded program for this profile, and never while tracing or debugging.
+    //A store into compiled code goes back to interpreting until the next load. nullptr interprets everything
+    void setRecompiledProgram(const RecompiledProgram* program);
+    bool isRunningRecompiled() const {return recompiledActive;}
+
+    //Bit n is set while key n is held down
+    void setKeyState(uint16_t newKeyState);
+    uint16_t getKeyState() const {return keyState;}
+
+    //CXNN's generator is seeded randomly, seeding it makes a run repeatable
+    void setSeed(uint32_t seed) {randomGenerator.seed(seed); randomGeneratorChanged = true;}
+
+    //While on, every 60Hz frame boundary folds computeStateHash() into the frame hash, so two runs
+    //only have the same frame hash if they matched at every frame along the way. Starts again from 0
+    //on load() and reset(). Only memory written since the last frame is read again
+    void setFrameHashing(bool shouldHash) {frameHashing = shouldHash;}
+    uint64_t getFrameHash() const {return frameHash;}
+
+    //64 bit hash of the framebuffer as shown, memory and every register the program can see.
+    //Cycle counts and the keys are left out, so it only changes when the program's behaviour does
+    uint64_t computeStateHash() const;
+
+    static constexpr int maxWidthPixels = 128;
+    static constexpr int maxHeightPixels = 64;
+    static constexpr int loResWidthPixels = 64;
+    static constexpr int loResHeightPixels = 32;
+
+    //XO-CHIP has two bit planes, CHIP-8 and SUPER-CHIP only ever use the first
+    static constexpr int numPlanes = 2;
+    static constexpr int wordsPerPlane = 2;
+
+    //Both planes of a row sit side by side, plane 0's two words then plane 1's.
+    //Each plane is 128 pixels, the leftmost pixel is the most significant bit of its first word
+    using FramebufferRow = std::array<uint64_t, wordsPerPlane * numPlanes>;
+    using Framebuffer = std::array<FramebufferRow, maxHeightPixels>;
+
+    //In lo-res only the first word of each plane in the first 32 rows is used
+    const Framebuffer& getFramebuffer() const {return framebuffer;}
+    bool getPixel(int x, int y) const;
+
+    //Bit n is set if plane n is lit at this pixel
+    int getPixelPlanes(int x, int y) const;
+
+    bool isHiRes() const {return hiRes;}
+    int getDisplayWidth() const {return hiRes ? maxWidthPixels : loResWidthPixels;}
+    int getDisplayHeight() const {return hiRes ? maxHeightPixels : loResHeightPixels;}
+
+    //Bit n is set if row n has been drawn to or cleared since the last call
+    uint64_t takeDirtyRows();
+
+    bool isSoundActive() const {return soundTimer != 0;}
+    bool isWaitingForKey() const {return keyPressWaitFlag;}
+
+    //Set by the SUPER-CHIP exit opcode, 00FD
+    bool isHalted() const {return halted;}
+
+    const std::vector<uint8_t>& getMemory() const {return memory;}
+    uint16_t getProgramCounter() const {return programCounter;}
+    uint16_t getIndexRegister() const {return indexRegister;}
+    uint8_t getRegister(int registerIndex) const {return vRegisters[registerIndex];}
+    const std::array<uint8_t, 16>& getRegisters() const {return vRegisters;}
+    const std::array<uint16_t, 16>& getStack() const {return stack;}
+    uint16_t getStackPointer() const {return stackPointer;}
+    uint8_t getDelayTimer() const {return delayTimer;}
+    uint8_t getSoundTimer() const {return soundTimer;}
+
+    //Every unrecognised opcode the core has hit, for a reporter or UI to drain
+    UnknownOpcodeTable& getUnknownOpcodes() {return unknownOpcodes;}
+
+    //Loaded at address 0, FX29 points I at digit N * 5
+    static std::array<uint8_t, 80> getFontset();
+
+    //SUPER-CHIP's 8x10 digits, loaded at hiResFontStart whatever the profile
+    static std::array<uint8_t, 160> getHiResFontset();
+    static constexpr uint16_t hiResFontStart = 0x50;
+
+    //The whole machine at one point, for restore() to carry on from, on this core or any other.
+    //Memory is shared page by page with the core and other forks, so a fork costs the registers,
+    //timers and framebuffer plus a copy of each 256 byte page written since the core last forked
+    class Fork
+    {
+    public:
+        const Framebuffer& getFramebuffer() const {return framebuffer;}
+        const std::array<uint8_t, 16>& getRegisters() const {return vRegisters;}
+        uint16_t getProgramCounter() const {return programCounter;}
+        uint64_t getCycleCount() const {return cycleCount;}
+
+    private:
+        friend class Chip8Core;
+
+        Chip8PagedMemory memory;
+        Chip8Profile profile;
+
+        std::array<uint8_t, 16> vRegisters;
+        uint16_t indexRegister;
+        uint16_t programCounter;
+        std::array<uint16_t, 16> stack;
+        uint16_t stackPointer;
+        uint8_t delayTimer;
+        uint8_t soundTimer;
+
+        Framebuffer framebuffer;
+        bool hiRes;
+        int selectedPlanes;
+        bool halted;
+        std::array<uint8_t, 16> rplFlags;
+
+        uint16_t keyState;
+        bool keyPressWaitFlag;
+        uint8_t keyPressWaitRegister;
+
+        //Several KB, so shared between forks until CXNN next runs
+        std::shared_ptr<const std::mt19937> randomGenerator;
+
+        int cyclesThisFrame;
+        uint64_t cycleCount;
+        uint64_t frameHash;
+        uint64_t loadedProgramHash;
+        bool programModified;
+
+        uint32_t sideEffectCount;
+        bool idleLoopArmed;
+        bool idleLoopDetected;
+        uint16_t idleLoopTarget;
+        uint32_t idleLoopSideEffectCount;
+        uint16_t idleLoopIndexRegister;
+        uint16_t idleLoopStackPointer;
+        std::array<uint8_t, 16> idleLoopRegisters;
+    };
+
+    //Cheap enough to do thousands of times a second, for searching ahead over game states
+    Fork fork();
+
+    //Only the memory pages that differ from this core's are copied. Tracer, debugger, recompiled program,
+    //cycles per frame and the unknown opcode counts stay as they are
+    void restore(const Fork& fork);
+
+private:
+    //Tracing and debugging are template parameters so the plain loop doesn't carry a check per instruction.
+    //Returns false if the debugger stopped the instruction from running
+    template <bool tracing, bool debugging>
+    bool executeInstruction();
+
+    template <bool tracing, bool debugging>
+    void runFrameInstructions();
+
+    //The plain loop's instruction step when built with CHIP8_FUSE_INSTRUCTIONS. Runs a common sequence such as ANNN then
+    //DXYN in one go when it fits in cyclesLeft, with the same results as running each on its own. Returns how many ran
+    int executeFusedInstructions(int cyclesLeft);
+
+    //Debug builds of the loop only, tests the bytes the instruction just stored against the watchpoints
+    void checkWatchpoints(uint16_t indexBefore);
+
+    //Bytes the current opcode stores to memory at I, 0 for anything that isn't a store
+    int getStoredByteCount() const;
+
+    //Everything but memory, as load() leaves it
+    void resetMachine();
+
+    //Every store goes through here so the next fork knows which pages to copy, and the frame hash which to hash again
+    void markPagesWritten(uint16_t address, int numBytes);
+
+    void runFrameRecompiled();
+    void updateRecompiledActive();
+    bool storeHitRecompiledCode(uint16_t indexBefore) const;
+    static bool checkForIdleLoopRecompiled(void* core, uint16_t target);
+    void endFrame();
+
+    //Folds the pages written since the last frame back into memoryHash
+    void updateMemoryHash();
+    uint64_t hashPage(int page) const;
+
+    //Everything computeStateHash() covers, with memory already summed up
+    uint64_t hashMachine(uint64_t memoryDigest) const;
+
+    //One step of every hash above
+    static uint64_t mixHash(uint64_t hash, uint64_t value);
+
+    void checkForIdleLoop(uint16_t jumpTarget);
+    void resetIdleLoopDetection();
+
+    void fetchOpcode();
+    void decodeAndExecuteOpcode();
+
+    void reportUnrecognisedOpcode() {unknownOpcodes.record(currentOpcode);}
+
+    void updateTimers();
+
+    bool checkForCarry(uint8_t first, uint8_t second) const;
+    bool checkForBorrow(uint8_t first, uint8_t second) const;
+
+
+    //XO-CHIP includes all of SUPER-CHIP
+    bool isSuperChip() const {return loadedProfile != Chip8Profile::chip8;}
+    bool isXoChip() const {return loadedProfile == Chip8Profile::xoChip;}
+
+    void skipNextInstruction();
+
+    //All ones over the words of the selected planes
+    FramebufferRow getSelectedPlaneMask() const;
+
+    void clearScreen();
+    void setHiRes(bool shouldBeHiRes);
+    void drawSprite(uint8_t xPos, uint8_t yPos, uint8_t height);
+
+    void scrollDown(int numRows);
+    void scrollUp(int numRows);
+    void scrollRight();
+    void scrollLeft();
+
+    uint16_t currentOpcode;
+    std::vector<uint8_t> memory;
+
+    //Every address is masked, so memory accesses wrap rather than run off the end
+    uint32_t addressMask = memorySize - 1;
+
+    //Registers
+    std::array<uint8_t, 16> vRegisters;
+
+    uint16_t indexRegister;
+    uint16_t programCounter;
+
+    std::array<uint16_t, 16> stack;
+    uint16_t stackPointer;
+
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+
+    Chip8Profile profile = Chip8Profile::chip8;
+    Chip8Profile loadedProfile = Chip8Profile::chip8;
+
+    Framebuffer framebuffer;
+    bool hiRes = false;
+
+    //Planes drawn to and cleared, set by XO-CHIP FN01
+    int selectedPlanes = 1;
+    static constexpr uint64_t allRows = ~uint64_t(0);
+    uint64_t dirtyRows = allRows;
+
+    bool halted = false;
+
+    //SUPER-CHIP RPL user flags, FX75/FX85
+    std::array<uint8_t, 16> rplFlags {};
+
+    uint16_t keyState = 0;
+    bool keyPressWaitFlag = false;
+    uint8_t keyPressWaitRegister = 0;
+
+    std::mt19937 randomGenerator;
+
+    //The generator as of the last fork or restore, and whether it has moved on since
+    std::shared_ptr<const std::mt19937> forkedRandomGenerator;
+    bool randomGeneratorChanged = true;
+
+    UnknownOpcodeTable unknownOpcodes;
+
+    int cyclesPerFrame = 1;
+    int cyclesThisFrame = 0;
+    uint64_t cycleCount = 0;
+
+    bool frameHashing = false;
+    uint64_t frameHash = 0;
+
+    //The frame hash's view of memory, a hash per page and their sum, and the pages written since
+    std::vector<uint64_t> pageHashes;
+    uint64_t memoryHash = 0;
+    Chip8PagedMemory::PageMask pagesToHash {};
+
+    TraceRecorder* tracer = nullptr;
+    Chip8Debugger* debugger = nullptr;
+
+    const RecompiledProgram* recompiledProgram = nullptr;
+    uint64_t loadedProgramHash = 0;
+    bool recompiledActive = false;
+
+    //Set once the program stores over its own compiled code
+    bool programModified = false;
+
+    //Memory as the last load() left it
+    Chip8PagedMemory bootMemory;
+
+    //Memory as of the last fork, restore or reset, and the pages written since
+    Chip8PagedMemory memoryPages;
+    Chip8PagedMemory::PageMask changedPages {};
+
+    //Bumped by anything that changes state the idle loop check doesn't compare directly
+    uint32_t sideEffectCount = 0;
+
+    //State seen the last time a backward jump was taken
+    bool idleLoopArmed = false;
+    bool idleLoopDetected = false;
+    uint16_t idleLoopTarget = 0;
+    uint32_t idleLoopSideEffectCount = 0;
+    uint16_t idleLoopIndexRegister = 0;
+    uint16_t idleLoopStackPointer = 0;
+    std::array<uint8_t, 16> idleLoopRegisters;
+};
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    Chip8Debugger.cpp
+    Created: 16 Jul 2022 11:04:37am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "Chip8Debugger.h"
+
+void Chip8Debugger::clearAll()
+{
+    breakpoints.fill(0);
+    watchpoints.fill(0);
+    numBreakpoints = 0;
+    numWatchpoints = 0;
+}
+
+void Chip8Debugger::reset()
+{
+    paused = false;
+    stepping = false;
+    skipNextBreakpoint = false;
+    stopReason = Chip8StopReason::none;
+}
+
+void Chip8Debugger::pause()
+{
+    stepping = false;
+
+    if(!paused)
+    {
+        stop(Chip8StopReason::pauseRequested, 0);
+    }
+}
+
+void Chip8Debugger::resume()
+{
+    paused = false;
+    stepping = false;
+
+    //Otherwise a breakpoint on the current instruction would stop it again straight away
+    skipNextBreakpoint = true;
+}
+
+void Chip8Debugger::step()
+{
+    paused = false;
+    stepping = true;
+    skipNextBreakpoint = true;
+}
+
+void Chip8Debugger::setBit(Bitmap& bitmap, uint16_t address, bool enabled, int& count)
+{
+    const uint64_t bit = uint64_t(1) << (address & 63);
+    uint64_t& word = bitmap[address >> 6];
+
+    if(((word & bit) != 0) == enabled)
+    {
+        return;
+    }
+
+    word ^= bit;
+    count += enabled ? 1 : -1;
+}
+
+void Chip8Debugger::stop(Chip8StopReason reason, uint16_t address)
+{
+    paused = true;
+    stepping = false;
+    skipNextBreakpoint = false;
+
+    stopReason = reason;
+    stopAddress = address;
+}
@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+    Chip8Debugger.h
+    Created: 16 Jul 2022 11:04:37am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+enum class Chip8StopReason
+{
+    none,
+    breakpoint,
+    watchpoint,
+    step,
+    pauseRequested
+};
+
+//Breakpoint and watchpoint state for a Chip8Core. Both are one bit per address, so checking
+//an instruction or a stored byte is a single bit test. The core only consults this while
+//one is attached with setDebugger(), otherwise it runs a build of its loop without the checks
+class Chip8Debugger
+{
+public:
+    Chip8Debugger() {};
+
+    //Covers XO-CHIP's 64KB, addresses are masked by the core before they get here
+    static constexpr uint32_t numAddresses = 0x10000;
+
+    void setBreakpoint(uint16_t address, bool enabled) {setBit(breakpoints, address, enabled, numBreakpoints);}
+    bool hasBreakpoint(uint16_t address) const {return testBit(breakpoints, address);}
+
+    //Stops after any FX33, FX55 or XO-CHIP 5XY2 that writes to the address
+    void setWatchpoint(uint16_t address, bool enabled) {setBit(watchpoints, address, enabled, numWatchpoints);}
+    bool hasWatchpoint(uint16_t address) const {return testBit(watchpoints, address);}
+
+    void clearAll();
+
+    //Forgets any stop or step in progress but keeps the breakpoints and watchpoints, for a new program
+    void reset();
+
+    //True while there is anything for the core to check, the core can run undebugged otherwise
+    bool isActive() const {return paused || stepping || numBreakpoints != 0 || numWatchpoints != 0;}
+
+    bool isPaused() const {return paused;}
+    Chip8StopReason getStopReason() const {return stopReason;}
+
+    //The instruction that hit a breakpoint, or the store that hit a watchpoint
+    uint16_t getStopAddress() const {return stopAddress;}
+
+    //Stops before the next instruction
+    void pause();
+
+    //Runs until the next breakpoint or watchpoint, the breakpoint being sat on is stepped over
+    void resume();
+
+    //Runs one instruction then stops again
+    void step();
+
+    //Core only, before fetching from address. Returns false if the instruction mustn't run yet
+    bool canExecute(uint16_t address)
+    {
+        if(paused)
+        {
+            return false;
+        }
+
+        if(skipNextBreakpoint)
+        {
+            skipNextBreakpoint = false;
+            return true;
+        }
+
+        if(testBit(breakpoints, address))
+        {
+            stop(Chip8StopReason::breakpoint, address);
+            return false;
+        }
+
+        return true;
+    }
+
+    //Core only, for each byte an instruction stored
+    void checkWrite(uint16_t address)
+    {
+        if(testBit(watchpoints, address))
+        {
+            stop(Chip8StopReason::watchpoint, address);
+        }
+    }
+
+    //Core only, after each instruction
+    void instructionFinished(uint16_t programCounter)
+    {
+        if(stepping && !paused)
+        {
+            stop(Chip8StopReason::step, programCounter);
+        }
+    }
+
+private:
+    using Bitmap = std::array<uint64_t, numAddresses / 64>;
+
+    static bool testBit(const Bitmap& bitmap, uint16_t address)
+    {
+        return (bitmap[address >> 6] >> (address & 63)) & 1;
+    }
+
+    static void setBit(Bitmap& bitmap, uint16_t address, bool enabled, int& count);
+
+    void stop(Chip8StopReason reason, uint16_t address);
+
+    Bitmap breakpoints {};
+    Bitmap watchpoints {};
+    int numBreakpoints = 0;
+    int numWatchpoints = 0;
+
+    bool paused = false;
+    bool stepping = false;
+    bool skipNextBreakpoint = false;
+
+    Chip8StopReason stopReason = Chip8StopReason::none;
+    uint16_t stopAddress = 0;
+};
@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    Chip8Disassembler.cpp
+    Created: 23 Jul 2022 2:18:40pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "Chip8Disassembler.h"
+#include "RomAnalyser.h"
+#include <cstdio>
+
+namespace
+{
+    std::string hex(unsigned value, int digits)
+    {
+        char text[8];
+        std::snprintf(text, sizeof(text), "0x%0*X", digits, value);
+        return text;
+    }
+
+    std::string reg(int registerIndex)
+    {
+        char text[4];
+        std::snprintf(text, sizeof(text), "V%X", registerIndex);
+        return text;
+    }
+}
+
+std::string Chip8Disassembler::disassemble(uint16_t opcode, uint16_t nextWord, Chip8Profile profile)
+{
+    if(!RomAnalyser::isRecognisedOpcode(opcode, profile))
+    {
+        return "DW " + hex(opcode, 4);
+    }
+
+    const std::string x = reg((0x0F00 & opcode) >> 8);
+    const std::string y = reg((0x00F0 & opcode) >> 4);
+    const std::string nnn = hex(0x0FFF & opcode, 3);
+    const std::string nn = hex(0x00FF & opcode, 2);
+    const int n = 0x000F & opcode;
+
+    switch(0xF000 & opcode)
+    {
+        case 0x0000:
+        {
+            switch(opcode)
+            {
+                case 0x00E0: return "CLS";
+                case 0x00EE: return "RET";
+                case 0x00FB: return "SCR";
+                case 0x00FC: return "SCL";
+                case 0x00FD: return "EXIT";
+                case 0x00FE: return "LOW";
+                case 0x00FF: return "HIGH";
+            }
+
+            return ((0xFFF0 & opcode) == 0x00C0 ? "SCD " : "SCU ") + std::to_string(n);
+        }
+
+        case 0x1000: return "JP " + nnn;
+        case 0x2000: return "CALL " + nnn;
+        case 0x3000: return "SE " + x + ", " + nn;
+        case 0x4000: return "SNE " + x + ", " + nn;
+
+        case 0x5000:
+        {
+            if(profile == Chip8Profile::xoChip && n == 0x2)
+            {
+                return "LD [I], " + x + "-" + y;
+            }
+
+            if(profile == Chip8Profile::xoChip && n == 0x3)
+            {
+                return "LD " + x + "-" + y + ", [I]";
+            }
+
+            return "SE " + x + ", " + y;
+        }
+
+        case 0x6000: return "LD " + x + ", " + nn;
+        case 0x7000: return "ADD " + x + ", " + nn;
+
+        case 0x8000:
+        {
+            static const char* const aluNames[] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN"};
+
+            if(n == 0xE)
+            {
+                return "SHL " + x + ", " + y;
+            }
+
+            return std::string(aluNames[n]) + " " + x + ", " + y;
+        }
+
+        case 0x9000: return "SNE " + x + ", " + y;
+        case 0xA000: return "LD I, " + nnn;
+        case 0xB000: return "JP V0, " + nnn;
+        case 0xC000: return "RND " + x + ", " + nn;
+        case 0xD000: return "DRW " + x + ", " + y + ", " + std::to_string(n);
+        case 0xE000: return ((0x00FF & opcode) == 0x009E ? "SKP " : "SKNP ") + x;
+
+        default:
+        {
+            switch(0x00FF & opcode)
+            {
+                case 0x0000: return "LD I, LONG " + hex(nextWord, 4);
+                case 0x0001: return "PLANE " + std::to_string((0x0F00 & opcode) >> 8);
+                case 0x0007: return "LD " + x + ", DT";
+                case 0x000A: return "LD " + x + ", K";
+                case 0x0015: return "LD DT, " + x;
+                case 0x0018: return "LD ST, " + x;
+                case 0x001E: return "ADD I, " + x;
+                case 0x0029: return "LD F, " + x;
+                case 0x0030: return "LD HF, " + x;
+                case 0x0033: return "LD B, " + x;
+                case 0x0055: return "LD [I], " + x;
+                case 0x0065: return "LD " + x + ", [I]";
+                case 0x0075: return "LD R, " + x;
+                default:     return "LD " + x + ", R";
+            }
+        }
+    }
+}
@@ -0,0 +1,22 @@
+/*
+  ==============================================================================
+
+    Chip8Disassembler.h
+    Created: 23 Jul 2022 2:18:40pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Core.h"
+#include <string>
+
+class Chip8Disassembler
+{
+public:
+    //Cowgod style mnemonics, e.g. "LD V3, 0x2A". Opcodes the profile doesn't recognise come out as
+    //"DW 0x1234". nextWord is only read by XO-CHIP's F000, whose address is the following two bytes
+    static std::string disassemble(uint16_t opcode, uint16_t nextWord = 0, Chip8Profile profile = Chip8Profile::chip8);
+};
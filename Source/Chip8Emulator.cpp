@@ -10,9 +10,13 @@
 
 #include "Chip8Emulator.h"
 
-Chip8Emulator::Chip8Emulator()  : display(juce::Image::RGB, numWidthPixels, numHeightPixels, true)
+Chip8Emulator::Chip8Emulator()
 {
+    setOpaque(true);
+    
     keyPairings = getDefaultKeyPairings();
+    setWantsKeyboardFocus(true);
+    addKeyListener(this);
     
     audioPlaying = false;
     audioGenerator.setFreq(2000.0);
@@ -20,82 +24,411 @@ Chip8Emulator::Chip8Emulator()  : display(juce::Image::RGB, numWidthPixels, numH
 
 Chip8Emulator::~Chip8Emulator()
 {
-    
+    setTurbo(false);
+    stopTrace();
+    stopCapture();
+    unloadRecompiledProgram();
 }
 
 void Chip8Emulator::load(std::istream& programData)
 {
-    //Reset System State
-    programCounter = 0x200;
-    currentOpcode = 0;
-    indexRegister = 0;
-    stackPointer = 0;
-    
-    std::fill(memory.begin(), memory.end(), 0);
-    std::fill(vRegisters.begin(), vRegisters.end(), 0);
-    std::fill(stack.begin(), stack.end(), 0);
+    ScopedTurboPause pause(*this);
     
-    //Load the fontset
-    const auto fontset = getFontset();
-    std::copy(fontset.cbegin(), fontset.cend(), memory.begin());
-    
-    delayTimer = 0;
-    soundTimer = 0;
-    
-    programData.unsetf(std::ios_base::skipws);
+    //The core forgets them on load
+    reportUnknownOpcodes();
+    core.load(programData);
+    debugger.reset();
+    updateDebugger();
+    checkDebugState();
+    notifyCoreUpdated();
+    phosphor.clear();
+    updateDisplay();
+}
+
+void Chip8Emulator::load(const uint8_t* programData, size_t programSize)
+{
+    ScopedTurboPause pause(*this);
     
-    //Load program into memory
-    std::copy(std::istream_iterator<uint8_t>(programData), std::istream_iterator<uint8_t>(), memory.begin() + 512);
+    reportUnknownOpcodes();
+    core.load(programData, programSize);
+    debugger.reset();
+    updateDebugger();
+    checkDebugState();
+    notifyCoreUpdated();
+    phosphor.clear();
+    updateDisplay();
+}
+
+void Chip8Emulator::setProfile(Chip8Profile newProfile)
+{
+    ScopedTurboPause pause(*this);
     
-    clearScreen();
+    core.setProfile(newProfile);
 }
 
 void Chip8Emulator::setRefreshRate(int newRefreshRateHz)
 {
+    ScopedTurboPause pause(*this);
+    
     refreshRate = newRefreshRateHz;
     
-    if(isPlaying)
+    //The timer always runs at the 60Hz timer rate, the refresh rate sets how many instructions fit in each tick
+    core.setCyclesPerFrame(juce::roundToInt(refreshRate / double(timerRateHz)));
+}
+
+void Chip8Emulator::setPhosphorEnabled(bool enabled)
+{
+    ScopedTurboPause pause(*this);
+    
+    phosphorEnabled = enabled;
+    phosphor.clear();
+    showingRunAhead = false;
+    
+    //Redraw everything in the new style
+    if(phosphorEnabled)
     {
-        startTimerHz(refreshRate);
+        phosphor.update(core.getFramebuffer(), core.getDisplayWidth(), core.getDisplayHeight());
+        renderer.update(phosphor.getIntensities(), core.getDisplayWidth(), core.getDisplayHeight(), ~uint64_t(0));
     }
+    else
+    {
+        renderer.update(core.getFramebuffer(), core.getDisplayWidth(), core.getDisplayHeight(), ~uint64_t(0));
+    }
+    
+    repaint();
+}
+
+void Chip8Emulator::setPhosphorPersistence(float persistence)
+{
+    phosphor.setPersistence(persistence);
 }
 
 void Chip8Emulator::setPlayState(bool play)
 {
+    if(!play)
+    {
+        setTurbo(false);
+    }
+    
     isPlaying = play;
     
-    isPlaying ? startTimerHz(refreshRate) : stopTimer();
+    isPlaying ? startTimerHz(timerRateHz) : stopTimer();
+    
+    //The pause would otherwise count as one very late tick
+    hud.reset();
 }
 
-void Chip8Emulator::paint(juce::Graphics& g)
+bool Chip8Emulator::startTrace(const juce::File& traceFile)
 {
-    g.drawImage(display, getLocalBounds().toFloat());
+    ScopedTurboPause pause(*this);
+    
+    stopTrace();
+    
+    if(!tracer.start(traceFile.getFullPathName().toStdString()))
+    {
+        return false;
+    }
+    
+    core.setTracer(&tracer);
+    return true;
 }
 
-void Chip8Emulator::timerCallback()
+void Chip8Emulator::stopTrace()
 {
-    runCycle();
+    if(!tracer.getIsRecording())
+    {
+        return;
+    }
+    
+    ScopedTurboPause pause(*this);
+    
+    core.setTracer(nullptr);
+    
+    if(const uint64_t dropped = tracer.getDroppedCount())
+    {
+        juce::Logger::writeToLog(juce::String(dropped) + " trace records were dropped, the disk couldn't keep up");
+    }
+    
+    tracer.stop();
 }
 
-bool Chip8Emulator::keyPressed(const juce::KeyPress& key, juce::Component* originatingComponent)
+bool Chip8Emulator::startCapture(const juce::File& videoFile, int scale)
 {
-    int keyCode = key.getKeyCode();
+    stopCapture();
+    
+    const juce::File audioFile = videoFile.withFileExtension(".wav");
     
-    const auto foundPairing = std::find_if(keyPairings.cbegin(), keyPairings.cend(), [keyCode](const auto& pairing)
+    if(!capture.start(videoFile.getFullPathName().toStdString(), audioFile.getFullPathName().toStdString(), scale, audioSampleRate.load()))
+    {
+        juce::Logger::writeToLog("Couldn't start recording to " + videoFile.getFullPathName());
+        return false;
+    }
+    
+    return true;
+}
+
+void Chip8Emulator::stopCapture()
+{
+    if(!capture.getIsRecording())
     {
-        return pairing.second == keyCode;
+        return;
+    }
+    
+    if(const uint64_t dropped = capture.getDroppedFrameCount())
+    {
+        juce::Logger::writeToLog(juce::String(dropped) + " recorded frames were dropped, the disk couldn't keep up");
+    }
+    
+    if(const uint64_t dropped = capture.getDroppedSampleCount())
+    {
+        juce::Logger::writeToLog(juce::String(dropped) + " recorded audio samples were dropped, the disk couldn't keep up");
+    }
+    
+    capture.stop();
+}
+
+bool Chip8Emulator::loadRecompiledProgram(const juce::File& library)
+{
+    ScopedTurboPause pause(*this);
+    
+    unloadRecompiledProgram();
+    
+    if(!recompiled.open(library.getFullPathName().toStdString()))
+    {
+        juce::Logger::writeToLog("Couldn't load " + library.getFullPathName() + " as a recompiled program");
+        return false;
+    }
+    
+    core.setRecompiledProgram(&recompiled);
+    return true;
+}
+
+void Chip8Emulator::unloadRecompiledProgram()
+{
+    if(!recompiled.getIsOpen())
+    {
+        return;
+    }
+    
+    ScopedTurboPause pause(*this);
+    
+    core.setRecompiledProgram(nullptr);
+    recompiled.close();
+}
+
+void Chip8Emulator::setTurbo(bool enabled)
+{
+    //The turbo thread would only spin on a core the debugger is holding
+    if(enabled == turboRunning || (enabled && (!isPlaying || debugger.isPaused())))
+    {
+        return;
+    }
+    
+    if(!enabled)
+    {
+        turboRunning = false;
+        turboThread.join();
+        
+        //Show wherever the thread got to
+        presentTurboFrame();
+        notifyCoreUpdated();
+        return;
+    }
+    
+    audioPlaying = false;
+    turboKeyState = getKeyState();
+    
+    //The timer reads the first frame straight away, so it has to be current
+    publishTurboFrame(core.takeDirtyRows());
+    
+    turboStoppedByDebugger = false;
+    turboRunning = true;
+    turboThread = std::thread([this]()
+    {
+        turboLoop();
     });
+}
+
+void Chip8Emulator::setBreakpoint(uint16_t address, bool enabled)
+{
+    ScopedTurboPause pause(*this);
+    
+    debugger.setBreakpoint(address, enabled);
+    updateDebugger();
+}
+
+void Chip8Emulator::setWatchpoint(uint16_t address, bool enabled)
+{
+    ScopedTurboPause pause(*this);
+    
+    debugger.setWatchpoint(address, enabled);
+    updateDebugger();
+}
+
+void Chip8Emulator::debugPause()
+{
+    ScopedTurboPause pause(*this);
+    
+    debugger.pause();
+    updateDebugger();
+    checkDebugState();
+}
+
+void Chip8Emulator::debugResume()
+{
+    ScopedTurboPause pause(*this);
+    
+    debugger.resume();
+    updateDebugger();
+    checkDebugState();
+}
+
+void Chip8Emulator::debugStep()
+{
+    ScopedTurboPause pause(*this);
+    
+    debugger.step();
+    updateDebugger();
+    
+    //Stops again after the one instruction, unless it is waiting on a key
+    core.runFrame();
+    
+    updateDisplay();
+    checkDebugState();
+    notifyCoreUpdated();
+}
+
+void Chip8Emulator::updateDebugger()
+{
+    core.setDebugger(debugger.isActive() ? &debugger : nullptr);
+}
+
+void Chip8Emulator::checkDebugState()
+{
+    if(debugger.isPaused() == showingDebugPause)
+    {
+        return;
+    }
+    
+    showingDebugPause = debugger.isPaused();
+    
+    //Nothing left to check once it is running with no breakpoints
+    updateDebugger();
+    repaint();
+    
+    if(onDebugStateChanged)
+    {
+        onDebugStateChanged();
+    }
+}
+
+void Chip8Emulator::notifyCoreUpdated()
+{
+    //The turbo thread owns the core, the view catches up when it stops
+    if(onCoreUpdated && !turboRunning)
+    {
+        onCoreUpdated(core);
+    }
+}
+
+void Chip8Emulator::setHudVisible(bool visible)
+{
+    hudVisible = visible;
+    hud.reset();
+    repaint();
+}
+
+void Chip8Emulator::paint(juce::Graphics& g)
+{
+    const int64_t paintStart = juce::Time::getHighResolutionTicks();
+    
+    renderer.draw(g, getLocalBounds());
     
-    if(foundPairing != keyPairings.cend())
+    if(showingDebugPause)
     {
-        currentInputKey = foundPairing->first;
-        keyPressWaitFlag = true;
+        static const std::array<juce::String, 5> reasonNames {"", "breakpoint", "watchpoint", "step", "paused"};
+        
+        juce::String status = "Stopped at " + juce::String::toHexString(core.getProgramCounter()).paddedLeft('0', 4)
+                            + " (" + reasonNames[size_t(debugger.getStopReason())];
+        
+        if(debugger.getStopReason() == Chip8StopReason::watchpoint)
+        {
+            status += " on " + juce::String::toHexString(debugger.getStopAddress()).paddedLeft('0', 4);
+        }
+        
+        g.setColour(juce::Colours::black.withAlpha(0.6f));
+        g.fillRect(getLocalBounds().removeFromBottom(24));
+        g.setColour(juce::Colours::orange);
+        g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 14.0f, juce::Font::plain));
+        g.drawText(status + ")", getLocalBounds().removeFromBottom(24).reduced(8, 0), juce::Justification::centredLeft);
+    }
+    
+    if(hudVisible)
+    {
+        hud.addPaint(juce::Time::getHighResolutionTicks() - paintStart);
+        hud.draw(g, getLocalBounds());
+    }
+}
+
+void Chip8Emulator::resized()
+{
+    renderer.setTargetSize(getWidth(), getHeight());
+}
+
+void Chip8Emulator::timerCallback()
+{
+    if(turboRunning)
+    {
+        if(turboStoppedByDebugger)
+        {
+            setTurbo(false);
+            checkDebugState();
+            return;
+        }
+        
+        updateKeyState();
+        presentTurboFrame();
+        updateStats(presentedTurboFrame.cycleCount);
+        return;
     }
     
+    runFrame();
+}
+
+bool Chip8Emulator::keyPressed(const juce::KeyPress& key, juce::Component* originatingComponent)
+{
+    updateKeyState();
+    
+    return false;
+}
+
+bool Chip8Emulator::keyStateChanged(bool isKeyDown, juce::Component* originatingComponent)
+{
+    updateKeyState();
+    
     return false;
 }
 
 void Chip8Emulator::audioDeviceIOCallback(const float** inputChannelData, int numInputChannels, float** outputChannelData, int numOutputChannels, int numSamples)
+{
+    const int64_t callbackStart = juce::Time::getHighResolutionTicks();
+    
+    writeAudio(outputChannelData, numOutputChannels, numSamples);
+    
+    //Every channel carries the same beeper
+    if(numOutputChannels > 0)
+    {
+        capture.pushAudio(outputChannelData[0], numSamples);
+    }
+    
+    if(const double sampleRate = audioSampleRate.load(std::memory_order_relaxed))
+    {
+        const int64_t budgetTicks = int64_t(numSamples / sampleRate * juce::Time::getHighResolutionTicksPerSecond());
+        hud.addAudioCallback(juce::Time::getHighResolutionTicks() - callbackStart, budgetTicks);
+    }
+}
+
+void Chip8Emulator::writeAudio(float** outputChannelData, int numOutputChannels, int numSamples)
 {
     if(!audioPlaying)
     {
@@ -125,6 +458,7 @@ void Chip8Emulator::audioDeviceIOCallback(const float** inputChannelData, int nu
 void Chip8Emulator::audioDeviceAboutToStart(juce::AudioIODevice* device)
 {
     audioGenerator.setSampleRate(device->getCurrentSampleRate());
+    audioSampleRate = device->getCurrentSampleRate();
 }
 
 void Chip8Emulator::audioDeviceStopped()
@@ -132,578 +466,135 @@ void Chip8Emulator::audioDeviceStopped()
     
 }
 
-void Chip8Emulator::runCycle()
+void Chip8Emulator::runFrame()
 {
-    fetchOpcode();
-
-    decodeAndExecuteOpcode();
+    updateKeyState();
+    
+    core.runFrame();
     
-    updateTimers();
+    audioPlaying = core.isSoundActive();
+    
+    if(runAhead.getFramesAhead() > 0 && !debugger.isActive())
+    {
+        updateRunAheadDisplay();
+    }
+    else
+    {
+        updateDisplay();
+    }
+    
+    checkDebugState();
+    notifyCoreUpdated();
+    updateStats(core.getCycleCount());
 }
 
-void Chip8Emulator::fetchOpcode()
+void Chip8Emulator::updateStats(uint64_t cycleCount)
 {
-    const uint8_t firstByte = memory[programCounter];
-    const uint8_t secondByte = memory[programCounter + 1];
+    if(hudVisible && hud.tick(cycleCount))
+    {
+        repaint(hud.getArea(getLocalBounds()));
+    }
     
-    //Shift the first byte to the start
-    currentOpcode = firstByte << 8;
-    currentOpcode |= secondByte;
+    if(++framesSinceOpcodeReport >= timerRateHz)
+    {
+        framesSinceOpcodeReport = 0;
+        reportUnknownOpcodes();
+    }
 }
 
-void Chip8Emulator::decodeAndExecuteOpcode()
+uint16_t Chip8Emulator::getKeyState() const
 {
-    //Look at the first digit of the opcode
-    switch(0xF000 & currentOpcode)
+    uint16_t keyState = 0;
+    
+    for(const auto& pairing : keyPairings)
     {
-        case 0x0000:
-        {
-            switch(0x000F & currentOpcode)
-            {
-                case 0x0000:
-                {
-                    clearScreen();
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x000E:
-                {
-                    programCounter = stack[--stackPointer];
-                    programCounter += 2;
-                    return;
-                }
-
-                default:
-                {
-                    reportUnrecognisedOpcode();
-                    
-                    programCounter += 2;
-                    
-                    return;
-                }
-            }
-            return;
-        }
-            
-        case 0x1000:
+        if(juce::KeyPress::isKeyCurrentlyDown(pairing.second))
         {
-            programCounter = 0x0FFF & currentOpcode;
-            return;
-        }
-            
-        case 0x2000:
-        {
-            //CALL SUBROUTINE
-            stack[stackPointer++] = programCounter;
-            programCounter = 0x0FFF & currentOpcode;
-            return;
-        }
-            
-        case 0x3000:
-        {
-            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t val = 0x00FF & currentOpcode;
-            
-            if(vRegisters[registerIndex] == val)
-            {
-                //Skip Next Instruction
-                programCounter += 2;
-            }
-            
-            programCounter += 2;
-            return;
-        }
-            
-        case 0x4000:
-        {
-            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t val = 0x00FF & currentOpcode;
-            
-            if(vRegisters[registerIndex] != val)
-            {
-                //Skip Next Instruction
-                programCounter += 2;
-            }
-            
-            programCounter += 2;
-            return;
-        }
-            
-        case 0x5000:
-        {
-            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
-            
-            if(vRegisters[firstRegisterIndex] == vRegisters[secondRegisterIndex])
-            {
-                //Skip Next Instrution
-                programCounter += 2;
-            }
-            
-            programCounter += 2;
-            return;
-        };
-            
-        case 0x6000:
-        {
-            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t val = 0x00FF & currentOpcode;
-            
-            vRegisters[registerIndex] = val;
-            
-            programCounter += 2;
-            return;
-        }
-            
-        case 0x7000:
-        {
-            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t val = 0x00FF & currentOpcode;
-            
-            vRegisters[registerIndex] += val;
-            
-            programCounter += 2;
-            return;
-        }
-            
-        case 0x8000:
-        {
-            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
-            
-            switch(0x000F & currentOpcode)
-            {
-                case 0x0000:
-                {
-                    vRegisters[firstRegisterIndex] = vRegisters[secondRegisterIndex];
-                    programCounter += 2;
-                    return;
-                }
-                
-                case 0x0001:
-                {
-                    vRegisters[firstRegisterIndex] |= vRegisters[secondRegisterIndex];
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0002:
-                {
-                    vRegisters[firstRegisterIndex] &= vRegisters[secondRegisterIndex];
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0003:
-                {
-                    vRegisters[firstRegisterIndex] ^= vRegisters[secondRegisterIndex];
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0004:
-                {
-                    //Set the carry flag
-                    vRegisters.back() = checkForCarry(vRegisters[firstRegisterIndex], vRegisters[secondRegisterIndex]);
-                    
-                    vRegisters[firstRegisterIndex] += vRegisters[secondRegisterIndex];
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0005:
-                {
-                    //Set the borrow flag
-                    vRegisters.back() = !checkForBorrow(vRegisters[firstRegisterIndex], vRegisters[secondRegisterIndex]);
-                    
-                    vRegisters[firstRegisterIndex] -= vRegisters[secondRegisterIndex];
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0006:
-                {
-                    //Store the least significant bit in the carry flag
-                    vRegisters.back() = 0x1 & vRegisters[firstRegisterIndex];
-                    
-                    vRegisters[firstRegisterIndex] >>= 1;
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0007:
-                {
-                    //Set the borrow flag
-                    vRegisters.back() = !checkForBorrow(vRegisters[secondRegisterIndex], vRegisters[firstRegisterIndex]);
-                    
-                    vRegisters[firstRegisterIndex] = vRegisters[secondRegisterIndex] - vRegisters[firstRegisterIndex];
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x000E:
-                {
-                    //Store the most significant bit in the carry flag
-                    vRegisters.back() = (0x80 & vRegisters[firstRegisterIndex]) >> 7;
-                    
-                    vRegisters[firstRegisterIndex] <<= 1;
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                default:
-                {
-                    reportUnrecognisedOpcode();
-                    programCounter += 2;
-                    return;
-                }
-            }
-        }
-            
-        case 0x9000:
-        {
-            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
-            
-            if(vRegisters[firstRegisterIndex] != vRegisters[secondRegisterIndex])
-            {
-                //Skip Next Instrution
-                programCounter += 2;
-            }
-            
-            programCounter +=2;
-            return;
-        }
-            
-        case 0xA000:
-        {
-            indexRegister = 0x0FFF & currentOpcode;
-            programCounter += 2;
-            return;
-        }
-            
-        case 0xB000:
-        {
-            uint8_t offset = vRegisters[0];
-            uint16_t newMemoryLocation = 0x0FFF & currentOpcode;
-            
-            programCounter = newMemoryLocation + offset;
-            
-            return;
-        }
-            
-        case 0xC000:
-        {
-            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t value = 0x00FF & currentOpcode;
-            
-            std::random_device dev;
-            std::mt19937 generator(dev());
-            std::uniform_int_distribution<uint8_t> distributer(0, 255);;
-            
-            uint8_t randomVal = distributer(generator);
-            
-            vRegisters[registerIndex] = value & randomVal;
-            
-            programCounter += 2;
-            
-            return;
-        }
-            
-        case 0xD000:
-        {
-            vRegisters.back() = 0;
-            
-            uint8_t firstRegisterIndex = (0x0F00 & currentOpcode) >> 8;
-            uint8_t spriteXPos = vRegisters[firstRegisterIndex];
-            
-            uint8_t secondRegisterIndex = (0x00F0 & currentOpcode) >> 4;
-            uint8_t spriteYPos = vRegisters[secondRegisterIndex];
-            
-            uint8_t spriteHeight = 0x000F & currentOpcode;
-            
-            //Go through each vertical line of pixels
-            for(int y = 0; y < spriteHeight; ++y)
-            {
-                uint8_t horizontalPixels = memory[indexRegister + y];
-                
-                for(int xOffset = 0; xOffset < 8; ++xOffset)
-                {
-                    //Check if the pixel here is on
-                    if((horizontalPixels & (0x80 >> xOffset)) != 0)
-                    {
-                        int x = spriteXPos + xOffset;
-                        
-                        //If the pixel has already been set as on
-                        if(display.getPixelAt(x, y + spriteYPos) == juce::Colours::white)
-                        {
-                            display.setPixelAt(x, y + spriteYPos, juce::Colours::black);
-                            
-                            //Set the carry flag to true
-                            vRegisters.back() = 1;
-                        }
-                        else
-                        {
-                            display.setPixelAt(x, y + spriteYPos, juce::Colours::white);
-                        }
-                    }
-                }
-            }
-            
-            repaint();
-            programCounter += 2;
-            
-            return;
-        }
-            
-        case 0xE000:
-        {
-            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
-            
-            switch(0x00FF & currentOpcode)
-            {
-                case 0x009E:
-                {
-                    uint8_t keyToCheck = vRegisters[registerIndex];
-                    
-                    const auto foundIt = std::find_if(keyPairings.cbegin(), keyPairings.cend(), [keyToCheck](const auto& keyPair)
-                    {
-                        return keyToCheck == keyPair.first;
-                    });
-                    
-                    if(foundIt != keyPairings.end() && juce::KeyPress::isKeyCurrentlyDown(foundIt->second))
-                    {
-                        //Skip next instruction
-                        programCounter += 2;
-                    }
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x00A1:
-                {
-                    uint8_t keyToCheck = vRegisters[registerIndex];
-                    
-                    const auto foundIt = std::find_if(keyPairings.cbegin(), keyPairings.cend(), [keyToCheck](const auto& keyPair)
-                    {
-                        return keyToCheck == keyPair.first;
-                    });
-                    
-                    if(foundIt != keyPairings.end() && !juce::KeyPress::isKeyCurrentlyDown(foundIt->second))
-                    {
-                        //Skip next instruction
-                        programCounter += 2;
-                    }
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                default:
-                {
-                    reportUnrecognisedOpcode();
-                    programCounter += 2;
-                    return;
-                }
-            }
-        }
-            
-        case 0xF000:
-        {
-            uint8_t registerIndex = (0x0F00 & currentOpcode) >> 8;
-            
-            switch(0x00FF & currentOpcode)
-            {
-                case 0x0007:
-                {
-                    vRegisters[registerIndex] = delayTimer;
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x000A:
-                {
-                    keyPressWaitFlag = false;
-                    addKeyListener(this);
-                    
-                    std::cout << "Waiting for key " << std::endl;
-                    
-                    //Wait for a key press
-                    while(!keyPressWaitFlag)
-                    {
-                        ;
-                    }
-                    
-                    vRegisters[registerIndex] = currentInputKey;
-                    
-                    currentInputKey = 0;
-                    removeKeyListener(this);
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0015:
-                {
-                    delayTimer = vRegisters[registerIndex];
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0018:
-                {
-                    soundTimer = vRegisters[registerIndex];
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x001E:
-                {
-                    indexRegister = indexRegister += vRegisters[registerIndex];
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0029:
-                {
-                    indexRegister = vRegisters[registerIndex] * 0x5;
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0033:
-                {
-                    uint8_t registerValue = vRegisters[registerIndex];
-                    
-                    memory[indexRegister]     = registerValue / 100;
-                    memory[indexRegister + 1] = (registerValue / 10) % 10;
-                    memory[indexRegister + 2] = (registerValue % 100) % 10;
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0055:
-                {
-                    uint16_t currentLocation = indexRegister;
-                    
-                    std::for_each(vRegisters.cbegin(), vRegisters.cbegin() + registerIndex + 1, [&currentLocation, this](uint8_t registerValue)
-                    {
-                        memory[currentLocation++] = registerValue;
-                    });
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                case 0x0065:
-                {
-                    uint16_t currentLocation = indexRegister;
-                    
-                    std::for_each(vRegisters.begin(), vRegisters.begin() + registerIndex + 1, [&currentLocation, this](uint8_t& registerValue)
-                    {
-                        registerValue = memory[currentLocation++];
-                    });
-                    
-                    
-                    programCounter += 2;
-                    return;
-                }
-                    
-                default:
-                {
-                    reportUnrecognisedOpcode();
-                    programCounter += 2;
-                    return;
-                }
-            }
-        }
-            
-        default:
-        {
-            reportUnrecognisedOpcode();
-            programCounter += 2;
-            return;
+            keyState |= 1 << pairing.first;
         }
     }
+    
+    return keyState;
 }
 
-void Chip8Emulator::reportUnrecognisedOpcode()
-{
-    std::cout << "Unknown Opcode Encountered: " << std::hex << currentOpcode << std::endl;
-}
-
-void Chip8Emulator::updateTimers()
+void Chip8Emulator::updateKeyState()
 {
-    if(delayTimer > 0)
+    //The turbo thread owns the core while it runs, it picks keys up from here
+    if(turboRunning)
     {
-        --delayTimer;
+        turboKeyState.store(getKeyState(), std::memory_order_relaxed);
+        return;
     }
     
-    if(soundTimer != 0)
-    {
-        audioPlaying = true;
-        --soundTimer;
-    }
-    else
-    {
-        audioPlaying = false;
-    }
+    core.setKeyState(getKeyState());
 }
 
-bool Chip8Emulator::checkForCarry(uint8_t first, uint8_t second) const
+void Chip8Emulator::updateDisplay()
 {
-    uint16_t result = first + second;
-    return result > std::numeric_limits<uint8_t>::max();
+    const uint64_t replacedRows = showingRunAhead ? ~uint64_t(0) : 0;
+    showingRunAhead = false;
+    
+    presentFrame(core.getFramebuffer(), core.getDisplayWidth(), core.getDisplayHeight(), core.takeDirtyRows() | replacedRows);
 }
 
-bool Chip8Emulator::checkForBorrow(uint8_t first, uint8_t second) const
+void Chip8Emulator::updateRunAheadDisplay()
 {
-    return second > first;
+    runAhead.update(core);
+    
+    const uint64_t replacedRows = showingRunAhead ? 0 : ~uint64_t(0);
+    showingRunAhead = true;
+    
+    const Chip8Core& aheadCore = runAhead.getCore();
+    presentFrame(aheadCore.getFramebuffer(), aheadCore.getDisplayWidth(), aheadCore.getDisplayHeight(), runAhead.takeDirtyRows() | replacedRows);
+    
+    //None of the core's own frame is on screen, switching back redraws all of it
+    core.takeDirtyRows();
 }
 
-std::array<uint8_t, 80> Chip8Emulator::getFontset() const
+void Chip8Emulator::presentFrame(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels, uint64_t dirtyRows)
 {
-    return {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-      };
-}
-
-void Chip8Emulator::clearScreen()
-{
-    //Clear the screen
-    for(int x = 0; x < numWidthPixels; ++x)
-    {
-        for(int y = 0; y < numHeightPixels; ++y)
+    capture.pushFrame(framebuffer, widthPixels, heightPixels);
+    
+    if(phosphorEnabled)
+    {
+        //The filter decides what changed, pixels keep fading even when nothing is drawn
+        dirtyRows = phosphor.update(framebuffer, widthPixels, heightPixels);
+        
+        if(dirtyRows != 0)
         {
-            display.setPixelAt(x, y, juce::Colours::black);
+            renderer.update(phosphor.getIntensities(), widthPixels, heightPixels, dirtyRows);
+            requestRepaint();
         }
+        
+        return;
     }
+    
+    if(dirtyRows != 0)
+    {
+        renderer.update(framebuffer, widthPixels, heightPixels, dirtyRows);
+        requestRepaint();
+    }
+}
+
+void Chip8Emulator::requestRepaint()
+{
+    hud.addRepaintRequest();
     repaint();
 }
 
+void Chip8Emulator::reportUnknownOpcodes()
+{
+    core.getUnknownOpcodes().drain([](uint16_t opcode, uint32_t count)
+    {
+        juce::Logger::writeToLog("Unknown Opcode Encountered: " + juce::String::toHexString(opcode).paddedLeft('0', 4) + " (x" + juce::String(count) + ")");
+    });
+    
+    if(const uint32_t overflowCount = core.getUnknownOpcodes().takeOverflowCount())
+    {
+        juce::Logger::writeToLog(juce::String(overflowCount) + " more unknown opcodes didn't fit in the table");
+    }
+}
+
 std::array<std::pair<uint8_t, int>, 16> Chip8Emulator::getDefaultKeyPairings() const
 {
     return {
@@ -725,3 +616,71 @@ std::array<std::pair<uint8_t, int>, 16> Chip8Emulator::getDefaultKeyPairings() c
         std::make_pair(0x0F, 86)
     };
 }
+
+void Chip8Emulator::turboLoop()
+{
+    using Clock = std::chrono::steady_clock;
+    
+    //Published twice per display frame so the timer never shows one that is a whole frame old
+    const auto publishInterval = std::chrono::microseconds(1000000 / (timerRateHz * 2));
+    
+    auto lastPublish = Clock::now();
+    uint64_t dirtyRows = 0;
+    
+    while(turboRunning.load(std::memory_order_relaxed))
+    {
+        core.setKeyState(turboKeyState.load(std::memory_order_relaxed));
+        
+        for(int frame = 0; frame < turboFramesPerCheck; ++frame)
+        {
+            core.runFrame();
+            dirtyRows |= core.takeDirtyRows();
+        }
+        
+        //Nothing more will happen until the message thread takes the core back and shows the stop
+        if(debugger.isPaused())
+        {
+            turboStoppedByDebugger = true;
+            break;
+        }
+        
+        const auto now = Clock::now();
+        
+        if(now - lastPublish >= publishInterval)
+        {
+            publishTurboFrame(dirtyRows);
+            dirtyRows = 0;
+            lastPublish = now;
+        }
+    }
+    
+    publishTurboFrame(dirtyRows);
+}
+
+void Chip8Emulator::publishTurboFrame(uint64_t dirtyRows)
+{
+    std::lock_guard<std::mutex> lock(turboFrameLock);
+    
+    latestTurboFrame.framebuffer = core.getFramebuffer();
+    latestTurboFrame.widthPixels = core.getDisplayWidth();
+    latestTurboFrame.heightPixels = core.getDisplayHeight();
+    latestTurboFrame.cycleCount = core.getCycleCount();
+    
+    //Frames the timer hasn't taken yet keep their dirty rows
+    latestTurboFrame.dirtyRows |= dirtyRows;
+}
+
+void Chip8Emulator::presentTurboFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(turboFrameLock);
+        
+        presentedTurboFrame = latestTurboFrame;
+        latestTurboFrame.dirtyRows = 0;
+    }
+    
+    const uint64_t replacedRows = showingRunAhead ? ~uint64_t(0) : 0;
+    showingRunAhead = false;
+    
+    presentFrame(presentedTurboFrame.framebuffer, presentedTurboFrame.widthPixels, presentedTurboFrame.heightPixels, presentedTurboFrame.dirtyRows | replacedRows);
+}
@@ -11,8 +11,18 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include <random>
+#include "CaptureRecorder.h"
+#include "Chip8Core.h"
+#include "Chip8RunAhead.h"
+#include "FramebufferRenderer.h"
+#include "PerformanceHud.h"
+#include "PhosphorFilter.h"
+#include "RecompiledProgram.h"
 #include "SineWaveGenerator.h"
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 class Chip8Emulator  : public juce::Component,
                        public juce::Timer,
@@ -24,69 +34,185 @@ public:
     ~Chip8Emulator();
     
     void load(std::istream& programData);
+    void load(const uint8_t* programData, size_t programSize);
+    
+    //Takes effect on the next load. Plain CHIP-8 by default, the later profiles aren't supersets
+    //in practice: DXY0, skips over F000 and I wrapping all behave differently
+    void setProfile(Chip8Profile newProfile);
+    Chip8Profile getProfile() const {return core.getProfile();}
     
     void setRefreshRate(int newRefreshRateHz);
     
+    void setPhosphorEnabled(bool enabled);
+    bool getPhosphorEnabled() const {return phosphorEnabled;}
+    void setPhosphorPersistence(float persistence);
+    
     void setPlayState(bool play);
     bool getIsPlaying() const {return isPlaying;}
     
+    //Streams every instruction the core runs to traceFile, read it back with Tools/TraceDump
+    bool startTrace(const juce::File& traceFile);
+    void stopTrace();
+    bool getIsTracing() const {return tracer.getIsRecording();}
+    
+    //Records every frame shown to a Y4M video, scale times the size of the hi-res screen, and the beeper
+    //to a WAV next to it. Nothing waits on the disk, frames and samples are dropped if it can't keep up
+    bool startCapture(const juce::File& videoFile, int scale);
+    void stopCapture();
+    bool getIsCapturing() const {return capture.getIsRecording();}
+    
+    //Runs the ROM natively from a library built with Tools/Recompile, whenever the loaded ROM is
+    //the one it was compiled from. Anything else still gets interpreted
+    bool loadRecompiledProgram(const juce::File& library);
+    void unloadRecompiledProgram();
+    bool getIsRunningRecompiled() const {return core.isRunningRecompiled();}
+    
+    //Runs the core as fast as it will go on its own thread, showing the latest frame at the
+    //normal display rate with the beeper muted. Only has an effect while playing and not stopped in the
+    //debugger, a breakpoint or watchpoint hit while it runs drops back to normal speed to show the stop
+    void setTurbo(bool enabled);
+    bool getIsTurbo() const {return turboRunning;}
+    
+    //Breakpoints stop before the instruction at the address, watchpoints after a store to it
+    void setBreakpoint(uint16_t address, bool enabled);
+    bool hasBreakpoint(uint16_t address) const {return debugger.hasBreakpoint(address);}
+    void setWatchpoint(uint16_t address, bool enabled);
+    bool hasWatchpoint(uint16_t address) const {return debugger.hasWatchpoint(address);}
+    
+    void debugPause();
+    void debugResume();
+    
+    //Runs exactly one instruction, even when not playing
+    void debugStep();
+    
+    bool getIsDebugPaused() const {return debugger.isPaused();}
+    
+    //Called on the message thread when execution stops or resumes
+    std::function<void()> onDebugStateChanged;
+    
+    //Called on the message thread after each frame and debugger step, not while fast-forwarding
+    std::function<void(const Chip8Core&)> onCoreUpdated;
+    
+    //Calls onCoreUpdated straight away, for a view that has just been shown
+    void notifyCoreUpdated();
+    
+    //Shows the machine this many frames ahead of itself, run on with the keys held now, so input reaches
+    //the screen sooner. Sound still comes from the real machine. Not used while fast-forwarding or debugging
+    void setRunAheadFrames(int numFrames) {runAhead.setFramesAhead(numFrames);}
+    int getRunAheadFrames() const {return runAhead.getFramesAhead();}
+    
+    //Overlays measured instruction rate, tick accuracy, paint cost and audio load
+    void setHudVisible(bool visible);
+    bool getHudVisible() const {return hudVisible;}
+    
 private:
     void paint(juce::Graphics& g) override;
+    void resized() override;
     
     void timerCallback() override;
     
     bool keyPressed(const juce::KeyPress &key, juce::Component *originatingComponent) override;
+    bool keyStateChanged(bool isKeyDown, juce::Component* originatingComponent) override;
     
     void audioDeviceIOCallback(const float** inputChannelData, int numInputChannels, float** outputChannelData, int numOutputChannels, int numSamples) override;
 
     void audioDeviceAboutToStart(juce::AudioIODevice* device) override;
     void audioDeviceStopped() override;
     
-    void runCycle();
+    void writeAudio(float** outputChannelData, int numOutputChannels, int numSamples);
+    
+    void runFrame();
+    void updateStats(uint64_t cycleCount);
     
-    void fetchOpcode();
-    void decodeAndExecuteOpcode();
+    uint16_t getKeyState() const;
+    void updateKeyState();
+    void updateDisplay();
+    void updateRunAheadDisplay();
+    void presentFrame(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels, uint64_t dirtyRows);
+    void requestRepaint();
     
-    void reportUnrecognisedOpcode();
+    void reportUnknownOpcodes();
     
-    void updateTimers();
+    //Only attaches the debugger to the core while it has something to check
+    void updateDebugger();
+    void checkDebugState();
     
-    bool checkForCarry(uint8_t first, uint8_t second) const;
-    bool checkForBorrow(uint8_t first, uint8_t second) const;
+    std::array<std::pair<uint8_t, int>, 16> getDefaultKeyPairings() const;
     
-    std::array<uint8_t, 80> getFontset() const;
+    void turboLoop();
+    void publishTurboFrame(uint64_t dirtyRows);
+    void presentTurboFrame();
     
-    void clearScreen();
+    //Stops the turbo thread for its lifetime, so the message thread can touch the core
+    class ScopedTurboPause
+    {
+    public:
+        ScopedTurboPause(Chip8Emulator& emulatorToPause) : emulator(emulatorToPause), wasRunning(emulatorToPause.getIsTurbo()) {emulator.setTurbo(false);}
+        ~ScopedTurboPause() {emulator.setTurbo(wasRunning);}
+        
+    private:
+        Chip8Emulator& emulator;
+        const bool wasRunning;
+    };
     
-    std::array<std::pair<uint8_t, int>, 16> getDefaultKeyPairings() const;
+    Chip8Core core;
+    TraceRecorder tracer;
+    CaptureRecorder capture;
+    RecompiledProgram recompiled;
     
-    uint16_t currentOpcode;
-    std::array<uint8_t, 4096> memory;
+    Chip8Debugger debugger;
+    bool showingDebugPause = false;
     
-    //Registers
-    std::array<uint8_t, 16> vRegisters;
+    FramebufferRenderer renderer;
     
-    uint16_t indexRegister;
-    uint16_t programCounter;
+    PerformanceHud hud;
+    bool hudVisible = false;
     
-    std::array<uint16_t, 16> stack;
-    uint16_t stackPointer;
+    //Written on the audio thread's start callback, read in the audio callback
+    std::atomic<double> audioSampleRate {0.0};
     
-    uint8_t delayTimer;
-    uint8_t soundTimer;
+    PhosphorFilter phosphor;
+    bool phosphorEnabled = false;
     
-    const int numWidthPixels = 64;
-    const int numHeightPixels = 32;
-    juce::Image display;
+    Chip8RunAhead runAhead;
     
-    bool keyPressWaitFlag = false;
-    uint8_t currentInputKey = 0;
+    //The run ahead frame is on screen, so the core's own dirty rows don't describe what needs redrawing
+    bool showingRunAhead = false;
     
     std::array<std::pair<uint8_t, int>, 16> keyPairings;
     
+    static constexpr int timerRateHz = 60;
+    
     int refreshRate = 60;
+    
+    //Unknown opcodes are logged once a second rather than as they happen
+    int framesSinceOpcodeReport = 0;
     bool isPlaying = false;
     
+    std::thread turboThread;
+    std::atomic<bool> turboRunning {false};
+    std::atomic<uint16_t> turboKeyState {0};
+    
+    //Set by the turbo thread as it gives up on a debugger stop, the timer then ends turbo
+    std::atomic<bool> turboStoppedByDebugger {false};
+    
+    //Frames run between clock checks, checking every frame would cost about as much as the frame
+    static constexpr int turboFramesPerCheck = 64;
+    
+    struct TurboFrame
+    {
+        Chip8Core::Framebuffer framebuffer {};
+        int widthPixels = Chip8Core::loResWidthPixels;
+        int heightPixels = Chip8Core::loResHeightPixels;
+        uint64_t dirtyRows = 0;
+        uint64_t cycleCount = 0;
+    };
+    
+    //Written by the turbo thread, taken by the timer
+    std::mutex turboFrameLock;
+    TurboFrame latestTurboFrame;
+    TurboFrame presentedTurboFrame;
+    
     SineWaveGenerator audioGenerator;
     std::atomic<bool> audioPlaying;
 };
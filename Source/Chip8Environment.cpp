@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    Chip8Environment.cpp
+    Created: 11 Jun 2022 2:40:55pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "Chip8Environment.h"
+#include <algorithm>
+
+Chip8Environment::Chip8Environment(const std::vector<uint8_t>& rom, Chip8Profile profile)
+{
+    core.setProfile(profile);
+    core.load(rom.data(), rom.size());
+    reset(0);
+}
+
+const Chip8Core::Framebuffer& Chip8Environment::reset(uint32_t seed)
+{
+    core.reset();
+    core.setKeyState(0);
+    core.setSeed(seed);
+
+    episodeFrame = 0;
+
+    return core.getFramebuffer();
+}
+
+Chip8Environment::StepResult Chip8Environment::step(uint16_t actionKeyMask, int frameskip)
+{
+    core.setKeyState(actionKeyMask);
+
+    for(int frame = 0; frame < std::max(frameskip, 1); ++frame)
+    {
+        core.runFrame();
+        ++episodeFrame;
+
+        if(core.isHalted())
+        {
+            break;
+        }
+    }
+
+    StepResult result;
+
+    if(rewardFunction)
+    {
+        result.reward = rewardFunction(core);
+    }
+
+    //A halted program can never do anything again, so that always ends the episode
+    result.done = core.isHalted()
+               || (doneFunction && doneFunction(core))
+               || (maxEpisodeFrames > 0 && episodeFrame >= maxEpisodeFrames);
+
+    return result;
+}
+
+Chip8EnvironmentBatch::Chip8EnvironmentBatch(std::vector<uint8_t> gameRom, int numEnvironments, int numThreads)
+    : rom(std::move(gameRom)), batch(numEnvironments, numThreads)
+{
+    const size_t n = size_t(batch.getNumInstances());
+
+    episodeFrames.assign(n, 0);
+    nextSeeds.assign(n, 0);
+    rewards.assign(n, 0.0f);
+    dones.assign(n, 0);
+
+    reset(0);
+}
+
+void Chip8EnvironmentBatch::reset(uint32_t seed)
+{
+    for(int environment = 0; environment < getNumEnvironments(); ++environment)
+    {
+        reset(environment, seed + uint32_t(environment));
+    }
+}
+
+void Chip8EnvironmentBatch::reset(int environment, uint32_t seed)
+{
+    batch.load(environment, rom.data(), rom.size());
+    batch.setKeyState(environment, 0);
+    batch.setSeed(environment, seed);
+
+    episodeFrames[environment] = 0;
+    rewards[environment] = 0.0f;
+    dones[environment] = 0;
+
+    //Automatic resets carry on from here without repeating any other environment's seed
+    nextSeeds[environment] = seed + uint32_t(getNumEnvironments());
+}
+
+void Chip8EnvironmentBatch::step(const uint16_t* actionKeyMasks, int frameskip)
+{
+    const int numEnvironments = getNumEnvironments();
+    frameskip = std::max(frameskip, 1);
+
+    for(int environment = 0; environment < numEnvironments; ++environment)
+    {
+        if(dones[environment] != 0)
+        {
+            reset(environment, nextSeeds[environment]);
+        }
+
+        batch.setKeyState(environment, actionKeyMasks[environment]);
+    }
+
+    //Every frame of the step runs in one go across the pool
+    batch.runFrames(frameskip);
+
+    for(int environment = 0; environment < numEnvironments; ++environment)
+    {
+        episodeFrames[environment] += frameskip;
+
+        rewards[environment] = rewardFunction ? rewardFunction(batch, environment) : 0.0f;
+
+        dones[environment] = (doneFunction && doneFunction(batch, environment))
+                          || (maxEpisodeFrames > 0 && episodeFrames[environment] >= maxEpisodeFrames);
+    }
+}
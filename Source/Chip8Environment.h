@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    Chip8Environment.h
+    Created: 11 Jun 2022 2:40:55pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Batch.h"
+#include "Chip8Core.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//A game as a reinforcement learning environment: reset, then step with the keys to hold.
+//What counts as reward and when an episode is over depend on the game, so both are supplied as hooks
+class Chip8Environment
+{
+public:
+    struct StepResult
+    {
+        float reward = 0.0f;
+        bool done = false;
+    };
+
+    //Called after every step, once all of its frames have run
+    using RewardFunction = std::function<float(const Chip8Core&)>;
+    using DoneFunction = std::function<bool(const Chip8Core&)>;
+
+    explicit Chip8Environment(const std::vector<uint8_t>& rom, Chip8Profile profile = Chip8Profile::chip8);
+
+    void setRewardFunction(RewardFunction newRewardFunction) {rewardFunction = std::move(newRewardFunction);}
+    void setDoneFunction(DoneFunction newDoneFunction) {doneFunction = std::move(newDoneFunction);}
+
+    //Episodes are cut off after this many frames, 0 for no limit
+    void setMaxEpisodeFrames(int newMaxEpisodeFrames) {maxEpisodeFrames = newMaxEpisodeFrames;}
+
+    void setCyclesPerFrame(int newCyclesPerFrame) {core.setCyclesPerFrame(newCyclesPerFrame);}
+
+    //Puts the ROM back as it was first loaded, returns the first observation
+    const Chip8Core::Framebuffer& reset(uint32_t seed);
+
+    //Holds actionKeyMask down for frameskip frames, run back to back at full speed
+    StepResult step(uint16_t actionKeyMask, int frameskip = 1);
+
+    //The core's own framebuffer, not a copy, so it changes on the next step
+    const Chip8Core::Framebuffer& getObservation() const {return core.getFramebuffer();}
+
+    const Chip8Core& getCore() const {return core;}
+    int getEpisodeFrame() const {return episodeFrame;}
+
+private:
+    Chip8Core core;
+
+    RewardFunction rewardFunction;
+    DoneFunction doneFunction;
+
+    int maxEpisodeFrames = 0;
+    int episodeFrame = 0;
+};
+
+//Many copies of the same game stepped together on a Chip8Batch, CHIP-8 instruction set only.
+//Rewards and done flags come back as arrays, one entry per environment
+class Chip8EnvironmentBatch
+{
+public:
+    using RewardFunction = std::function<float(const Chip8Batch&, int environment)>;
+    using DoneFunction = std::function<bool(const Chip8Batch&, int environment)>;
+
+    Chip8EnvironmentBatch(std::vector<uint8_t> gameRom, int numEnvironments, int numThreads = 0);
+
+    int getNumEnvironments() const {return batch.getNumInstances();}
+
+    void setRewardFunction(RewardFunction newRewardFunction) {rewardFunction = std::move(newRewardFunction);}
+    void setDoneFunction(DoneFunction newDoneFunction) {doneFunction = std::move(newDoneFunction);}
+    void setMaxEpisodeFrames(int newMaxEpisodeFrames) {maxEpisodeFrames = newMaxEpisodeFrames;}
+    void setCyclesPerFrame(int newCyclesPerFrame) {batch.setCyclesPerFrame(newCyclesPerFrame);}
+
+    //Environment n is seeded with seed + n
+    void reset(uint32_t seed);
+    void reset(int environment, uint32_t seed);
+
+    //actionKeyMasks holds one key mask per environment. Environments that finished on the previous step
+    //are reset first, so their final observation can still be read after the step that ended them
+    void step(const uint16_t* actionKeyMasks, int frameskip = 1);
+
+    const float* getRewards() const {return rewards.data();}
+    const uint8_t* getDones() const {return dones.data();}
+
+    //Points into the batch's framebuffers, Chip8Batch::heightPixels words with the leftmost pixel in the top bit
+    const uint64_t* getObservation(int environment) const {return batch.getFramebuffer(environment);}
+
+    const Chip8Batch& getBatch() const {return batch;}
+
+private:
+    std::vector<uint8_t> rom;
+    Chip8Batch batch;
+
+    RewardFunction rewardFunction;
+    DoneFunction doneFunction;
+
+    int maxEpisodeFrames = 0;
+    std::vector<int> episodeFrames;
+    std::vector<uint32_t> nextSeeds;
+
+    std::vector<float> rewards;
+    std::vector<uint8_t> dones;
+};
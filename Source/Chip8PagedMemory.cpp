@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    Chip8PagedMemory.cpp
+    Created: 1 Aug 2022 9:12:05am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "Chip8PagedMemory.h"
+#include <cstring>
+
+Chip8PagedMemory Chip8PagedMemory::withChanges(const std::vector<uint8_t>& memory, const PageMask& changedPages) const
+{
+    //A different size of memory shares nothing
+    const bool sameSize = table != nullptr && memory.size() == size;
+    const int numPages = int(memory.size() / pageSize);
+
+    bool anyChanged = !sameSize;
+
+    for(int page = 0; page < numPages && !anyChanged; page += 64)
+    {
+        anyChanged = changedPages[page / 64] != 0;
+    }
+
+    if(!anyChanged)
+    {
+        return *this;
+    }
+
+    auto newTable = std::make_shared<Table>();
+
+    for(int group = 0; group * pagesPerGroup < numPages; ++group)
+    {
+        if(sameSize && !isGroupMarked(changedPages, group))
+        {
+            (*newTable)[group] = (*table)[group];
+            continue;
+        }
+
+        auto newGroup = std::make_shared<Group>();
+
+        for(int pageInGroup = 0; pageInGroup < pagesPerGroup; ++pageInGroup)
+        {
+            const int page = group * pagesPerGroup + pageInGroup;
+
+            if(sameSize && !isPageMarked(changedPages, page))
+            {
+                (*newGroup)[pageInGroup] = (*(*table)[group])[pageInGroup];
+                continue;
+            }
+
+            auto newPage = std::make_shared<Page>();
+            std::memcpy(newPage->data(), memory.data() + page * pageSize, pageSize);
+            (*newGroup)[pageInGroup] = std::move(newPage);
+        }
+
+        (*newTable)[group] = std::move(newGroup);
+    }
+
+    Chip8PagedMemory image;
+    image.table = std::move(newTable);
+    image.size = memory.size();
+    return image;
+}
+
+void Chip8PagedMemory::copyTo(std::vector<uint8_t>& memory, const Chip8PagedMemory& current, const PageMask& changedPages) const
+{
+    if(table == nullptr)
+    {
+        return;
+    }
+
+    const bool sameSize = current.table != nullptr && current.size == size && memory.size() == size;
+
+    if(memory.size() != size)
+    {
+        memory.resize(size);
+    }
+
+    if(sameSize && current.table == table)
+    {
+        //Only what was written since
+        for(int page = 0; page < int(size / pageSize); ++page)
+        {
+            if(isPageMarked(changedPages, page))
+            {
+                std::memcpy(memory.data() + page * pageSize, (*(*table)[page / pagesPerGroup])[page % pagesPerGroup]->data(), pageSize);
+            }
+        }
+
+        return;
+    }
+
+    for(int group = 0; group * pagesPerGroup < int(size / pageSize); ++group)
+    {
+        const Group& sourceGroup = *(*table)[group];
+        const bool sharedGroup = sameSize && (*current.table)[group] == (*table)[group];
+
+        if(sharedGroup && !isGroupMarked(changedPages, group))
+        {
+            continue;
+        }
+
+        for(int pageInGroup = 0; pageInGroup < pagesPerGroup; ++pageInGroup)
+        {
+            const int page = group * pagesPerGroup + pageInGroup;
+            const bool sharedPage = sameSize && (*(*current.table)[group])[pageInGroup] == sourceGroup[pageInGroup];
+
+            if(!sharedPage || isPageMarked(changedPages, page))
+            {
+                std::memcpy(memory.data() + page * pageSize, sourceGroup[pageInGroup]->data(), pageSize);
+            }
+        }
+    }
+}
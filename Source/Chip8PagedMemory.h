@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    Chip8PagedMemory.h
+    Created: 1 Aug 2022 9:12:05am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//An immutable image of a core's memory in 256 byte pages. Images made from one another share every
+//page that didn't change in between, so keeping many of them costs about what was written, and
+//copying one is a single reference count. Safe to share between threads once made
+class Chip8PagedMemory
+{
+public:
+    static constexpr int pageSize = 256;
+    static constexpr int pagesPerGroup = 16;
+
+    //Enough for XO-CHIP's 64KB
+    static constexpr int maxPages = 256;
+    static constexpr int maxGroups = maxPages / pagesPerGroup;
+
+    //Bit n is set for page n, the bytes from n * pageSize
+    using PageMask = std::array<uint64_t, maxPages / 64>;
+
+    Chip8PagedMemory() {};
+
+    //A new image of memory, which held this image plus the changes in changedPages. Only those pages are copied
+    Chip8PagedMemory withChanges(const std::vector<uint8_t>& memory, const PageMask& changedPages) const;
+
+    //Brings memory, which holds current plus the changes in changedPages, into line with this image.
+    //Only pages that this and current don't share, or that changed, are copied
+    void copyTo(std::vector<uint8_t>& memory, const Chip8PagedMemory& current, const PageMask& changedPages) const;
+
+    size_t getSize() const {return size;}
+
+    static void markPage(PageMask& mask, uint32_t address) {mask[address / pageSize / 64] |= uint64_t(1) << (address / pageSize % 64);}
+    static PageMask allPages() {PageMask mask; mask.fill(~uint64_t(0)); return mask;}
+
+private:
+    using Page = std::array<uint8_t, pageSize>;
+    using Group = std::array<std::shared_ptr<const Page>, pagesPerGroup>;
+    using Table = std::array<std::shared_ptr<const Group>, maxGroups>;
+
+    static bool isPageMarked(const PageMask& mask, int page) {return (mask[page / 64] >> (page % 64)) & 1;}
+    static bool isGroupMarked(const PageMask& mask, int group) {return ((mask[group * pagesPerGroup / 64] >> (group * pagesPerGroup % 64)) & 0xFFFF) != 0;}
+
+    std::shared_ptr<const Table> table;
+    size_t size = 0;
+};
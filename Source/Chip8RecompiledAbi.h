@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    Chip8RecompiledAbi.h
+    Created: 30 Jul 2022 10:41:26am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Interface between Chip8Core and a program compiled ahead of time by Tools/Recompile.
+    The generated translation unit includes this header and exports, with C linkage:
+
+        uint32_t chip8RecompiledAbiVersion      must equal chip8RecompiledCurrentAbiVersion
+        uint64_t chip8RecompiledRomHash         chip8RecompiledHash() of the program bytes
+        uint32_t chip8RecompiledProfile         Chip8Profile it was compiled for
+        uint32_t chip8RecompiledMemorySize      bytes of machine memory, 4096 or 64KB
+        uint8_t chip8RecompiledCodeMap[]        one bit per address, set for every compiled byte
+        int chip8RecompiledRun(Chip8RecompiledState*, int maxCycles)
+
+    chip8RecompiledRun() carries on from the PC for at most maxCycles instructions, working on
+    the core's state in place, and returns how many it ran. It returns early with the PC on any
+    instruction it has no code for, which the core then interprets before calling it again.
+*/
+
+static constexpr uint32_t chip8RecompiledCurrentAbiVersion = 1;
+
+struct Chip8RecompiledState
+{
+    uint8_t* memory;
+    uint32_t addressMask;
+
+    uint8_t* registers;
+    uint16_t* indexRegister;
+    uint16_t* programCounter;
+    uint16_t* stack;
+    uint16_t* stackPointer;
+
+    uint8_t* delayTimer;
+    uint8_t* soundTimer;
+    const uint16_t* keyState;
+
+    //Chip8Core's idle loop bookkeeping, bumped wherever the interpreter bumps it
+    uint32_t* sideEffectCount;
+
+    //Called for every backward jump with the PC still on the jump. Returns true if the core has
+    //decided the program is idling, in which case the run ends after the jump
+    bool (*checkForIdleLoop)(void* core, uint16_t target);
+    void* core;
+
+    //Set by the compiled code when one of its own stores lands on compiled code
+    bool codeModified;
+};
+
+using Chip8RecompiledRunFunction = int (*)(Chip8RecompiledState*, int);
+
+//FNV-1a, the same hash RomArchive keys ROMs by
+inline uint64_t chip8RecompiledHash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
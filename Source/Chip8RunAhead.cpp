@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    Chip8RunAhead.cpp
+    Created: 2 Aug 2022 7:48:31pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "Chip8RunAhead.h"
+#include <algorithm>
+
+void Chip8RunAhead::setFramesAhead(int numFrames)
+{
+    framesAhead = std::max(numFrames, 0);
+
+    //Nothing shown yet counts as changed
+    dirtyRows = ~uint64_t(0);
+}
+
+void Chip8RunAhead::update(Chip8Core& core)
+{
+    //Only the memory pages that changed since the last update get copied across
+    aheadCore.setCyclesPerFrame(core.getCyclesPerFrame());
+    aheadCore.restore(core.fork());
+
+    for(int frame = 0; frame < framesAhead; ++frame)
+    {
+        aheadCore.runFrame();
+    }
+
+    //restore() marks every row dirty, so find the ones that really changed
+    const Chip8Core::Framebuffer& framebuffer = aheadCore.getFramebuffer();
+
+    if(aheadCore.getDisplayWidth() != shownWidth || aheadCore.getDisplayHeight() != shownHeight)
+    {
+        dirtyRows = ~uint64_t(0);
+        shownWidth = aheadCore.getDisplayWidth();
+        shownHeight = aheadCore.getDisplayHeight();
+    }
+
+    for(int row = 0; row < shownHeight; ++row)
+    {
+        if(framebuffer[row] != shownFramebuffer[row])
+        {
+            dirtyRows |= uint64_t(1) << row;
+            shownFramebuffer[row] = framebuffer[row];
+        }
+    }
+
+    aheadCore.takeDirtyRows();
+}
+
+uint64_t Chip8RunAhead::takeDirtyRows()
+{
+    const uint64_t rows = dirtyRows;
+    dirtyRows = 0;
+    return rows;
+}
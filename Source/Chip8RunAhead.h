@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    Chip8RunAhead.h
+    Created: 2 Aug 2022 7:48:31pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Core.h"
+
+//Shows the machine a few frames into the future, run on from its current state with the keys
+//held now, so a key press reaches the screen that many frames sooner. The future is worked out
+//on a second core from a fork, the real one only ever moves on a frame at a time
+class Chip8RunAhead
+{
+public:
+    Chip8RunAhead() {};
+
+    //0 turns it off
+    void setFramesAhead(int numFrames);
+    int getFramesAhead() const {return framesAhead;}
+
+    //Call after each of core's own frames, with the keys for the next one already set
+    void update(Chip8Core& core);
+
+    //The core as it will be framesAhead frames from now, if the keys stay as they are
+    const Chip8Core& getCore() const {return aheadCore;}
+
+    //Rows that differ from the frame shown by the last update()
+    uint64_t takeDirtyRows();
+
+private:
+    Chip8Core aheadCore;
+    int framesAhead = 0;
+
+    //What the last update() showed, so the next can tell which rows changed
+    Chip8Core::Framebuffer shownFramebuffer {};
+    int shownWidth = 0;
+    int shownHeight = 0;
+    uint64_t dirtyRows = ~uint64_t(0);
+};
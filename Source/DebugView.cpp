@@ -0,0 +1,256 @@
+/*
+  ==============================================================================
+
+    DebugView.cpp
+    Created: 23 Jul 2022 4:02:15pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "DebugView.h"
+#include "Chip8Disassembler.h"
+#include <cstring>
+
+DebugView::DebugView(Chip8Emulator& emulatorToInspect) : emulator(emulatorToInspect)
+{
+    for(auto* list : {&disassemblyList, &memoryList})
+    {
+        list->setRowHeight(rowHeight);
+        list->setColour(juce::ListBox::backgroundColourId, juce::Colours::black);
+        addAndMakeVisible(*list);
+    }
+}
+
+DebugView::~DebugView()
+{
+
+}
+
+void DebugView::update(const Chip8Core& core)
+{
+    const uint16_t oldProgramCounter = programCounter;
+
+    registers = core.getRegisters();
+    stack = core.getStack();
+    stackPointer = core.getStackPointer();
+    programCounter = core.getProgramCounter();
+    indexRegister = core.getIndexRegister();
+    delayTimer = core.getDelayTimer();
+    soundTimer = core.getSoundTimer();
+
+    repaint(getRegisterArea());
+
+    //A new profile or memory size means a new program, start again
+    if(core.getLoadedProfile() != profile || core.getMemory().size() != memory.size())
+    {
+        profile = core.getLoadedProfile();
+        memory = core.getMemory();
+        disassemblyCache.assign(memory.size(), CachedInstruction());
+
+        disassemblyList.updateContent();
+        memoryList.updateContent();
+        disassemblyList.repaint();
+        memoryList.repaint();
+    }
+    else if(updateMemory(core.getMemory()) || (oldProgramCounter & 1) != (programCounter & 1))
+    {
+        disassemblyList.repaint();
+    }
+
+    disassemblyList.repaintRow(getDisassemblyRow(oldProgramCounter));
+    disassemblyList.repaintRow(getDisassemblyRow(programCounter));
+    disassemblyList.scrollToEnsureRowIsOnscreen(getDisassemblyRow(programCounter));
+}
+
+bool DebugView::updateMemory(const std::vector<uint8_t>& newMemory)
+{
+    //Past this many rows it is cheaper to repaint both lists whole
+    constexpr int maxRowsToRepaint = 32;
+
+    std::vector<int> changedRows;
+    int numChangedRows = 0;
+
+    for(size_t rowStart = 0; rowStart < memory.size(); rowStart += bytesPerMemoryRow)
+    {
+        if(std::memcmp(memory.data() + rowStart, newMemory.data() + rowStart, bytesPerMemoryRow) == 0)
+        {
+            continue;
+        }
+
+        for(size_t address = rowStart; address < rowStart + bytesPerMemoryRow; ++address)
+        {
+            if(memory[address] == newMemory[address])
+            {
+                continue;
+            }
+
+            memory[address] = newMemory[address];
+
+            //An instruction reads up to four bytes, F000 takes its address from the next word
+            for(size_t offset = 0; offset < 4 && offset <= address; ++offset)
+            {
+                disassemblyCache[address - offset].valid = false;
+            }
+        }
+
+        if(++numChangedRows <= maxRowsToRepaint)
+        {
+            changedRows.push_back(int(rowStart / bytesPerMemoryRow));
+        }
+    }
+
+    if(numChangedRows > maxRowsToRepaint)
+    {
+        memoryList.repaint();
+        return true;
+    }
+
+    for(const int row : changedRows)
+    {
+        memoryList.repaintRow(row);
+
+        //Covers the instructions decoded from this row's bytes, the row before can read into it too
+        const uint16_t firstAddress = uint16_t(std::max(row * bytesPerMemoryRow - 3, 0));
+
+        for(int disassemblyRow = getDisassemblyRow(firstAddress); disassemblyRow <= getDisassemblyRow(uint16_t(row * bytesPerMemoryRow + bytesPerMemoryRow - 1)); ++disassemblyRow)
+        {
+            disassemblyList.repaintRow(disassemblyRow);
+        }
+    }
+
+    return false;
+}
+
+const juce::String& DebugView::getDisassembly(uint16_t address)
+{
+    CachedInstruction& cached = disassemblyCache[address];
+
+    if(!cached.valid)
+    {
+        const size_t mask = memory.size() - 1;
+        const uint16_t opcode = uint16_t((memory[address] << 8) | memory[(address + 1) & mask]);
+        const uint16_t nextWord = uint16_t((memory[(address + 2) & mask] << 8) | memory[(address + 3) & mask]);
+
+        cached.text = Chip8Disassembler::disassemble(opcode, nextWord, profile);
+        cached.valid = true;
+    }
+
+    return cached.text;
+}
+
+void DebugView::resized()
+{
+    auto bounds = getLocalBounds();
+    bounds.removeFromTop(registerAreaHeight);
+
+    disassemblyList.setBounds(bounds.removeFromTop(bounds.getHeight() / 2).reduced(4));
+    memoryList.setBounds(bounds.reduced(4));
+}
+
+void DebugView::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colours::darkgrey.darker());
+
+    g.setColour(juce::Colours::white);
+    g.setFont(font);
+
+    auto area = getRegisterArea().reduced(8, 4);
+
+    auto drawLine = [&g, &area](const juce::String& line)
+    {
+        g.drawText(line, area.removeFromTop(rowHeight), juce::Justification::centredLeft);
+    };
+
+    auto hex = [](int value, int digits)
+    {
+        return juce::String::toHexString(value).toUpperCase().paddedLeft('0', digits);
+    };
+
+    drawLine("PC " + hex(programCounter, 4) + "  I " + hex(indexRegister, 4) + "  DT " + hex(delayTimer, 2) + "  ST " + hex(soundTimer, 2));
+
+    for(int firstRegister = 0; firstRegister < 16; firstRegister += 8)
+    {
+        juce::String line;
+
+        for(int registerIndex = firstRegister; registerIndex < firstRegister + 8; ++registerIndex)
+        {
+            line << "V" << hex(registerIndex, 1) << " " << hex(registers[registerIndex], 2) << " ";
+        }
+
+        drawLine(line);
+    }
+
+    juce::String stackLine = "SP " + hex(stackPointer, 1) + " ";
+
+    for(int level = 0; level < (stackPointer & 0xF); ++level)
+    {
+        stackLine << " " << hex(stack[level], 4);
+    }
+
+    drawLine(stackLine);
+}
+
+int DebugView::DisassemblyModel::getNumRows()
+{
+    return int(view.memory.size() / 2);
+}
+
+void DebugView::DisassemblyModel::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+{
+    const uint16_t address = view.getDisassemblyRowAddress(rowNumber);
+
+    if(address >= view.memory.size())
+    {
+        return;
+    }
+
+    if(address == view.programCounter)
+    {
+        g.fillAll(juce::Colours::darkblue);
+    }
+
+    if(view.emulator.hasBreakpoint(address))
+    {
+        g.setColour(juce::Colours::red);
+        g.fillEllipse(4.0f, height / 2.0f - 4.0f, 8.0f, 8.0f);
+    }
+
+    g.setColour(juce::Colours::white);
+    g.setFont(view.font);
+    g.drawText(juce::String::toHexString(int(address)).toUpperCase().paddedLeft('0', 4) + "  " + view.getDisassembly(address), 18, 0, width - 18, height, juce::Justification::centredLeft);
+}
+
+void DebugView::DisassemblyModel::listBoxItemDoubleClicked(int row, const juce::MouseEvent& event)
+{
+    const uint16_t address = view.getDisassemblyRowAddress(row);
+
+    view.emulator.setBreakpoint(address, !view.emulator.hasBreakpoint(address));
+    view.disassemblyList.repaintRow(row);
+}
+
+int DebugView::MemoryModel::getNumRows()
+{
+    return int(view.memory.size() / bytesPerMemoryRow);
+}
+
+void DebugView::MemoryModel::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+{
+    const size_t rowStart = size_t(rowNumber) * bytesPerMemoryRow;
+
+    if(rowStart + bytesPerMemoryRow > view.memory.size())
+    {
+        return;
+    }
+
+    juce::String line = juce::String::toHexString(int(rowStart)).toUpperCase().paddedLeft('0', 4) + " ";
+
+    for(size_t address = rowStart; address < rowStart + bytesPerMemoryRow; ++address)
+    {
+        line << " " << juce::String::toHexString(int(view.memory[address])).toUpperCase().paddedLeft('0', 2);
+    }
+
+    g.setColour(juce::Colours::white);
+    g.setFont(view.font);
+    g.drawText(line, 4, 0, width - 4, height, juce::Justification::centredLeft);
+}
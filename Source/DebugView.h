@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    DebugView.h
+    Created: 23 Jul 2022 4:02:15pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Chip8Emulator.h"
+
+//Disassembly around the PC, a hex dump of memory and the registers and stack. Both lists are
+//virtualised, only visible rows are ever drawn, and work from a snapshot that update() refreshes
+class DebugView  : public juce::Component
+{
+public:
+    DebugView(Chip8Emulator& emulatorToInspect);
+    ~DebugView();
+
+    //Message thread, at most once per display frame. Only rows whose bytes changed are disassembled and repainted again
+    void update(const Chip8Core& core);
+
+    void resized() override;
+    void paint(juce::Graphics& g) override;
+
+private:
+    class DisassemblyModel  : public juce::ListBoxModel
+    {
+    public:
+        DisassemblyModel(DebugView& owner) : view(owner) {};
+
+        int getNumRows() override;
+        void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
+
+        //Toggles a breakpoint on the row's address
+        void listBoxItemDoubleClicked(int row, const juce::MouseEvent& event) override;
+
+    private:
+        DebugView& view;
+    };
+
+    class MemoryModel  : public juce::ListBoxModel
+    {
+    public:
+        MemoryModel(DebugView& owner) : view(owner) {};
+
+        int getNumRows() override;
+        void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
+
+    private:
+        DebugView& view;
+    };
+
+    //Instructions are listed on the PC's alignment, so an odd PC shifts every row by a byte
+    uint16_t getDisassemblyRowAddress(int row) const {return uint16_t(row * 2 + (programCounter & 1));}
+    int getDisassemblyRow(uint16_t address) const {return address / 2;}
+
+    const juce::String& getDisassembly(uint16_t address);
+
+    //Takes the changed bytes from newMemory, repainting their rows. Returns true if so much changed
+    //that the lists need repainting whole instead
+    bool updateMemory(const std::vector<uint8_t>& newMemory);
+
+    juce::Rectangle<int> getRegisterArea() const {return getLocalBounds().removeFromTop(registerAreaHeight);}
+
+    Chip8Emulator& emulator;
+
+    DisassemblyModel disassemblyModel {*this};
+    MemoryModel memoryModel {*this};
+    juce::ListBox disassemblyList {"Disassembly", &disassemblyModel};
+    juce::ListBox memoryList {"Memory", &memoryModel};
+
+    const juce::Font font {juce::Font::getDefaultMonospacedFontName(), 13.0f, juce::Font::plain};
+    static constexpr int rowHeight = 16;
+    static constexpr int bytesPerMemoryRow = 16;
+    static constexpr int registerAreaHeight = 6 * rowHeight + 8;
+
+    //Snapshot of the core
+    std::vector<uint8_t> memory;
+    std::array<uint8_t, 16> registers {};
+    std::array<uint16_t, 16> stack {};
+    uint16_t stackPointer = 0;
+    uint16_t programCounter = Chip8Core::programStart;
+    uint16_t indexRegister = 0;
+    uint8_t delayTimer = 0;
+    uint8_t soundTimer = 0;
+    Chip8Profile profile = Chip8Profile::chip8;
+
+    struct CachedInstruction
+    {
+        juce::String text;
+        bool valid = false;
+    };
+
+    //One per address, cleared when any of the bytes it was decoded from are written
+    std::vector<CachedInstruction> disassemblyCache;
+};
@@ -15,8 +15,16 @@ EmulatorController::EmulatorController()
     addAndMakeVisible(emulator);
     
     initRefreshRateSlider();
+    initRunAheadSlider();
     initStartButton();
     initLoadButton();
+    initProfileSelector();
+    initPhosphorToggle();
+    initTraceToggle();
+    initRecordToggle();
+    initHudToggle();
+    initDebugControls();
+    initDebugViewToggle();
     
     devManager.initialiseWithDefaultDevices(0, 1);
     devManager.addAudioCallback(&emulator);
@@ -31,12 +39,30 @@ EmulatorController::~EmulatorController()
 
 void EmulatorController::resized()
 {
-    loadButton.setBounds(10, 10, 150, 30);
+    loadButton.setBounds(10, 10, 100, 30);
+    profileSelector.setBounds(120, 10, 110, 30);
     startStopButton.setBounds(getWidth() - 160, 10, 150, 30);
+    phosphorToggle.setBounds(240, 10, 115, 30);
+    traceToggle.setBounds(365, 10, 115, 30);
+    recordToggle.setBounds(490, 10, 115, 30);
+    hudToggle.setBounds(615, 10, 115, 30);
+    debugViewToggle.setBounds(740, 10, 115, 30);
     
-    emulator.setBounds(0, 50, getWidth(), getHeight() - 100);
+    auto displayArea = juce::Rectangle<int>(0, 50, getWidth(), getHeight() - 100);
     
-    refreshRateSlider.setBounds(100, getHeight() - 40, getWidth() - 100, 30);
+    if(debugView.isVisible())
+    {
+        debugView.setBounds(displayArea.removeFromRight(debugViewWidth));
+    }
+    
+    emulator.setBounds(displayArea);
+    
+    refreshRateSlider.setBounds(100, getHeight() - 40, getWidth() - 680, 30);
+    runAheadSlider.setBounds(getWidth() - 490, getHeight() - 40, 100, 30);
+    
+    breakpointEditor.setBounds(getWidth() - 380, getHeight() - 40, 110, 30);
+    stepButton.setBounds(getWidth() - 260, getHeight() - 40, 120, 30);
+    continueButton.setBounds(getWidth() - 130, getHeight() - 40, 120, 30);
 }
 
 void EmulatorController::paint(juce::Graphics& g)
@@ -44,6 +70,15 @@ void EmulatorController::paint(juce::Graphics& g)
     g.setColour(juce::Colours::white);
     g.setFont(juce::Font(16));
     g.drawText("Refresh Rate", 0, getHeight() - 40, 100, 30, juce::Justification::centredRight);
+    g.drawText("Run Ahead", getWidth() - 580, getHeight() - 40, 85, 30, juce::Justification::centredRight);
+}
+
+bool EmulatorController::keyStateChanged(bool isKeyDown)
+{
+    //The emulator has focus, its unhandled key changes bubble up to here
+    emulator.setTurbo(juce::KeyPress::isKeyCurrentlyDown(juce::KeyPress::spaceKey));
+    
+    return false;
 }
 
 void EmulatorController::initRefreshRateSlider()
@@ -63,6 +98,19 @@ void EmulatorController::initRefreshRateSlider()
     addAndMakeVisible(refreshRateSlider);
 }
 
+void EmulatorController::initRunAheadSlider()
+{
+    //Frames, a couple is usually enough to hide a ROM's own input lag
+    runAheadSlider.setSliderStyle(juce::Slider::IncDecButtons);
+    runAheadSlider.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 40, 30);
+    runAheadSlider.setRange(0.0, 4.0, 1.0);
+    runAheadSlider.onValueChange = [this]()
+    {
+        emulator.setRunAheadFrames(int(runAheadSlider.getValue()));
+    };
+    addAndMakeVisible(runAheadSlider);
+}
+
 void EmulatorController::initStartButton()
 {
     startStopButton.setButtonText("Play");
@@ -89,16 +137,195 @@ void EmulatorController::initLoadButton()
         
         if(loader.browseForFileToOpen())
         {
-            juce::File fileToOpen = loader.getResult();
-            
-            std::ifstream fileStream(fileToOpen.getFullPathName().toStdString());
-            
-            if(fileStream.is_open())
-            {
-                emulator.load(fileStream);
-            }
+            loadFile(loader.getResult());
         }
     };
     
     addAndMakeVisible(loadButton);
 }
+
+void EmulatorController::initProfileSelector()
+{
+    //Ids are the Chip8Profile values plus one, 0 means nothing selected
+    profileSelector.addItem("CHIP-8", int(Chip8Profile::chip8) + 1);
+    profileSelector.addItem("SUPER-CHIP", int(Chip8Profile::superChip) + 1);
+    profileSelector.addItem("XO-CHIP", int(Chip8Profile::xoChip) + 1);
+    
+    profileSelector.onChange = [this]()
+    {
+        emulator.setProfile(Chip8Profile(profileSelector.getSelectedId() - 1));
+        
+        if(loadedFile.existsAsFile())
+        {
+            loadFile(loadedFile);
+        }
+    };
+    
+    profileSelector.setSelectedId(int(emulator.getProfile()) + 1, juce::dontSendNotification);
+    addAndMakeVisible(profileSelector);
+}
+
+void EmulatorController::loadFile(const juce::File& fileToOpen)
+{
+    std::ifstream fileStream(fileToOpen.getFullPathName().toStdString());
+    
+    if(!fileStream.is_open())
+    {
+        return;
+    }
+    
+    //Tools/Recompile output built next to the ROM gets picked up automatically
+    const juce::File recompiledLibrary = fileToOpen.withFileExtension(JUCE_MAC ? ".dylib" : ".so");
+    
+    if(recompiledLibrary.existsAsFile())
+    {
+        emulator.loadRecompiledProgram(recompiledLibrary);
+    }
+    else
+    {
+        emulator.unloadRecompiledProgram();
+    }
+    
+    emulator.load(fileStream);
+    loadedFile = fileToOpen;
+}
+
+
+void EmulatorController::initPhosphorToggle()
+{
+    phosphorToggle.setButtonText("Phosphor");
+    
+    phosphorToggle.onClick = [this]()
+    {
+        emulator.setPhosphorEnabled(phosphorToggle.getToggleState());
+    };
+    
+    addAndMakeVisible(phosphorToggle);
+}
+
+void EmulatorController::initTraceToggle()
+{
+    traceToggle.setButtonText("Trace");
+    
+    traceToggle.onClick = [this]()
+    {
+        if(!traceToggle.getToggleState())
+        {
+            emulator.stopTrace();
+            return;
+        }
+        
+        juce::FileChooser saver("Save Trace", juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("trace.c8tr"));
+        
+        if(!saver.browseForFileToSave(true) || !emulator.startTrace(saver.getResult()))
+        {
+            traceToggle.setToggleState(false, juce::dontSendNotification);
+        }
+    };
+    
+    addAndMakeVisible(traceToggle);
+}
+
+void EmulatorController::initRecordToggle()
+{
+    recordToggle.setButtonText("Record");
+    
+    recordToggle.onClick = [this]()
+    {
+        if(!recordToggle.getToggleState())
+        {
+            emulator.stopCapture();
+            return;
+        }
+        
+        //The audio goes next to it as a .wav
+        juce::FileChooser saver("Save Recording", juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("recording.y4m"), "*.y4m");
+        
+        if(!saver.browseForFileToSave(true) || !emulator.startCapture(saver.getResult(), recordScale))
+        {
+            recordToggle.setToggleState(false, juce::dontSendNotification);
+        }
+    };
+    
+    addAndMakeVisible(recordToggle);
+}
+
+void EmulatorController::initHudToggle()
+{
+    hudToggle.setButtonText("Performance");
+    
+    hudToggle.onClick = [this]()
+    {
+        emulator.setHudVisible(hudToggle.getToggleState());
+    };
+    
+    addAndMakeVisible(hudToggle);
+}
+
+void EmulatorController::initDebugControls()
+{
+    breakpointEditor.setTextToShowWhenEmpty("Breakpoint", juce::Colours::grey);
+    breakpointEditor.setInputRestrictions(4, "0123456789abcdefABCDEF");
+    
+    breakpointEditor.onReturnKey = [this]()
+    {
+        if(breakpointEditor.isEmpty())
+        {
+            return;
+        }
+        
+        const uint16_t address = uint16_t(breakpointEditor.getText().getHexValue32());
+        emulator.setBreakpoint(address, !emulator.hasBreakpoint(address));
+        
+        breakpointEditor.clear();
+        emulator.grabKeyboardFocus();
+    };
+    
+    addAndMakeVisible(breakpointEditor);
+    
+    stepButton.setButtonText("Step");
+    
+    stepButton.onClick = [this]()
+    {
+        emulator.debugStep();
+    };
+    
+    addAndMakeVisible(stepButton);
+    
+    continueButton.setButtonText("Break");
+    
+    continueButton.onClick = [this]()
+    {
+        emulator.getIsDebugPaused() ? emulator.debugResume() : emulator.debugPause();
+    };
+    
+    addAndMakeVisible(continueButton);
+    
+    emulator.onDebugStateChanged = [this]()
+    {
+        continueButton.setButtonText(emulator.getIsDebugPaused() ? "Continue" : "Break");
+    };
+}
+
+void EmulatorController::initDebugViewToggle()
+{
+    debugViewToggle.setButtonText("Debugger");
+    
+    debugViewToggle.onClick = [this]()
+    {
+        const bool show = debugViewToggle.getToggleState();
+        
+        //Only snapshot the core while someone is looking
+        emulator.onCoreUpdated = show ? std::function<void(const Chip8Core&)>([this](const Chip8Core& core)
+        {
+            debugView.update(core);
+        }) : nullptr;
+        
+        debugView.setVisible(show);
+        emulator.notifyCoreUpdated();
+        resized();
+    };
+    
+    addChildComponent(debugView);
+    addAndMakeVisible(debugViewToggle);
+}
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "Chip8Emulator.h"
+#include "DebugView.h"
 #include <fstream>
 
 class EmulatorController  : public juce::Component
@@ -22,15 +23,50 @@ public:
     void resized() override;
     void paint(juce::Graphics& g) override;
     
+    //Fast-forwards while space is held
+    bool keyStateChanged(bool isKeyDown) override;
+    
 private:
     void initRefreshRateSlider();
+    void initRunAheadSlider();
     void initStartButton();
     void initLoadButton();
+    void initProfileSelector();
+    void initPhosphorToggle();
+    void initTraceToggle();
+    void initRecordToggle();
+    void initHudToggle();
+    void initDebugControls();
+    void initDebugViewToggle();
+    
+    //Loads the ROM and any recompiled library built next to it
+    void loadFile(const juce::File& fileToOpen);
     
     juce::TextButton loadButton;
+    juce::ComboBox profileSelector;
     juce::TextButton startStopButton;
+    juce::ToggleButton phosphorToggle;
+    juce::ToggleButton traceToggle;
+    juce::ToggleButton recordToggle;
+    juce::ToggleButton hudToggle;
+    juce::ToggleButton debugViewToggle;
+    
+    //Enter toggles a breakpoint at the hex address typed in
+    juce::TextEditor breakpointEditor;
+    juce::TextButton stepButton;
+    juce::TextButton continueButton;
     Chip8Emulator emulator;
+    DebugView debugView {emulator};
     juce::Slider refreshRateSlider;
+    juce::Slider runAheadSlider;
     
     juce::AudioDeviceManager devManager;
+    
+    //Reloaded when the profile changes, since that only takes effect on load
+    juce::File loadedFile;
+    
+    static constexpr int debugViewWidth = 400;
+    
+    //512x256 video, big enough to watch without the file size getting silly
+    static constexpr int recordScale = 4;
 };
@@ -0,0 +1,222 @@
+/*
+  ==============================================================================
+
+    FramebufferRenderer.cpp
+    Created: 14 May 2022 4:36:22pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "FramebufferRenderer.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+ #include <emmintrin.h>
+ #define CHIP8_RENDERER_SSE2 1
+#elif defined(__ARM_NEON)
+ #include <arm_neon.h>
+ #define CHIP8_RENDERER_NEON 1
+#endif
+
+namespace
+{
+    //Turns a word of the framebuffer into 64 pixels, leftmost pixel first
+    void expandRow(uint64_t rowBits, uint32_t* destPixels, uint32_t onColour, uint32_t offColour)
+    {
+       #if CHIP8_RENDERER_SSE2
+        const __m128i bitSelect = _mm_set_epi32(1, 2, 4, 8);
+        const __m128i on = _mm_set1_epi32(int(onColour));
+        const __m128i off = _mm_set1_epi32(int(offColour));
+        
+        //Four pixels per step, taken a nibble at a time from the top of the row
+        for(int nibble = 0; nibble < 16; ++nibble)
+        {
+            const int bits = int(rowBits >> (60 - nibble * 4)) & 0xF;
+            const __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(bits), bitSelect), bitSelect);
+            const __m128i pixels = _mm_or_si128(_mm_and_si128(mask, on), _mm_andnot_si128(mask, off));
+            
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destPixels + nibble * 4), pixels);
+        }
+       #elif CHIP8_RENDERER_NEON
+        const uint32_t bitSelectValues[4] = {8, 4, 2, 1};
+        const uint32x4_t bitSelect = vld1q_u32(bitSelectValues);
+        const uint32x4_t on = vdupq_n_u32(onColour);
+        const uint32x4_t off = vdupq_n_u32(offColour);
+        
+        for(int nibble = 0; nibble < 16; ++nibble)
+        {
+            const uint32_t bits = uint32_t(rowBits >> (60 - nibble * 4)) & 0xF;
+            const uint32x4_t mask = vtstq_u32(vdupq_n_u32(bits), bitSelect);
+            
+            vst1q_u32(destPixels + nibble * 4, vbslq_u32(mask, on, off));
+        }
+       #else
+        for(int x = 0; x < 64; ++x)
+        {
+            destPixels[x] = ((rowBits >> (63 - x)) & 0x1) ? onColour : offColour;
+        }
+       #endif
+    }
+}
+
+FramebufferRenderer::FramebufferRenderer()  : scaledFrame(juce::Image::ARGB, Chip8Core::loResWidthPixels, Chip8Core::loResHeightPixels, true)
+{
+    planeColours = {offColour,
+                    onColour,
+                    juce::Colours::darkgrey.getPixelARGB().getNativeARGB(),
+                    juce::Colours::lightgrey.getPixelARGB().getNativeARGB()};
+    
+    for(int intensity = 0; intensity < 256; ++intensity)
+    {
+        const auto colour = juce::Colours::black.interpolatedWith(juce::Colours::white, intensity / 255.0f);
+        intensityColours[intensity] = colour.getPixelARGB().getNativeARGB();
+    }
+}
+
+void FramebufferRenderer::setTargetSize(int width, int height)
+{
+    targetWidth = width;
+    targetHeight = height;
+    
+    resizeFrame(displayWidth, displayHeight);
+}
+
+void FramebufferRenderer::update(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels, uint64_t dirtyRows)
+{
+    lastFramebuffer = framebuffer;
+    showingIntensities = false;
+    
+    if(resizeFrame(widthPixels, heightPixels))
+    {
+        return;
+    }
+    
+    juce::Image::BitmapData pixels(scaledFrame, juce::Image::BitmapData::writeOnly);
+    
+    std::array<uint32_t, Chip8Core::maxWidthPixels> unscaledRow;
+    
+    for(int y = 0; y < displayHeight; ++y)
+    {
+        if((dirtyRows & (uint64_t(1) << y)) == 0)
+        {
+            continue;
+        }
+        
+        //At 1x the pixels can go straight into the image
+        auto* destPixels = scale == 1 ? reinterpret_cast<uint32_t*>(pixels.getLinePointer(y)) : unscaledRow.data();
+        
+        const auto& row = framebuffer[y];
+        const bool secondPlaneEmpty = row[Chip8Core::wordsPerPlane] == 0 && row[Chip8Core::wordsPerPlane + 1] == 0;
+        
+        if(secondPlaneEmpty)
+        {
+            for(int word = 0; word < displayWidth / 64; ++word)
+            {
+                expandRow(row[word], destPixels + word * 64, onColour, offColour);
+            }
+        }
+        else
+        {
+            //XO-CHIP, each pixel picks one of four colours from its two plane bits
+            for(int x = 0; x < displayWidth; ++x)
+            {
+                const int shift = 63 - x % 64;
+                const int firstPlane = int(row[x / 64] >> shift) & 0x1;
+                const int secondPlane = int(row[Chip8Core::wordsPerPlane + x / 64] >> shift) & 0x1;
+                
+                destPixels[x] = planeColours[firstPlane | (secondPlane << 1)];
+            }
+        }
+        
+        if(scale != 1)
+        {
+            writeScaledRow(pixels, y, unscaledRow.data());
+        }
+    }
+}
+
+void FramebufferRenderer::update(const std::array<uint8_t, PhosphorFilter::numPixels>& intensities, int widthPixels, int heightPixels, uint64_t dirtyRows)
+{
+    lastIntensities = intensities;
+    showingIntensities = true;
+    
+    if(resizeFrame(widthPixels, heightPixels))
+    {
+        return;
+    }
+    
+    juce::Image::BitmapData pixels(scaledFrame, juce::Image::BitmapData::writeOnly);
+    
+    std::array<uint32_t, Chip8Core::maxWidthPixels> unscaledRow;
+    
+    for(int y = 0; y < displayHeight; ++y)
+    {
+        if((dirtyRows & (uint64_t(1) << y)) == 0)
+        {
+            continue;
+        }
+        
+        const uint8_t* rowIntensities = intensities.data() + y * PhosphorFilter::rowStride;
+        
+        for(int x = 0; x < displayWidth; ++x)
+        {
+            unscaledRow[x] = intensityColours[rowIntensities[x]];
+        }
+        
+        writeScaledRow(pixels, y, unscaledRow.data());
+    }
+}
+
+bool FramebufferRenderer::resizeFrame(int widthPixels, int heightPixels)
+{
+    const int newScale = juce::jmax(1, juce::jmin(targetWidth / widthPixels, targetHeight / heightPixels));
+    
+    if(newScale == scale && widthPixels == displayWidth && heightPixels == displayHeight)
+    {
+        return false;
+    }
+    
+    scale = newScale;
+    displayWidth = widthPixels;
+    displayHeight = heightPixels;
+    scaledFrame = juce::Image(juce::Image::ARGB, displayWidth * scale, displayHeight * scale, false);
+    
+    //Everything needs drawing again at the new size
+    if(showingIntensities)
+    {
+        update(lastIntensities, displayWidth, displayHeight, ~uint64_t(0));
+    }
+    else
+    {
+        update(lastFramebuffer, displayWidth, displayHeight, ~uint64_t(0));
+    }
+    
+    return true;
+}
+
+void FramebufferRenderer::writeScaledRow(juce::Image::BitmapData& pixels, int y, const uint32_t* unscaledRow) const
+{
+    auto* firstLine = reinterpret_cast<uint32_t*>(pixels.getLinePointer(y * scale));
+    
+    for(int x = 0; x < displayWidth; ++x)
+    {
+        std::fill_n(firstLine + x * scale, scale, unscaledRow[x]);
+    }
+    
+    //The rest of the scaled row is identical
+    for(int line = 1; line < scale; ++line)
+    {
+        std::memcpy(pixels.getLinePointer(y * scale + line), firstLine, size_t(scaledFrame.getWidth()) * sizeof(uint32_t));
+    }
+}
+
+void FramebufferRenderer::draw(juce::Graphics& g, juce::Rectangle<int> bounds) const
+{
+    g.fillAll(juce::Colours::black);
+    
+    //If the display is scaled (e.g. retina) keep the pixels hard edged
+    g.setImageResamplingQuality(juce::Graphics::lowResamplingQuality);
+    
+    const auto frameBounds = scaledFrame.getBounds().withCentre(bounds.getCentre());
+    g.drawImageAt(scaledFrame, frameBounds.getX(), frameBounds.getY());
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    FramebufferRenderer.h
+    Created: 14 May 2022 4:36:22pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PhosphorFilter.h"
+
+//Keeps an image of the framebuffer already scaled to the component, so painting is a straight 1:1 blit
+class FramebufferRenderer
+{
+public:
+    FramebufferRenderer();
+    
+    //Picks the largest whole number scale that fits
+    void setTargetSize(int width, int height);
+    
+    //Only the rows set in dirtyRows are redrawn, unless the resolution has changed
+    void update(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels, uint64_t dirtyRows);
+    void update(const std::array<uint8_t, PhosphorFilter::numPixels>& intensities, int widthPixels, int heightPixels, uint64_t dirtyRows);
+    
+    void draw(juce::Graphics& g, juce::Rectangle<int> bounds) const;
+    
+    int getScale() const {return scale;}
+    
+private:
+    //Returns true if the frame was reallocated, in which case it has already been fully redrawn
+    bool resizeFrame(int widthPixels, int heightPixels);
+    
+    void writeScaledRow(juce::Image::BitmapData& pixels, int y, const uint32_t* unscaledRow) const;
+    
+    juce::Image scaledFrame;
+    int scale = 1;
+    
+    int displayWidth = Chip8Core::loResWidthPixels;
+    int displayHeight = Chip8Core::loResHeightPixels;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    
+    //Kept so the image can be rebuilt when the scale changes
+    Chip8Core::Framebuffer lastFramebuffer {};
+    std::array<uint8_t, PhosphorFilter::numPixels> lastIntensities {};
+    bool showingIntensities = false;
+    
+    const uint32_t onColour = juce::Colours::white.getPixelARGB().getNativeARGB();
+    const uint32_t offColour = juce::Colours::black.getPixelARGB().getNativeARGB();
+    
+    //Indexed by the plane bits of a pixel, plane 0 in bit 0
+    std::array<uint32_t, 4> planeColours;
+    
+    //Colour for each phosphor intensity
+    std::array<uint32_t, 256> intensityColours;
+};
@@ -0,0 +1,131 @@
+/*
+  ==============================================================================
+
+    PerformanceHud.cpp
+    Created: 9 Jul 2022 3:27:44pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "PerformanceHud.h"
+
+bool PerformanceHud::tick(uint64_t cycleCount)
+{
+    const int64_t now = juce::Time::getHighResolutionTicks();
+    const int64_t ticksPerSecond = juce::Time::getHighResolutionTicksPerSecond();
+
+    if(periodStart == 0)
+    {
+        periodStart = now;
+        lastTick = now;
+        periodStartCycles = cycleCount;
+        return false;
+    }
+
+    tickErrorTotal += std::abs((now - lastTick) - ticksPerSecond / 60);
+    lastTick = now;
+    ++numTicks;
+
+    if(now - periodStart >= ticksPerSecond)
+    {
+        //A load resets the count, the first second after it is just skipped
+        const uint64_t cyclesRun = cycleCount >= periodStartCycles ? cycleCount - periodStartCycles : 0;
+
+        const double seconds = juce::Time::highResolutionTicksToSeconds(now - periodStart);
+        stats.instructionsPerSecond = cyclesRun / seconds;
+
+        periodStartCycles = cycleCount;
+        aggregate(now);
+        return true;
+    }
+
+    return false;
+}
+
+void PerformanceHud::addAudioCallback(int64_t callbackTicks, int64_t budgetTicks)
+{
+    audioTicksTotal.fetch_add(callbackTicks, std::memory_order_relaxed);
+    audioBudgetTotal.fetch_add(budgetTicks, std::memory_order_relaxed);
+
+    if(budgetTicks <= 0)
+    {
+        return;
+    }
+
+    const int64_t loadPpm = callbackTicks * 1000000 / budgetTicks;
+    int64_t peak = audioPeakLoadPpm.load(std::memory_order_relaxed);
+
+    //A failed exchange reloads peak, so this stops as soon as another callback has beaten it
+    while(loadPpm > peak)
+    {
+        if(audioPeakLoadPpm.compare_exchange_weak(peak, loadPpm, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+}
+
+void PerformanceHud::aggregate(int64_t now)
+{
+    const double seconds = juce::Time::highResolutionTicksToSeconds(now - periodStart);
+
+    stats.ticksPerSecond = numTicks / seconds;
+    stats.tickJitterMs = numTicks > 0 ? juce::Time::highResolutionTicksToSeconds(tickErrorTotal) * 1000.0 / numTicks : 0.0;
+
+    stats.paintMs = numPaints > 0 ? juce::Time::highResolutionTicksToSeconds(paintTicksTotal) * 1000.0 / numPaints : 0.0;
+    stats.repaintsPerSecond = numRepaintRequests / seconds;
+
+    //Whatever the audio thread adds between these exchanges just lands in the next second
+    const int64_t audioTicks = audioTicksTotal.exchange(0, std::memory_order_relaxed);
+    const int64_t audioBudget = audioBudgetTotal.exchange(0, std::memory_order_relaxed);
+
+    stats.audioLoad = audioBudget > 0 ? double(audioTicks) / double(audioBudget) : 0.0;
+    stats.audioPeakLoad = audioPeakLoadPpm.exchange(0, std::memory_order_relaxed) / 1000000.0;
+
+    periodStart = now;
+    numTicks = 0;
+    tickErrorTotal = 0;
+    paintTicksTotal = 0;
+    numPaints = 0;
+    numRepaintRequests = 0;
+}
+
+void PerformanceHud::draw(juce::Graphics& g, juce::Rectangle<int> bounds) const
+{
+    const juce::StringArray lines {
+        "Instructions/s: " + juce::String(juce::roundToInt(stats.instructionsPerSecond)),
+        "Ticks/s: " + juce::String(stats.ticksPerSecond, 1) + " (jitter " + juce::String(stats.tickJitterMs, 2) + "ms)",
+        "Paint: " + juce::String(stats.paintMs, 2) + "ms",
+        "Repaints/s: " + juce::String(juce::roundToInt(stats.repaintsPerSecond)),
+        "Audio load: " + juce::String(stats.audioLoad * 100.0, 1) + "% (peak " + juce::String(stats.audioPeakLoad * 100.0, 1) + "%)"
+    };
+
+    const auto panel = getArea(bounds);
+
+    g.setColour(juce::Colours::black.withAlpha(0.6f));
+    g.fillRect(panel);
+
+    g.setColour(juce::Colours::lime);
+    g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 13.0f, juce::Font::plain));
+
+    for(int line = 0; line < lines.size(); ++line)
+    {
+        g.drawText(lines[line], panel.getX() + 4, panel.getY() + line * lineHeight, panel.getWidth() - 8, lineHeight, juce::Justification::centredLeft);
+    }
+}
+
+juce::Rectangle<int> PerformanceHud::getArea(juce::Rectangle<int> bounds) const
+{
+    return bounds.removeFromTop(numLines * lineHeight + 8).removeFromLeft(300).reduced(4);
+}
+
+void PerformanceHud::reset()
+{
+    periodStart = 0;
+    numTicks = 0;
+    tickErrorTotal = 0;
+    paintTicksTotal = 0;
+    numPaints = 0;
+    numRepaintRequests = 0;
+}
@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    PerformanceHud.h
+    Created: 9 Jul 2022 3:27:44pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//Measured rates for the emulator overlay. Counters are cheap to bump from the hot paths,
+//they are only turned into displayed numbers once a second
+class PerformanceHud
+{
+public:
+    PerformanceHud() {};
+
+    //Message thread, once per 60Hz tick with the core's total cycle count. Returns true when the numbers changed
+    bool tick(uint64_t cycleCount);
+
+    //Message thread
+    void addPaint(int64_t paintTicks) {paintTicksTotal += paintTicks; ++numPaints;}
+    void addRepaintRequest() {++numRepaintRequests;}
+
+    //Audio thread, budgetTicks is how long the buffer lasts when played
+    void addAudioCallback(int64_t callbackTicks, int64_t budgetTicks);
+
+    void draw(juce::Graphics& g, juce::Rectangle<int> bounds) const;
+    juce::Rectangle<int> getArea(juce::Rectangle<int> bounds) const;
+
+    //Forgets the partial second so far, for after pausing
+    void reset();
+
+private:
+    void aggregate(int64_t now);
+
+    struct Stats
+    {
+        double instructionsPerSecond = 0.0;
+        double ticksPerSecond = 0.0;
+
+        //Mean distance of each tick from where a steady 60Hz would have put it, in milliseconds
+        double tickJitterMs = 0.0;
+
+        double paintMs = 0.0;
+        double repaintsPerSecond = 0.0;
+
+        //Fraction of the buffer's duration spent in the callback, averaged and worst
+        double audioLoad = 0.0;
+        double audioPeakLoad = 0.0;
+    };
+
+    Stats stats;
+
+    static constexpr int numLines = 5;
+    static constexpr int lineHeight = 16;
+
+    int64_t periodStart = 0;
+    int64_t lastTick = 0;
+    uint64_t periodStartCycles = 0;
+
+    int numTicks = 0;
+    int64_t tickErrorTotal = 0;
+
+    int64_t paintTicksTotal = 0;
+    int numPaints = 0;
+    int numRepaintRequests = 0;
+
+    std::atomic<int64_t> audioTicksTotal {0};
+    std::atomic<int64_t> audioBudgetTotal {0};
+
+    //Worst callback load in parts per million, so it fits an atomic max
+    std::atomic<int64_t> audioPeakLoadPpm {0};
+};
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    PhosphorFilter.cpp
+    Created: 21 May 2022 2:18:51pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "PhosphorFilter.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+ #include <emmintrin.h>
+ #define CHIP8_PHOSPHOR_SSE2 1
+#endif
+
+namespace
+{
+    //Lit pixels go straight to full brightness, the rest decay. Returns true if anything in the row is still glowing
+    bool updateRow(const uint64_t* rowBits, int widthPixels, uint8_t* rowIntensities, int decay)
+    {
+       #if CHIP8_PHOSPHOR_SSE2
+        const __m128i bitSelect = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, char(128), 1, 2, 4, 8, 16, 32, 64, char(128));
+        const __m128i decayFactor = _mm_set1_epi16(short(decay));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i anyGlowing = zero;
+        
+        //Sixteen pixels per step
+        for(int block = 0; block < widthPixels / 16; ++block)
+        {
+            const uint64_t word = rowBits[block / 4];
+            const int shift = 48 - (block % 4) * 16;
+            const char firstByte = char(word >> (shift + 8));
+            const char secondByte = char(word >> shift);
+            
+            const __m128i bits = _mm_set_epi8(secondByte, secondByte, secondByte, secondByte, secondByte, secondByte, secondByte, secondByte,
+                                              firstByte, firstByte, firstByte, firstByte, firstByte, firstByte, firstByte, firstByte);
+            const __m128i litMask = _mm_cmpeq_epi8(_mm_and_si128(bits, bitSelect), bitSelect);
+            
+            auto* blockIntensities = reinterpret_cast<__m128i*>(rowIntensities + block * 16);
+            const __m128i current = _mm_load_si128(blockIntensities);
+            
+            //Multiply in 16 bit then divide by the denominator
+            const __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(current, zero), decayFactor), PhosphorFilter::decayShift);
+            const __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(current, zero), decayFactor), PhosphorFilter::decayShift);
+            const __m128i decayed = _mm_packus_epi16(low, high);
+            
+            const __m128i result = _mm_or_si128(litMask, decayed);
+            _mm_store_si128(blockIntensities, result);
+            
+            anyGlowing = _mm_or_si128(anyGlowing, result);
+        }
+        
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(anyGlowing, zero)) != 0xFFFF;
+       #else
+        uint8_t anyGlowing = 0;
+        
+        for(int x = 0; x < widthPixels; ++x)
+        {
+            const bool lit = (rowBits[x / 64] >> (63 - x % 64)) & 0x1;
+            rowIntensities[x] = lit ? 255 : uint8_t((rowIntensities[x] * decay) >> PhosphorFilter::decayShift);
+            anyGlowing |= rowIntensities[x];
+        }
+        
+        return anyGlowing != 0;
+       #endif
+    }
+}
+
+PhosphorFilter::PhosphorFilter()
+{
+    setPersistence(0.6f);
+    clear();
+}
+
+void PhosphorFilter::setPersistence(float newPersistence)
+{
+    decay = std::min(int(std::clamp(newPersistence, 0.0f, 1.0f) * float(decayDenominator) + 0.5f), maxDecay);
+}
+
+uint64_t PhosphorFilter::update(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels)
+{
+    //Ghosts from the old resolution wouldn't line up with anything
+    if(widthPixels != lastWidth)
+    {
+        clear();
+        lastWidth = widthPixels;
+    }
+    
+    uint64_t newActiveRows = 0;
+    
+    for(int y = 0; y < heightPixels; ++y)
+    {
+        const bool rowActive = (activeRows & (uint64_t(1) << y)) != 0;
+        
+        //A pixel glows if it's lit on any plane
+        const auto& row = framebuffer[y];
+        const uint64_t litBits[Chip8Core::wordsPerPlane] = {row[0] | row[Chip8Core::wordsPerPlane], row[1] | row[Chip8Core::wordsPerPlane + 1]};
+        
+        //Nothing lit and nothing left to fade, so there's no work to do
+        if(litBits[0] == 0 && litBits[1] == 0 && !rowActive)
+        {
+            continue;
+        }
+        
+        if(updateRow(litBits, widthPixels, intensities.data() + y * rowStride, decay))
+        {
+            newActiveRows |= uint64_t(1) << y;
+        }
+    }
+    
+    //Anything glowing now or glowing before may have changed
+    const uint64_t changedRows = activeRows | newActiveRows;
+    activeRows = newActiveRows;
+    
+    return changedRows;
+}
+
+void PhosphorFilter::clear()
+{
+    std::fill(intensities.begin(), intensities.end(), 0);
+    activeRows = 0;
+}
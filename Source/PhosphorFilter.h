@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+
+    PhosphorFilter.h
+    Created: 21 May 2022 2:18:51pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Core.h"
+
+//Fades pixels out over a few frames instead of switching them off, which hides XOR sprite flicker
+class PhosphorFilter
+{
+public:
+    static constexpr int rowStride = Chip8Core::maxWidthPixels;
+    static constexpr int numPixels = rowStride * Chip8Core::maxHeightPixels;
+    
+    PhosphorFilter();
+    
+    //Brightness kept each frame is worked out in 256ths, shifting right by decayShift
+    static constexpr int decayShift = 8;
+    static constexpr int decayDenominator = 1 << decayShift;
+    
+    //How much of a pixel's brightness is kept each frame, from 0 (no ghosting) to 1. It's rounded to 256ths and
+    //kept below 1, getPersistence() returns the value actually used
+    void setPersistence(float newPersistence);
+    float getPersistence() const {return float(decay) / float(decayDenominator);}
+    
+    //Call once per 60Hz frame. Returns the rows whose intensities changed
+    uint64_t update(const Chip8Core::Framebuffer& framebuffer, int widthPixels, int heightPixels);
+    
+    void clear();
+    
+    //One byte per pixel, rowStride bytes per row, 255 is fully lit
+    const std::array<uint8_t, numPixels>& getIntensities() const {return intensities;}
+    
+private:
+    alignas(16) std::array<uint8_t, numPixels> intensities;
+    
+    //A persistence of 1 still fades a little so nothing stays lit forever
+    static constexpr int maxDecay = decayDenominator - 1;
+    int decay;
+    
+    //Rows that had anything still glowing after the last update
+    uint64_t activeRows = 0;
+    
+    int lastWidth = Chip8Core::loResWidthPixels;
+};
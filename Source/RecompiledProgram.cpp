@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    RecompiledProgram.cpp
+    Created: 30 Jul 2022 10:41:26am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "RecompiledProgram.h"
+#include <dlfcn.h>
+
+RecompiledProgram::~RecompiledProgram()
+{
+    close();
+}
+
+bool RecompiledProgram::open(const std::string& libraryPath)
+{
+    close();
+    
+    library = dlopen(libraryPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+    
+    if(library == nullptr)
+    {
+        return false;
+    }
+    
+    const auto* abiVersion = static_cast<const uint32_t*>(dlsym(library, "chip8RecompiledAbiVersion"));
+    const auto* hash = static_cast<const uint64_t*>(dlsym(library, "chip8RecompiledRomHash"));
+    const auto* compiledProfile = static_cast<const uint32_t*>(dlsym(library, "chip8RecompiledProfile"));
+    const auto* compiledMemorySize = static_cast<const uint32_t*>(dlsym(library, "chip8RecompiledMemorySize"));
+    const auto* compiledCodeMap = static_cast<const uint8_t*>(dlsym(library, "chip8RecompiledCodeMap"));
+    void* run = dlsym(library, "chip8RecompiledRun");
+    
+    if(abiVersion == nullptr || hash == nullptr || compiledProfile == nullptr || compiledMemorySize == nullptr
+       || compiledCodeMap == nullptr || run == nullptr || *abiVersion != chip8RecompiledCurrentAbiVersion)
+    {
+        close();
+        return false;
+    }
+    
+    romHash = *hash;
+    profile = *compiledProfile;
+    memorySize = *compiledMemorySize;
+    codeMap = compiledCodeMap;
+    runFunction = reinterpret_cast<Chip8RecompiledRunFunction>(run);
+    
+    return true;
+}
+
+void RecompiledProgram::close()
+{
+    runFunction = nullptr;
+    codeMap = nullptr;
+    
+    if(library != nullptr)
+    {
+        dlclose(library);
+        library = nullptr;
+    }
+}
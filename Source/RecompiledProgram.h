@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+
+    RecompiledProgram.h
+    Created: 30 Jul 2022 10:41:26am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Core.h"
+#include "Chip8RecompiledAbi.h"
+#include <string>
+
+//A program compiled ahead of time by Tools/Recompile and built as a shared library, see
+//Chip8RecompiledAbi.h. Hand it to Chip8Core::setRecompiledProgram() to run it natively
+class RecompiledProgram
+{
+public:
+    RecompiledProgram() {};
+    ~RecompiledProgram();
+    
+    RecompiledProgram(const RecompiledProgram&) = delete;
+    RecompiledProgram& operator=(const RecompiledProgram&) = delete;
+    
+    //Fails if the library is missing any of the exports or was built against another ABI version
+    bool open(const std::string& libraryPath);
+    void close();
+    
+    bool getIsOpen() const {return runFunction != nullptr;}
+    
+    //True if this was compiled from exactly this program, for this profile
+    bool matches(uint64_t programHash, Chip8Profile programProfile, size_t programMemorySize) const
+    {
+        return getIsOpen() && programHash == romHash && uint32_t(programProfile) == profile && programMemorySize == memorySize;
+    }
+    
+    bool isCompiledCode(uint32_t address) const {return (codeMap[address >> 3] >> (address & 7)) & 1;}
+    
+    int run(Chip8RecompiledState& state, int maxCycles) const {return runFunction(&state, maxCycles);}
+    
+private:
+    void* library = nullptr;
+    
+    Chip8RecompiledRunFunction runFunction = nullptr;
+    const uint8_t* codeMap = nullptr;
+    uint64_t romHash = 0;
+    uint32_t profile = 0;
+    uint32_t memorySize = 0;
+};
@@ -0,0 +1,370 @@
+/*
+  ==============================================================================
+
+    RomAnalyser.cpp
+    Created: 8 May 2022 3:21:09pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "RomAnalyser.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    const int unknownIndex = -1;
+    
+    //Past this many values of I at one address, it's taken as unknown there
+    const size_t maxIndexValuesPerAddress = 8;
+    
+    bool contains(const std::vector<int>& values, int value)
+    {
+        return std::find(values.cbegin(), values.cend(), value) != values.cend();
+    }
+    
+    template <typename Address>
+    void sortAndRemoveDuplicates(std::vector<Address>& addresses)
+    {
+        std::sort(addresses.begin(), addresses.end());
+        addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+    }
+    
+    struct PendingAddress
+    {
+        uint16_t address;
+        
+        //Value of I along this path if it was set by ANNN, unknownIndex otherwise
+        int indexRegister;
+    };
+    
+    struct PendingWrite
+    {
+        uint16_t instructionAddress;
+        uint16_t start;
+        uint16_t length;
+    };
+}
+
+RomAnalysis RomAnalyser::analyse(const std::vector<uint8_t>& memory, Chip8Profile profile, uint16_t entryPoint)
+{
+    RomAnalysis analysis;
+    analysis.byteFlags.resize(memory.size(), 0);
+    
+    const bool xoChip = profile == Chip8Profile::xoChip;
+    
+    std::vector<PendingAddress> toVisit {{entryPoint, unknownIndex}};
+    std::vector<PendingWrite> writes;
+    
+    //The values of I each address has been walked with
+    std::vector<std::vector<int>> indexValuesWalked(memory.size());
+    
+    const auto isLongLoad = [&memory, xoChip](uint32_t address)
+    {
+        return xoChip && address + 1 < memory.size() && memory[address] == 0xF0 && memory[address + 1] == 0x00;
+    };
+    
+    const auto addSuccessor = [&toVisit, &analysis, &memory](uint16_t address, int indexRegister, bool isBranch)
+    {
+        if(isBranch && address < memory.size())
+        {
+            analysis.byteFlags[address] |= RomAnalysis::branchTarget;
+        }
+        
+        toVisit.push_back({address, indexRegister});
+    };
+    
+    while(!toVisit.empty())
+    {
+        const PendingAddress current = toVisit.back();
+        toVisit.pop_back();
+        
+        const uint16_t address = current.address;
+        
+        if(size_t(address) + 1 >= memory.size())
+        {
+            analysis.outOfBoundsAddresses.push_back(address);
+            continue;
+        }
+        
+        //Each address is walked again for every new value of I that reaches it, so each store is checked against every I it
+        //can have. Unknown covers every value, as a store with it is already reported as unresolved
+        std::vector<int>& indexValues = indexValuesWalked[address];
+        int indexRegister = current.indexRegister;
+        
+        if(contains(indexValues, unknownIndex) || contains(indexValues, indexRegister))
+        {
+            continue;
+        }
+        
+        if(indexValues.size() >= maxIndexValuesPerAddress)
+        {
+            indexRegister = unknownIndex;
+        }
+        
+        indexValues.push_back(indexRegister);
+        
+        analysis.byteFlags[address] |= RomAnalysis::code | RomAnalysis::instructionStart;
+        analysis.byteFlags[address + 1] |= RomAnalysis::code;
+        
+        const uint16_t opcode = (memory[address] << 8) | memory[address + 1];
+        const uint16_t nnn = 0x0FFF & opcode;
+        const uint8_t registerIndex = (0x0F00 & opcode) >> 8;
+        const uint16_t next = address + 2;
+        
+        if(!isRecognisedOpcode(opcode, profile))
+        {
+            //The core reports these and carries on, so keep walking
+            analysis.unrecognisedOpcodeAddresses.push_back(address);
+            addSuccessor(next, indexRegister, false);
+            continue;
+        }
+        
+        switch(0xF000 & opcode)
+        {
+            case 0x0000:
+            {
+                //Returns end the path, the matching call already queued its fall through. 00FD halts
+                if(opcode != 0x00EE && opcode != 0x00FD)
+                {
+                    addSuccessor(next, indexRegister, false);
+                }
+                break;
+            }
+                
+            case 0x1000:
+            {
+                addSuccessor(nnn, indexRegister, true);
+                break;
+            }
+                
+            case 0x2000:
+            {
+                //I is unknown on return, the subroutine may have changed it
+                addSuccessor(nnn, indexRegister, true);
+                addSuccessor(next, unknownIndex, false);
+                break;
+            }
+                
+            case 0x5000:
+            {
+                //XO-CHIP register range save, 5XY3 loads so needs nothing here
+                if(xoChip && (0x000F & opcode) == 0x0002)
+                {
+                    const int firstRegister = registerIndex;
+                    const int lastRegister = (0x00F0 & opcode) >> 4;
+                    const uint16_t length = std::abs(lastRegister - firstRegister) + 1;
+                    
+                    if(indexRegister == unknownIndex)
+                    {
+                        analysis.hasUnresolvedWrites = true;
+                    }
+                    else
+                    {
+                        writes.push_back({address, uint16_t(indexRegister), length});
+                    }
+                    
+                    addSuccessor(next, indexRegister, false);
+                    break;
+                }
+                
+                if(xoChip && (0x000F & opcode) == 0x0003)
+                {
+                    addSuccessor(next, indexRegister, false);
+                    break;
+                }
+                
+                //Otherwise a skip, like the rest
+                addSuccessor(next, indexRegister, false);
+                addSuccessor(next + (isLongLoad(next) ? 4 : 2), indexRegister, true);
+                break;
+            }
+                
+            case 0x3000:
+            case 0x4000:
+            case 0x9000:
+            case 0xE000:
+            {
+                addSuccessor(next, indexRegister, false);
+                addSuccessor(next + (isLongLoad(next) ? 4 : 2), indexRegister, true);
+                break;
+            }
+                
+            case 0xA000:
+            {
+                addSuccessor(next, nnn, false);
+                break;
+            }
+                
+            case 0xB000:
+            {
+                analysis.computedJumpAddresses.push_back(address);
+                break;
+            }
+                
+            case 0xF000:
+            {
+                if(isLongLoad(address))
+                {
+                    //The address word is part of the instruction
+                    analysis.byteFlags[(address + 2) & (memory.size() - 1)] |= RomAnalysis::code;
+                    analysis.byteFlags[(address + 3) & (memory.size() - 1)] |= RomAnalysis::code;
+                    
+                    const int longAddress = (memory[(address + 2) & (memory.size() - 1)] << 8) | memory[(address + 3) & (memory.size() - 1)];
+                    addSuccessor(address + 4, longAddress, false);
+                    break;
+                }
+                
+                switch(0x00FF & opcode)
+                {
+                    case 0x001E:
+                    case 0x0029:
+                    case 0x0030:
+                    case 0x0065:
+                    {
+                        indexRegister = unknownIndex;
+                        break;
+                    }
+                        
+                    case 0x0033:
+                    case 0x0055:
+                    {
+                        const uint16_t length = (0x00FF & opcode) == 0x0033 ? 3 : registerIndex + 1;
+                        
+                        if(indexRegister == unknownIndex)
+                        {
+                            analysis.hasUnresolvedWrites = true;
+                        }
+                        else
+                        {
+                            writes.push_back({address, uint16_t(indexRegister), length});
+                        }
+                        break;
+                    }
+                        
+                    default:
+                        break;
+                }
+                
+                addSuccessor(next, indexRegister, false);
+                break;
+            }
+                
+            default:
+            {
+                addSuccessor(next, indexRegister, false);
+                break;
+            }
+        }
+    }
+    
+    //Only check stores once the code map is complete
+    for(const auto& write : writes)
+    {
+        bool hitsCode = false;
+        
+        for(int offset = 0; offset < write.length; ++offset)
+        {
+            const size_t target = write.start + offset;
+            
+            if(target < memory.size())
+            {
+                analysis.byteFlags[target] |= RomAnalysis::writtenTo;
+                hitsCode |= analysis.isCode(target);
+            }
+        }
+        
+        if(hitsCode)
+        {
+            analysis.selfModifyingWriteAddresses.push_back(write.instructionAddress);
+        }
+    }
+    
+    //An address walked with more than one I adds itself once each time
+    sortAndRemoveDuplicates(analysis.unrecognisedOpcodeAddresses);
+    sortAndRemoveDuplicates(analysis.selfModifyingWriteAddresses);
+    sortAndRemoveDuplicates(analysis.outOfBoundsAddresses);
+    sortAndRemoveDuplicates(analysis.computedJumpAddresses);
+    
+    return analysis;
+}
+
+RomAnalysis RomAnalyser::analyseProgram(const uint8_t* programData, size_t programSize, Chip8Profile profile)
+{
+    Chip8Core core;
+    core.setProfile(profile);
+    core.load(programData, programSize);
+    
+    return analyse(core.getMemory(), profile);
+}
+
+bool RomAnalyser::isRecognisedOpcode(uint16_t opcode, Chip8Profile profile)
+{
+    const bool superChip = profile != Chip8Profile::chip8;
+    const bool xoChip = profile == Chip8Profile::xoChip;
+    
+    switch(0xF000 & opcode)
+    {
+        case 0x0000:
+        {
+            if(opcode == 0x00E0 || opcode == 0x00EE)
+            {
+                return true;
+            }
+            
+            if(xoChip && (0xFFF0 & opcode) == 0x00D0)
+            {
+                return true;
+            }
+            
+            return superChip && ((0xFFF0 & opcode) == 0x00C0 || (opcode >= 0x00FB && opcode <= 0x00FF));
+        }
+            
+        case 0x8000:
+        {
+            const uint16_t lastDigit = 0x000F & opcode;
+            return lastDigit <= 0x0007 || lastDigit == 0x000E;
+        }
+            
+        case 0xE000:
+        {
+            const uint16_t lastByte = 0x00FF & opcode;
+            return lastByte == 0x009E || lastByte == 0x00A1;
+        }
+            
+        case 0xF000:
+        {
+            switch(0x00FF & opcode)
+            {
+                case 0x0007:
+                case 0x000A:
+                case 0x0015:
+                case 0x0018:
+                case 0x001E:
+                case 0x0029:
+                case 0x0033:
+                case 0x0055:
+                case 0x0065:
+                    return true;
+                    
+                case 0x0030:
+                case 0x0075:
+                case 0x0085:
+                    return superChip;
+                    
+                case 0x0000:
+                    return xoChip && opcode == 0xF000;
+                    
+                case 0x0001:
+                    return xoChip;
+                    
+                default:
+                    return false;
+            }
+        }
+            
+        default:
+            return true;
+    }
+}
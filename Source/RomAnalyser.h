@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    RomAnalyser.h
+    Created: 8 May 2022 3:21:09pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Chip8Core.h"
+#include <vector>
+
+//Result of walking a program from its entry point without running it
+struct RomAnalysis
+{
+    enum ByteFlags : uint8_t
+    {
+        code             = 1 << 0,
+        instructionStart = 1 << 1,
+        branchTarget     = 1 << 2,
+        writtenTo        = 1 << 3
+    };
+    
+    //One entry per byte of memory
+    std::vector<uint8_t> byteFlags;
+    
+    std::vector<uint16_t> unrecognisedOpcodeAddresses;
+    
+    //FX33/FX55 instructions whose store overlaps reachable code
+    std::vector<uint16_t> selfModifyingWriteAddresses;
+    
+    //Instructions that would fetch from past the end of memory
+    std::vector<uint16_t> outOfBoundsAddresses;
+    
+    //BNNN jumps, their targets depend on V0 so aren't followed
+    std::vector<uint16_t> computedJumpAddresses;
+    
+    //A store whose I couldn't be worked out, so may hit code the map doesn't know about
+    bool hasUnresolvedWrites = false;
+    
+    bool isCode(uint16_t address) const {return (byteFlags[address] & code) != 0;}
+    bool isInstructionStart(uint16_t address) const {return (byteFlags[address] & instructionStart) != 0;}
+    
+    //False if running the ROM can reach an unknown opcode or leave memory
+    bool isRunnable() const {return unrecognisedOpcodeAddresses.empty() && outOfBoundsAddresses.empty();}
+};
+
+class RomAnalyser
+{
+public:
+    //memory is a full machine image, as laid out by Chip8Core::load()
+    static RomAnalysis analyse(const std::vector<uint8_t>& memory, Chip8Profile profile = Chip8Profile::chip8, uint16_t entryPoint = Chip8Core::programStart);
+    
+    static RomAnalysis analyseProgram(const uint8_t* programData, size_t programSize, Chip8Profile profile = Chip8Profile::chip8);
+    
+    //Matches what Chip8Core::decodeAndExecuteOpcode() accepts
+    static bool isRecognisedOpcode(uint16_t opcode, Chip8Profile profile = Chip8Profile::chip8);
+};
@@ -0,0 +1,288 @@
+/*
+  ==============================================================================
+
+    RomArchive.cpp
+    Created: 2 May 2022 9:03:18pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "RomArchive.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const char archiveMagic[4] = {'C', '8', 'R', 'A'};
+    
+    int compareName(const RomArchiveEntry& entry, const std::string& name)
+    {
+        return std::strncmp(entry.name, name.c_str(), sizeof(entry.name));
+    }
+    
+    template <typename Value>
+    Value readLittleEndian(const uint8_t* bytes)
+    {
+        Value value = 0;
+        
+        for(size_t i = 0; i < sizeof(Value); ++i)
+        {
+            value |= Value(bytes[i]) << (8 * i);
+        }
+        
+        return value;
+    }
+    
+    template <typename Value>
+    void writeLittleEndian(uint8_t* bytes, Value value)
+    {
+        for(size_t i = 0; i < sizeof(Value); ++i)
+        {
+            bytes[i] = uint8_t(value >> (8 * i));
+        }
+    }
+    
+    //Byte offsets are the struct's, which the static_asserts in the header keep to the on-disk layout
+    RomArchiveHeader decodeHeader(const uint8_t* bytes)
+    {
+        RomArchiveHeader header {};
+        std::memcpy(header.magic, bytes + offsetof(RomArchiveHeader, magic), sizeof(header.magic));
+        header.version = readLittleEndian<uint32_t>(bytes + offsetof(RomArchiveHeader, version));
+        header.numEntries = readLittleEndian<uint32_t>(bytes + offsetof(RomArchiveHeader, numEntries));
+        header.indexOffset = readLittleEndian<uint32_t>(bytes + offsetof(RomArchiveHeader, indexOffset));
+        header.dataOffset = readLittleEndian<uint32_t>(bytes + offsetof(RomArchiveHeader, dataOffset));
+        return header;
+    }
+    
+    void encodeHeader(const RomArchiveHeader& header, uint8_t* bytes)
+    {
+        std::memset(bytes, 0, sizeof(RomArchiveHeader));
+        std::memcpy(bytes + offsetof(RomArchiveHeader, magic), header.magic, sizeof(header.magic));
+        writeLittleEndian(bytes + offsetof(RomArchiveHeader, version), header.version);
+        writeLittleEndian(bytes + offsetof(RomArchiveHeader, numEntries), header.numEntries);
+        writeLittleEndian(bytes + offsetof(RomArchiveHeader, indexOffset), header.indexOffset);
+        writeLittleEndian(bytes + offsetof(RomArchiveHeader, dataOffset), header.dataOffset);
+    }
+    
+    RomArchiveEntry decodeEntry(const uint8_t* bytes)
+    {
+        RomArchiveEntry entry {};
+        std::memcpy(entry.name, bytes + offsetof(RomArchiveEntry, name), sizeof(entry.name));
+        entry.hash = readLittleEndian<uint64_t>(bytes + offsetof(RomArchiveEntry, hash));
+        entry.offset = readLittleEndian<uint32_t>(bytes + offsetof(RomArchiveEntry, offset));
+        entry.length = readLittleEndian<uint32_t>(bytes + offsetof(RomArchiveEntry, length));
+        entry.quirkProfile = readLittleEndian<uint32_t>(bytes + offsetof(RomArchiveEntry, quirkProfile));
+        return entry;
+    }
+    
+    void encodeEntry(const RomArchiveEntry& entry, uint8_t* bytes)
+    {
+        std::memset(bytes, 0, sizeof(RomArchiveEntry));
+        std::memcpy(bytes + offsetof(RomArchiveEntry, name), entry.name, sizeof(entry.name));
+        writeLittleEndian(bytes + offsetof(RomArchiveEntry, hash), entry.hash);
+        writeLittleEndian(bytes + offsetof(RomArchiveEntry, offset), entry.offset);
+        writeLittleEndian(bytes + offsetof(RomArchiveEntry, length), entry.length);
+        writeLittleEndian(bytes + offsetof(RomArchiveEntry, quirkProfile), entry.quirkProfile);
+    }
+}
+
+RomArchive::~RomArchive()
+{
+    close();
+}
+
+bool RomArchive::open(const std::string& filePath)
+{
+    close();
+    
+    const int fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+    
+    if(fileDescriptor < 0)
+    {
+        return false;
+    }
+    
+    struct stat fileInfo;
+    
+    if(fstat(fileDescriptor, &fileInfo) != 0 || size_t(fileInfo.st_size) < sizeof(RomArchiveHeader))
+    {
+        ::close(fileDescriptor);
+        return false;
+    }
+    
+    void* mapping = mmap(nullptr, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    
+    //The mapping holds its own reference to the file
+    ::close(fileDescriptor);
+    
+    if(mapping == MAP_FAILED)
+    {
+        return false;
+    }
+    
+    mappedData = static_cast<const uint8_t*>(mapping);
+    mappedSize = fileInfo.st_size;
+    
+    const RomArchiveHeader header = decodeHeader(mappedData);
+    
+    const bool headerValid = std::memcmp(header.magic, archiveMagic, sizeof(archiveMagic)) == 0
+                          && header.version == currentVersion
+                          && header.indexOffset + uint64_t(header.numEntries) * sizeof(RomArchiveEntry) <= mappedSize
+                          && header.dataOffset <= mappedSize;
+    
+    if(!headerValid)
+    {
+        close();
+        return false;
+    }
+    
+    romData = mappedData + header.dataOffset;
+    
+    //Check every ROM lies inside the file so getRom() never has to
+    const size_t dataSize = mappedSize - header.dataOffset;
+    entries.resize(header.numEntries);
+    
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i] = decodeEntry(mappedData + header.indexOffset + i * sizeof(RomArchiveEntry));
+        
+        if(uint64_t(entries[i].offset) + entries[i].length > dataSize)
+        {
+            close();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void RomArchive::close()
+{
+    if(mappedData != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+    }
+    
+    mappedData = nullptr;
+    mappedSize = 0;
+    entries.clear();
+    romData = nullptr;
+}
+
+RomView RomArchive::getRom(size_t index) const
+{
+    return getRom(entries[index]);
+}
+
+RomView RomArchive::getRom(const RomArchiveEntry& entry) const
+{
+    return {romData + entry.offset, entry.length};
+}
+
+const RomArchiveEntry* RomArchive::findEntry(const std::string& name) const
+{
+    const RomArchiveEntry* begin = entries.data();
+    const RomArchiveEntry* end = begin + entries.size();
+    
+    const RomArchiveEntry* found = std::lower_bound(begin, end, name, [](const RomArchiveEntry& entry, const std::string& nameToFind)
+    {
+        return compareName(entry, nameToFind) < 0;
+    });
+    
+    if(found != end && compareName(*found, name) == 0)
+    {
+        return found;
+    }
+    
+    return nullptr;
+}
+
+bool RomArchive::write(const std::string& filePath, std::vector<SourceRom> roms)
+{
+    //Names are truncated to fit the entry, so sort on what actually gets stored
+    for(auto& rom : roms)
+    {
+        rom.name = getStoredName(rom.name);
+    }
+    
+    std::sort(roms.begin(), roms.end(), [](const SourceRom& first, const SourceRom& second)
+    {
+        return first.name < second.name;
+    });
+    
+    //findEntry() could only ever find one of them
+    const auto sameName = [](const SourceRom& first, const SourceRom& second) {return first.name == second.name;};
+    
+    if(std::adjacent_find(roms.cbegin(), roms.cend(), sameName) != roms.cend())
+    {
+        return false;
+    }
+    
+    RomArchiveHeader header {};
+    std::memcpy(header.magic, archiveMagic, sizeof(archiveMagic));
+    header.version = currentVersion;
+    header.numEntries = uint32_t(roms.size());
+    header.indexOffset = sizeof(RomArchiveHeader);
+    header.dataOffset = uint32_t(header.indexOffset + roms.size() * sizeof(RomArchiveEntry));
+    
+    std::vector<uint8_t> headerAndIndex(header.dataOffset);
+    encodeHeader(header, headerAndIndex.data());
+    
+    uint32_t currentOffset = 0;
+    
+    for(size_t i = 0; i < roms.size(); ++i)
+    {
+        RomArchiveEntry entry {};
+        
+        std::memcpy(entry.name, roms[i].name.data(), roms[i].name.size());
+        entry.hash = hashRom(roms[i].data.data(), roms[i].data.size());
+        entry.offset = currentOffset;
+        entry.length = uint32_t(roms[i].data.size());
+        entry.quirkProfile = roms[i].quirkProfile;
+        
+        encodeEntry(entry, headerAndIndex.data() + header.indexOffset + i * sizeof(RomArchiveEntry));
+        
+        currentOffset += entry.length;
+    }
+    
+    std::ofstream outputStream(filePath, std::ios::binary | std::ios::trunc);
+    
+    if(!outputStream.is_open())
+    {
+        return false;
+    }
+    
+    outputStream.write(reinterpret_cast<const char*>(headerAndIndex.data()), headerAndIndex.size());
+    
+    for(const auto& rom : roms)
+    {
+        outputStream.write(reinterpret_cast<const char*>(rom.data.data()), rom.data.size());
+    }
+    
+    return outputStream.good();
+}
+
+std::string RomArchive::getStoredName(const std::string& name)
+{
+    return name.substr(0, std::min(name.size(), sizeof(RomArchiveEntry::name)));
+}
+
+uint64_t RomArchive::hashRom(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+    
+    return hash;
+}
@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    RomArchive.h
+    Created: 2 May 2022 9:03:18pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    Packed ROM library, laid out as:
+
+        RomArchiveHeader
+        RomArchiveEntry[numEntries]     sorted by name
+        ROM bytes, back to back
+
+    All values are little endian and are read and written a byte at a time, so an
+    archive is the same on any host. The archive is memory mapped on open, the
+    header and index are decoded from it and ROMs are handed out as pointers
+    straight into the mapping.
+*/
+
+struct RomArchiveHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t numEntries;
+    uint32_t indexOffset;
+    uint32_t dataOffset;
+    uint32_t reserved[3];
+};
+
+struct RomArchiveEntry
+{
+    //Null padded, names longer than this are truncated by the builder
+    char name[40];
+    
+    //FNV-1a of the ROM bytes
+    uint64_t hash;
+    
+    //Relative to dataOffset
+    uint32_t offset;
+    uint32_t length;
+    
+    uint32_t quirkProfile;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(RomArchiveHeader) == 32, "RomArchiveHeader must match the on-disk layout");
+static_assert(sizeof(RomArchiveEntry) == 64, "RomArchiveEntry must match the on-disk layout");
+
+struct RomView
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+class RomArchive
+{
+public:
+    RomArchive() {};
+    ~RomArchive();
+    
+    RomArchive(const RomArchive&) = delete;
+    RomArchive& operator=(const RomArchive&) = delete;
+    
+    bool open(const std::string& filePath);
+    void close();
+    
+    bool getIsOpen() const {return mappedData != nullptr;}
+    
+    size_t getNumRoms() const {return entries.size();}
+    const RomArchiveEntry& getEntry(size_t index) const {return entries[index];}
+    RomView getRom(size_t index) const;
+    
+    //Binary searches the index, returns nullptr if there is no ROM with this name
+    const RomArchiveEntry* findEntry(const std::string& name) const;
+    RomView getRom(const RomArchiveEntry& entry) const;
+    
+    struct SourceRom
+    {
+        std::string name;
+        std::vector<uint8_t> data;
+        uint32_t quirkProfile = 0;
+    };
+    
+    //Fails without writing anything if two names are the same once truncated to fit an entry
+    static bool write(const std::string& filePath, std::vector<SourceRom> roms);
+    
+    //The name as it's stored in an entry
+    static std::string getStoredName(const std::string& name);
+    
+    static uint64_t hashRom(const uint8_t* data, size_t size);
+    
+    static constexpr uint32_t currentVersion = 1;
+    
+private:
+    const uint8_t* mappedData = nullptr;
+    size_t mappedSize = 0;
+    
+    //Decoded from the mapping on open
+    std::vector<RomArchiveEntry> entries;
+    const uint8_t* romData = nullptr;
+};
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.cpp
+    Created: 2 Jul 2022 4:12:50pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+bool TraceRecorder::start(const std::string& filePath, size_t ringCapacity)
+{
+    stop();
+
+    file = std::fopen(filePath.c_str(), "wb");
+
+    if(file == nullptr)
+    {
+        return false;
+    }
+
+    TraceFileHeader header {};
+    std::memcpy(header.magic, "C8TR", 4);
+    header.version = currentVersion;
+    header.recordSize = sizeof(uint64_t);
+
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    size_t capacity = 1;
+
+    while(capacity < ringCapacity)
+    {
+        capacity <<= 1;
+    }
+
+    ring.assign(capacity, 0);
+    ringMask = capacity - 1;
+
+    writeIndex = 0;
+    readIndex = 0;
+    cachedReadIndex = 0;
+    nextCycle = ~uint64_t(0);
+    droppedCount = 0;
+
+    stopRequested = false;
+    writerThread = std::thread([this]()
+    {
+        writerLoop();
+    });
+
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    if(file == nullptr)
+    {
+        return;
+    }
+
+    stopRequested = true;
+    writerThread.join();
+
+    //The producer has stopped by now, so anything left is safe to take
+    writeAvailable();
+
+    if(const uint64_t dropped = droppedCount.load())
+    {
+        const uint64_t record = (traceDroppedKind << traceKindShift) | dropped;
+        std::fwrite(&record, sizeof(record), 1, file);
+    }
+
+    std::fclose(file);
+    file = nullptr;
+}
+
+void TraceRecorder::writerLoop()
+{
+    while(!stopRequested)
+    {
+        if(!writeAvailable())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool TraceRecorder::writeAvailable()
+{
+    const uint64_t read = readIndex.load(std::memory_order_relaxed);
+    const uint64_t write = writeIndex.load(std::memory_order_acquire);
+
+    if(read == write)
+    {
+        return false;
+    }
+
+    //At most two runs, either side of the wrap
+    const uint64_t firstIndex = read & ringMask;
+    const uint64_t firstCount = std::min(write - read, ring.size() - firstIndex);
+
+    std::fwrite(ring.data() + firstIndex, sizeof(uint64_t), firstCount, file);
+    std::fwrite(ring.data(), sizeof(uint64_t), (write - read) - firstCount, file);
+
+    readIndex.store(write, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.h
+    Created: 2 Jul 2022 4:12:50pm
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Instruction trace file, laid out as:
+
+        TraceFileHeader
+        uint64_t records, back to back
+
+    All values are little endian. Each record is one of:
+
+        Instruction     bits 0-15 PC it was fetched from, 16-31 opcode, 32-47 I afterwards,
+                        48-51 lowest V register it changed, 52-59 that register's new value,
+                        60 set if any register changed, 61-63 zero
+        Sync            bits 0-60 cycle of the next instruction record, 61-63 traceSyncKind
+        Dropped         bits 0-60 records lost to a full ring buffer, 61-63 traceDroppedKind
+
+    Instructions are one cycle apart unless a sync record says otherwise, which happens
+    at the start, after a load, whenever the core went a cycle without running anything
+    and after records were dropped.
+*/
+
+struct TraceFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TraceFileHeader) == 16, "TraceFileHeader must match the on-disk layout");
+
+static constexpr uint64_t traceInstructionKind = 0;
+static constexpr uint64_t traceSyncKind = 1;
+static constexpr uint64_t traceDroppedKind = 2;
+static constexpr int traceKindShift = 61;
+static constexpr uint64_t traceRegisterChangedBit = uint64_t(1) << 60;
+
+//Streams one core's instruction trace to disk. The core fills a single producer ring buffer and a
+//background thread empties it into the file, so tracing never waits on I/O. A full ring drops records
+class TraceRecorder
+{
+public:
+    static constexpr uint32_t currentVersion = 1;
+
+    TraceRecorder() {};
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    //ringCapacity is rounded up to a power of two
+    bool start(const std::string& filePath, size_t ringCapacity = 1 << 16);
+
+    //Writes out everything still in the ring and closes the file
+    void stop();
+
+    bool getIsRecording() const {return file != nullptr;}
+
+    //Records lost so far because the writer couldn't keep up
+    uint64_t getDroppedCount() const {return droppedCount.load(std::memory_order_relaxed);}
+
+    //Emulation thread only. Called after the instruction at programCounter has run
+    void recordInstruction(uint64_t cycle, uint16_t programCounter, uint16_t opcode, uint16_t indexRegister,
+                           const std::array<uint8_t, 16>& registersBefore, const std::array<uint8_t, 16>& registersAfter)
+    {
+        if(cycle != nextCycle && !push((traceSyncKind << traceKindShift) | cycle))
+        {
+            return;
+        }
+
+        nextCycle = cycle + 1;
+
+        uint64_t record = uint64_t(programCounter) | (uint64_t(opcode) << 16) | (uint64_t(indexRegister) << 32);
+
+        //Compare the registers eight at a time, the lowest set byte of the difference is the lowest changed register
+        uint64_t before[2];
+        uint64_t after[2];
+        std::memcpy(before, registersBefore.data(), sizeof(before));
+        std::memcpy(after, registersAfter.data(), sizeof(after));
+
+        const uint64_t lowChanges = before[0] ^ after[0];
+        const uint64_t highChanges = before[1] ^ after[1];
+
+        if((lowChanges | highChanges) != 0)
+        {
+            const int registerIndex = lowChanges != 0 ? lowestSetByte(lowChanges) : 8 + lowestSetByte(highChanges);
+            record |= traceRegisterChangedBit | (uint64_t(registerIndex) << 48) | (uint64_t(registersAfter[registerIndex]) << 52);
+        }
+
+        push(record);
+    }
+
+private:
+    //Byte index of the lowest non-zero byte, assuming little endian like the file format
+    static int lowestSetByte(uint64_t value)
+    {
+        int byteIndex = 0;
+
+        while((value & 0xFF) == 0)
+        {
+            value >>= 8;
+            ++byteIndex;
+        }
+
+        return byteIndex;
+    }
+
+    bool push(uint64_t record)
+    {
+        const uint64_t write = writeIndex.load(std::memory_order_relaxed);
+
+        //Only go back to the shared read index when the cached one says the ring is full
+        if(write - cachedReadIndex > ringMask)
+        {
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+
+            if(write - cachedReadIndex > ringMask)
+            {
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+
+                //Whatever comes next needs a sync record to say where it is
+                nextCycle = ~uint64_t(0);
+                return false;
+            }
+        }
+
+        ring[write & ringMask] = record;
+        writeIndex.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    void writerLoop();
+
+    //Writes everything the producer has published so far, returns false if there was nothing
+    bool writeAvailable();
+
+    std::vector<uint64_t> ring;
+    uint64_t ringMask = 0;
+
+    std::atomic<uint64_t> writeIndex {0};
+    std::atomic<uint64_t> readIndex {0};
+
+    //Producer side copies
+    uint64_t cachedReadIndex = 0;
+    uint64_t nextCycle = ~uint64_t(0);
+
+    std::atomic<uint64_t> droppedCount {0};
+
+    std::FILE* file = nullptr;
+    std::thread writerThread;
+    std::atomic<bool> stopRequested {false};
+};
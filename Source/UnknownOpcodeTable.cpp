@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    UnknownOpcodeTable.cpp
+    Created: 25 Jun 2022 10:31:44am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "UnknownOpcodeTable.h"
+
+UnknownOpcodeTable::UnknownOpcodeTable(const UnknownOpcodeTable& other)
+{
+    *this = other;
+}
+
+UnknownOpcodeTable& UnknownOpcodeTable::operator=(const UnknownOpcodeTable& other)
+{
+    for(int slot = 0; slot < numSlots; ++slot)
+    {
+        slots[slot].key.store(other.slots[slot].key.load(std::memory_order_acquire), std::memory_order_relaxed);
+        slots[slot].count.store(other.slots[slot].count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    overflowCount.store(other.overflowCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+}
+
+void UnknownOpcodeTable::record(uint16_t opcode)
+{
+    const uint32_t key = uint32_t(opcode) + 1;
+
+    //Open addressing with linear probing, slots are only ever claimed so a probe never has to restart
+    const int firstSlot = int((uint32_t(opcode) * 0x9E3779B1u) >> 26);
+
+    for(int probe = 0; probe < numSlots; ++probe)
+    {
+        Slot& slot = slots[(firstSlot + probe) % numSlots];
+        uint32_t slotKey = slot.key.load(std::memory_order_relaxed);
+
+        if(slotKey == 0 && slot.key.compare_exchange_strong(slotKey, key, std::memory_order_release, std::memory_order_relaxed))
+        {
+            slotKey = key;
+        }
+
+        if(slotKey == key)
+        {
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    overflowCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void UnknownOpcodeTable::drain(const std::function<void(uint16_t opcode, uint32_t count)>& callback)
+{
+    for(auto& slot : slots)
+    {
+        const uint32_t key = slot.key.load(std::memory_order_acquire);
+
+        if(key == 0)
+        {
+            continue;
+        }
+
+        const uint32_t count = slot.count.exchange(0, std::memory_order_relaxed);
+
+        if(count != 0)
+        {
+            callback(uint16_t(key - 1), count);
+        }
+    }
+}
+
+void UnknownOpcodeTable::clear()
+{
+    for(auto& slot : slots)
+    {
+        slot.key.store(0, std::memory_order_relaxed);
+        slot.count.store(0, std::memory_order_relaxed);
+    }
+
+    overflowCount.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    UnknownOpcodeTable.h
+    Created: 25 Jun 2022 10:31:44am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+//Counts of unrecognised opcodes, filled in by the emulation thread and drained by whoever reports them.
+//Fixed size and lock free, so recording one costs a couple of atomic operations and never does any I/O
+class UnknownOpcodeTable
+{
+public:
+    static constexpr int numSlots = 64;
+
+    UnknownOpcodeTable() = default;
+
+    //Copies are a snapshot of the counts at the time
+    UnknownOpcodeTable(const UnknownOpcodeTable& other);
+    UnknownOpcodeTable& operator=(const UnknownOpcodeTable& other);
+
+    void record(uint16_t opcode);
+
+    //Passes every opcode seen since the last drain to callback with its count, and resets the counts.
+    //Safe to call from another thread while record() is running
+    void drain(const std::function<void(uint16_t opcode, uint32_t count)>& callback);
+
+    //Sightings of new opcodes that arrived after every slot was taken
+    uint32_t takeOverflowCount() {return overflowCount.exchange(0, std::memory_order_relaxed);}
+
+    //Only from the recording thread. Cores clear theirs on every load and reset
+    void clear();
+
+private:
+    struct Slot
+    {
+        //The opcode plus one, 0 while the slot is free. Once set it never changes until clear()
+        std::atomic<uint32_t> key {0};
+        std::atomic<uint32_t> count {0};
+    };
+
+    std::array<Slot, numSlots> slots;
+    std::atomic<uint32_t> overflowCount {0};
+};
@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    WorkStealingPool.cpp
+    Created: 4 Jun 2022 11:15:37am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(int numThreads)
+{
+    //Slot 0 belongs to whichever thread calls parallelFor()
+    numThreads = std::max(numThreads, 1);
+
+    for(int i = 0; i < numThreads; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+
+    for(int i = 1; i < numThreads; ++i)
+    {
+        workers[i]->thread = std::thread([this, i]()
+        {
+            workerLoop(i);
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobLock);
+        shuttingDown = true;
+    }
+
+    jobStarted.notify_all();
+
+    for(auto& worker : workers)
+    {
+        if(worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
+
+void WorkStealingPool::parallelFor(int numTasks, const std::function<void(int)>& task)
+{
+    if(numTasks <= 0)
+    {
+        return;
+    }
+
+    //Published before any task is queued, a worker still looking for work from the last job may pick one up straight away
+    {
+        std::lock_guard<std::mutex> lock(jobLock);
+        currentTask = &task;
+        tasksRemaining = numTasks;
+        ++jobNumber;
+    }
+
+    //Deal the tasks out round robin so every worker starts with a share
+    for(int taskIndex = 0; taskIndex < numTasks; ++taskIndex)
+    {
+        Worker& worker = *workers[taskIndex % workers.size()];
+
+        std::lock_guard<std::mutex> lock(worker.queueLock);
+        worker.queue.push_back(taskIndex);
+    }
+
+    jobStarted.notify_all();
+
+    runAvailableTasks(0);
+
+    std::unique_lock<std::mutex> lock(jobLock);
+    jobFinished.wait(lock, [this]()
+    {
+        return tasksRemaining == 0;
+    });
+
+    currentTask = nullptr;
+}
+
+void WorkStealingPool::workerLoop(int workerIndex)
+{
+    uint64_t lastJobNumber = 0;
+
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(jobLock);
+            jobStarted.wait(lock, [this, lastJobNumber]()
+            {
+                return shuttingDown || jobNumber != lastJobNumber;
+            });
+
+            if(shuttingDown)
+            {
+                return;
+            }
+
+            lastJobNumber = jobNumber;
+        }
+
+        runAvailableTasks(workerIndex);
+    }
+}
+
+bool WorkStealingPool::runAvailableTasks(int workerIndex)
+{
+    bool ranAnything = false;
+    int taskIndex;
+
+    while(popOwnTask(workerIndex, taskIndex) || stealTask(workerIndex, taskIndex))
+    {
+        (*currentTask)(taskIndex);
+        ranAnything = true;
+
+        if(--tasksRemaining == 0)
+        {
+            std::lock_guard<std::mutex> lock(jobLock);
+            jobFinished.notify_all();
+        }
+    }
+
+    return ranAnything;
+}
+
+bool WorkStealingPool::popOwnTask(int workerIndex, int& taskIndex)
+{
+    Worker& worker = *workers[workerIndex];
+    std::lock_guard<std::mutex> lock(worker.queueLock);
+
+    if(worker.queue.empty())
+    {
+        return false;
+    }
+
+    taskIndex = worker.queue.front();
+    worker.queue.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::stealTask(int thiefIndex, int& taskIndex)
+{
+    for(size_t offset = 1; offset < workers.size(); ++offset)
+    {
+        Worker& victim = *workers[(thiefIndex + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.queueLock);
+
+        if(!victim.queue.empty())
+        {
+            taskIndex = victim.queue.back();
+            victim.queue.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    WorkStealingPool.h
+    Created: 4 Jun 2022 11:15:37am
+    Author:  Max Walley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Fixed set of worker threads, each with its own task queue. Idle workers steal from the back of the others' queues
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int numThreads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    int getNumThreads() const {return int(workers.size());}
+
+    //Calls task(i) for every i in [0, numTasks) and blocks until they have all finished.
+    //The calling thread helps out rather than sitting idle
+    void parallelFor(int numTasks, const std::function<void(int)>& task);
+
+private:
+    struct Worker
+    {
+        std::mutex queueLock;
+        std::deque<int> queue;
+        std::thread thread;
+    };
+
+    void workerLoop(int workerIndex);
+
+    //Runs tasks until there are none left anywhere, returns false if it found nothing to do
+    bool runAvailableTasks(int workerIndex);
+    bool popOwnTask(int workerIndex, int& taskIndex);
+    bool stealTask(int thiefIndex, int& taskIndex);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex jobLock;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+
+    const std::function<void(int)>* currentTask = nullptr;
+    uint64_t jobNumber = 0;
+    std::atomic<int> tasksRemaining {0};
+    bool shuttingDown = false;
+};
@@ -417,6 +417,18 @@ void chip8::debugRender()
 	printf("\n");
 }
 
+void chip8::loadProgram(const unsigned char * data, int size)
+{
+	init();
+
+	// Anything that doesn't fit is dropped
+	if(size > 4096 - 512)
+		size = 4096 - 512;
+
+	for(int i = 0; i < size; ++i)
+		memory[i + 512] = data[i];
+}
+
 bool chip8::loadApplication(const char * filename)
 {
 	init();
@@ -23,6 +23,14 @@ class chip8 {
 		void debugRender();
 		bool loadApplication(const char * filename);		
 
+// Headless access, used by the fuzz harness to run this in lockstep with Chip8Core
+		void loadProgram(const unsigned char * data, int size);
+		unsigned short getPC() const { return pc; }
+		unsigned short getI() const { return I; }
+		unsigned short getSP() const { return sp; }
+		unsigned char getV(int index) const { return V[index]; }
+		unsigned char getMemory(int address) const { return memory[address]; }
+
 // Chip8
 		unsigned char  gfx[64 * 32];	// Total amount of pixels: 2048
 		unsigned char  key[16];			
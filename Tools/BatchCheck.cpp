@@ -0,0 +1,319 @@
+/*
+  ==============================================================================
+
+    BatchCheck.cpp
+    Created: 7 Aug 2022 10:21:33am
+    Author:  Max Walley
+
+    Runs each ROM on a Chip8Batch and on one Chip8Core per instance side by
+    side and compares the PC, I, the registers, memory and the display after
+    every frame. Every instance gets its own keys, or with --same-keys all
+    get the same ones so the batch can run them in lockstep. Then runs the
+    same frames on each alone and reports how many instructions a second
+    both get through. Chip8Batch only does CHIP-8 and draws CXNN from its
+    own generator, so an instance stops being compared once its core runs
+    CXNN. RomGen --no-random ROMs only get there by running into data.
+    Exits with 1 on a difference.
+
+    Usage: BatchCheck [--instances <count>] [--frames <count>] [--cycles <per frame>] [--threads <count>] [--same-keys] <rom> [rom...]
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Batch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Settings
+    {
+        int numInstances = 256;
+        int numFrames = 600;
+        int cyclesPerFrame = 20;
+        int numThreads = 0;
+
+        //Every instance gets instance 0's keys, so they stay in lockstep
+        bool sameKeys = false;
+    };
+
+    //A different key every few frames for each instance, the same sequence whichever machine it's for
+    uint16_t keyStateFor(const Settings& settings, int instance, int frame)
+    {
+        if(settings.sameKeys)
+        {
+            instance = 0;
+        }
+
+        uint32_t hash = uint32_t(instance) * 0x9E3779B1u ^ uint32_t(frame / 6) * 0x85EBCA6Bu;
+        hash ^= hash >> 15;
+        hash *= 0x2C1B3C6Du;
+        hash ^= hash >> 12;
+
+        return (hash & 0x3) == 0 ? 0 : uint16_t(1 << ((hash >> 2) % 16));
+    }
+
+    //Returns the first difference found, or an empty string
+    std::string compareInstance(const Chip8Batch& batch, int instance, const Chip8Core& core)
+    {
+        if(batch.getProgramCounter(instance) != core.getProgramCounter())
+        {
+            return "PC";
+        }
+
+        if(batch.getIndexRegister(instance) != core.getIndexRegister())
+        {
+            return "I";
+        }
+
+        for(int registerIndex = 0; registerIndex < 16; ++registerIndex)
+        {
+            if(batch.getRegister(instance, registerIndex) != core.getRegister(registerIndex))
+            {
+                return "V" + std::string(1, "0123456789ABCDEF"[registerIndex]);
+            }
+        }
+
+        if(std::memcmp(batch.getMemory(instance), core.getMemory().data(), Chip8Batch::memorySize) != 0)
+        {
+            return "memory";
+        }
+
+        const uint64_t* batchRows = batch.getFramebuffer(instance);
+
+        for(int row = 0; row < Chip8Batch::heightPixels; ++row)
+        {
+            if(batchRows[row] != core.getFramebuffer()[row][0])
+            {
+                return "display";
+            }
+        }
+
+        return "";
+    }
+
+    bool isRandomOpcode(const Chip8Core& core)
+    {
+        //The PC can run past the end, fetches wrap round like every other access
+        const size_t programCounter = core.getProgramCounter() & (Chip8Core::memorySize - 1);
+        return (core.getMemory()[programCounter] & 0xF0) == 0xC0;
+    }
+
+    //Adds how many instances ran CXNN, and so weren't compared from then on, to numRandom
+    bool checkRom(const std::string& romPath, const std::vector<uint8_t>& program, const Settings& settings, int& numRandom)
+    {
+        Chip8Batch batch(settings.numInstances, settings.numThreads);
+        batch.setCyclesPerFrame(settings.cyclesPerFrame);
+        batch.load(program.data(), program.size());
+
+        std::vector<std::unique_ptr<Chip8Core>> cores;
+
+        for(int instance = 0; instance < settings.numInstances; ++instance)
+        {
+            cores.push_back(std::make_unique<Chip8Core>());
+            cores.back()->setCyclesPerFrame(settings.cyclesPerFrame);
+            cores.back()->load(program.data(), program.size());
+        }
+
+        std::vector<bool> ranRandom(size_t(settings.numInstances), false);
+
+        for(int frame = 0; frame < settings.numFrames; ++frame)
+        {
+            for(int instance = 0; instance < settings.numInstances; ++instance)
+            {
+                batch.setKeyState(instance, keyStateFor(settings, instance, frame));
+                cores[instance]->setKeyState(keyStateFor(settings, instance, frame));
+
+                //A cycle at a time so CXNN can be spotted before it runs
+                for(int cycle = 0; cycle < settings.cyclesPerFrame; ++cycle)
+                {
+                    if(!ranRandom[instance] && isRandomOpcode(*cores[instance]))
+                    {
+                        ranRandom[instance] = true;
+                        ++numRandom;
+                    }
+
+                    cores[instance]->runCycle();
+                }
+            }
+
+            batch.runFrames(1);
+
+            for(int instance = 0; instance < settings.numInstances; ++instance)
+            {
+                if(ranRandom[instance])
+                {
+                    continue;
+                }
+
+                const std::string difference = compareInstance(batch, instance, *cores[instance]);
+
+                if(!difference.empty())
+                {
+                    std::cout << romPath << ": " << difference << " differs on frame " << frame << ", instance " << instance << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    //Seconds to run every instance through the frames, the keys are worked out up front so only the machines are timed
+    double timeBatch(const std::vector<uint8_t>& program, const Settings& settings, const std::vector<uint16_t>& keyStates)
+    {
+        Chip8Batch batch(settings.numInstances, settings.numThreads);
+        batch.setCyclesPerFrame(settings.cyclesPerFrame);
+        batch.load(program.data(), program.size());
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for(int frame = 0; frame < settings.numFrames; ++frame)
+        {
+            for(int instance = 0; instance < settings.numInstances; ++instance)
+            {
+                batch.setKeyState(instance, keyStates[size_t(frame) * settings.numInstances + instance]);
+            }
+
+            batch.runFrames(1);
+        }
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double timeCores(const std::vector<uint8_t>& program, const Settings& settings, const std::vector<uint16_t>& keyStates)
+    {
+        std::vector<std::unique_ptr<Chip8Core>> cores;
+
+        for(int instance = 0; instance < settings.numInstances; ++instance)
+        {
+            cores.push_back(std::make_unique<Chip8Core>());
+            cores.back()->setCyclesPerFrame(settings.cyclesPerFrame);
+            cores.back()->load(program.data(), program.size());
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        //One core at a time, the way a single thread would run them
+        for(int instance = 0; instance < settings.numInstances; ++instance)
+        {
+            for(int frame = 0; frame < settings.numFrames; ++frame)
+            {
+                cores[instance]->setKeyState(keyStates[size_t(frame) * settings.numInstances + instance]);
+                cores[instance]->runFrame();
+            }
+        }
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    int firstRom = 1;
+
+    for(; firstRom < argc - 1; ++firstRom)
+    {
+        const std::string option = argv[firstRom];
+
+        if(option == "--instances" && firstRom + 2 < argc)
+        {
+            settings.numInstances = std::max(std::stoi(argv[++firstRom]), 1);
+        }
+        else if(option == "--frames" && firstRom + 2 < argc)
+        {
+            settings.numFrames = std::stoi(argv[++firstRom]);
+        }
+        else if(option == "--cycles" && firstRom + 2 < argc)
+        {
+            settings.cyclesPerFrame = std::max(std::stoi(argv[++firstRom]), 1);
+        }
+        else if(option == "--same-keys")
+        {
+            settings.sameKeys = true;
+        }
+        else if(option == "--threads" && firstRom + 2 < argc)
+        {
+            settings.numThreads = std::stoi(argv[++firstRom]);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if(firstRom >= argc)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--instances <count>] [--frames <count>] [--cycles <per frame>] [--threads <count>] [--same-keys] <rom> [rom...]" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint16_t> keyStates(size_t(settings.numFrames) * settings.numInstances);
+
+    for(int frame = 0; frame < settings.numFrames; ++frame)
+    {
+        for(int instance = 0; instance < settings.numInstances; ++instance)
+        {
+            keyStates[size_t(frame) * settings.numInstances + instance] = keyStateFor(settings, instance, frame);
+        }
+    }
+
+    int numPassed = 0;
+    int numFailed = 0;
+    int numRandom = 0;
+    double batchSeconds = 0.0;
+    double coreSeconds = 0.0;
+
+    for(int arg = firstRom; arg < argc; ++arg)
+    {
+        std::ifstream romStream(argv[arg], std::ios::binary);
+
+        if(!romStream)
+        {
+            std::cerr << "Couldn't open " << argv[arg] << std::endl;
+            ++numFailed;
+            continue;
+        }
+
+        const std::vector<uint8_t> program {std::istreambuf_iterator<char>(romStream), std::istreambuf_iterator<char>()};
+
+        if(!checkRom(argv[arg], program, settings, numRandom))
+        {
+            ++numFailed;
+            continue;
+        }
+
+        ++numPassed;
+        batchSeconds += timeBatch(program, settings, keyStates);
+        coreSeconds += timeCores(program, settings, keyStates);
+    }
+
+    //Every instance runs every cycle of every frame on the batch, the same count is used for the cores
+    const double numInstructions = double(numPassed) * settings.numInstances * settings.numFrames * settings.cyclesPerFrame;
+
+    std::cout << numPassed << " matched, " << numFailed << " differed. " << settings.numInstances << " instances, "
+              << settings.numFrames << " frames of " << settings.cyclesPerFrame << " cycles" << std::endl;
+
+    if(numRandom > 0)
+    {
+        std::cout << numRandom << " instances ran CXNN and weren't compared after it" << std::endl;
+    }
+
+    if(numPassed > 0)
+    {
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Chip8Batch: " << numInstructions / std::max(batchSeconds, 1e-9) / 1e6 << "M instructions/s" << std::endl
+                  << "Chip8Core:  " << numInstructions / std::max(coreSeconds, 1e-9) / 1e6 << "M instructions/s, one thread" << std::endl;
+    }
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+/*
+  ==============================================================================
+
+    Conformance.cpp
+    Created: 4 Aug 2022 6:02:37pm
+    Author:  Max Walley
+
+    Plays test ROMs to a fixed frame with frame hashing on and checks each
+    core's frame hash against the golden one, across every hardware thread.
+    Exits with 1 if any ROM differs or can't be read. With --update the
+    golden file is rewritten with the hashes found instead.
+
+    Each line of the golden file is
+        <rom> <chip8 | schip | xo> <frames> <cycles per frame> <hash> [<frame>:<keys>...]
+    ROM paths are relative to the golden file and can't contain spaces. A hash
+    of - is filled in by --update. Each <frame>:<keys> sets the key state, in
+    hex, from the start of that frame on. Lines starting with # are comments.
+
+    Usage: Conformance [--update] [--threads <count>] <golden file>
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Core.h"
+#include "../Source/WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct GoldenEntry
+    {
+        std::string romPath;
+        std::string profileName;
+        Chip8Profile profile = Chip8Profile::chip8;
+        int numFrames = 0;
+        int cyclesPerFrame = 0;
+        bool hasHash = false;
+        uint64_t goldenHash = 0;
+
+        //Frame to start holding the keys on, and the keys
+        std::vector<std::pair<int, uint16_t>> keyChanges;
+
+        //The golden file line it came from
+        size_t lineIndex = 0;
+
+        bool readRom = false;
+        uint64_t frameHash = 0;
+    };
+
+    bool parseProfile(const std::string& name, Chip8Profile& profile)
+    {
+        if(name == "chip8")
+        {
+            profile = Chip8Profile::chip8;
+        }
+        else if(name == "schip")
+        {
+            profile = Chip8Profile::superChip;
+        }
+        else if(name == "xo")
+        {
+            profile = Chip8Profile::xoChip;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool parseEntry(const std::string& line, GoldenEntry& entry)
+    {
+        std::istringstream fields(line);
+        std::string hash;
+
+        if(!(fields >> entry.romPath >> entry.profileName >> entry.numFrames >> entry.cyclesPerFrame >> hash)
+           || !parseProfile(entry.profileName, entry.profile) || entry.numFrames < 0 || entry.cyclesPerFrame < 1)
+        {
+            return false;
+        }
+
+        if(hash != "-")
+        {
+            if(hash.size() > 16 || hash.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+            {
+                return false;
+            }
+
+            entry.hasHash = true;
+            entry.goldenHash = std::stoull(hash, nullptr, 16);
+        }
+
+        std::string keyChange;
+
+        while(fields >> keyChange)
+        {
+            const size_t colon = keyChange.find(':');
+
+            if(colon == std::string::npos)
+            {
+                return false;
+            }
+
+            entry.keyChanges.emplace_back(std::stoi(keyChange.substr(0, colon)), uint16_t(std::stoul(keyChange.substr(colon + 1), nullptr, 16)));
+        }
+
+        return true;
+    }
+
+    std::string toHex(uint64_t value)
+    {
+        std::ostringstream hex;
+        hex << std::hex << std::setw(16) << std::setfill('0') << value;
+        return hex.str();
+    }
+
+    //CXNN always draws the same numbers, so a run only depends on the ROM and the entry
+    void runEntry(GoldenEntry& entry, const std::string& romDirectory)
+    {
+        std::ifstream romStream(romDirectory + entry.romPath, std::ios::binary);
+
+        if(!romStream)
+        {
+            return;
+        }
+
+        const std::vector<uint8_t> program {std::istreambuf_iterator<char>(romStream), std::istreambuf_iterator<char>()};
+        entry.readRom = true;
+
+        Chip8Core core;
+        core.setProfile(entry.profile);
+        core.setCyclesPerFrame(entry.cyclesPerFrame);
+        core.setSeed(0);
+        core.load(program.data(), program.size());
+        core.setFrameHashing(true);
+
+        size_t nextKeyChange = 0;
+
+        for(int frame = 0; frame < entry.numFrames; ++frame)
+        {
+            while(nextKeyChange < entry.keyChanges.size() && entry.keyChanges[nextKeyChange].first <= frame)
+            {
+                core.setKeyState(entry.keyChanges[nextKeyChange++].second);
+            }
+
+            core.runFrame();
+        }
+
+        entry.frameHash = core.getFrameHash();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool update = false;
+    int numThreads = int(std::thread::hardware_concurrency());
+    int goldenArg = 1;
+
+    for(; goldenArg < argc - 1; ++goldenArg)
+    {
+        const std::string option = argv[goldenArg];
+
+        if(option == "--update")
+        {
+            update = true;
+        }
+        else if(option == "--threads" && goldenArg + 2 < argc)
+        {
+            numThreads = std::stoi(argv[++goldenArg]);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if(goldenArg != argc - 1)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--update] [--threads <count>] <golden file>" << std::endl;
+        return 1;
+    }
+
+    const std::string goldenPath = argv[goldenArg];
+    std::ifstream goldenStream(goldenPath);
+
+    if(!goldenStream)
+    {
+        std::cerr << "Couldn't open " << goldenPath << std::endl;
+        return 1;
+    }
+
+    const size_t lastSlash = goldenPath.find_last_of("/\\");
+    const std::string romDirectory = lastSlash == std::string::npos ? "" : goldenPath.substr(0, lastSlash + 1);
+
+    std::vector<std::string> lines;
+    std::vector<GoldenEntry> entries;
+
+    for(std::string line; std::getline(goldenStream, line);)
+    {
+        lines.push_back(line);
+
+        const size_t firstChar = line.find_first_not_of(" \t\r");
+
+        if(firstChar == std::string::npos || line[firstChar] == '#')
+        {
+            continue;
+        }
+
+        GoldenEntry entry;
+        entry.lineIndex = lines.size() - 1;
+
+        if(!parseEntry(line, entry))
+        {
+            std::cerr << goldenPath << ":" << lines.size() << ": can't read \"" << line << "\"" << std::endl;
+            return 1;
+        }
+
+        entries.push_back(std::move(entry));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    WorkStealingPool pool(numThreads);
+    pool.parallelFor(int(entries.size()), [&entries, &romDirectory](int index)
+    {
+        runEntry(entries[index], romDirectory);
+    });
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int numPassed = 0;
+    int numFailed = 0;
+    int numUnread = 0;
+    int numNew = 0;
+
+    for(GoldenEntry& entry : entries)
+    {
+        if(!entry.readRom)
+        {
+            std::cout << "UNREAD " << entry.romPath << std::endl;
+            ++numUnread;
+        }
+        else if(!entry.hasHash)
+        {
+            std::cout << "NEW    " << entry.romPath << " " << toHex(entry.frameHash) << std::endl;
+            ++numNew;
+        }
+        else if(entry.frameHash != entry.goldenHash)
+        {
+            std::cout << "FAIL   " << entry.romPath << " expected " << toHex(entry.goldenHash) << " got " << toHex(entry.frameHash) << std::endl;
+            ++numFailed;
+        }
+        else
+        {
+            ++numPassed;
+        }
+
+        //Keys and anything after them stay as they were
+        if(update && entry.readRom)
+        {
+            std::ostringstream line;
+            line << entry.romPath << " " << entry.profileName << " " << entry.numFrames << " " << entry.cyclesPerFrame << " " << toHex(entry.frameHash);
+
+            for(const auto& keyChange : entry.keyChanges)
+            {
+                line << " " << keyChange.first << ":" << std::hex << keyChange.second << std::dec;
+            }
+
+            lines[entry.lineIndex] = line.str();
+        }
+    }
+
+    std::cout << numPassed << " passed, " << numFailed << " failed, " << numNew << " new, " << numUnread << " unread. "
+              << entries.size() << " ROMs in " << std::fixed << std::setprecision(2) << seconds << "s, "
+              << std::setprecision(0) << entries.size() / std::max(seconds, 1e-9) << " per second" << std::endl;
+
+    if(update)
+    {
+        std::ofstream goldenOut(goldenPath);
+
+        for(const std::string& line : lines)
+        {
+            goldenOut << line << '\n';
+        }
+
+        if(!goldenOut)
+        {
+            std::cerr << "Couldn't write " << goldenPath << std::endl;
+            return 1;
+        }
+
+        return numUnread == 0 ? 0 : 1;
+    }
+
+    return numFailed == 0 && numUnread == 0 ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+/*
+  ==============================================================================
+
+    EnvironmentCheck.cpp
+    Created: 14 Jun 2022 8:12:37pm
+    Author:  Max Walley
+
+    Checks Chip8Environment and Chip8EnvironmentBatch on a built in ROM that
+    draws a random digit every frame and moves it unless key 0 is held.
+    Resetting with the same seed has to give the same observations and
+    rewards for the same keys, and a different seed different ones. Episodes
+    cut off by the frame limit have to end after the number of steps worked
+    out from the limit and frameskip, and the batch's automatic resets have
+    to carry on with the seeds it documents. Exits with 1 if any check fails.
+
+    Usage: EnvironmentCheck [--environments <count>] [--threads <count>] [--steps <count>]
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Environment.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const std::vector<uint8_t> builtInRom
+    {
+        0x60, 0x01,     //200: V0 = 1
+        0xF0, 0x15,     //202: delay = V0
+        0xF1, 0x07,     //204: V1 = delay
+        0x31, 0x00,     //206: skip if V1 == 0
+        0x12, 0x04,     //208: jump 204, so each pass waits for the next timer tick
+        0x72, 0x01,     //20A: V2 += 1
+        0xC3, 0x0F,     //20C: V3 = random digit
+        0xF3, 0x29,     //20E: I = font for V3
+        0xE5, 0x9E,     //210: skip if key V5 (0) is down
+        0x74, 0x04,     //212: V4 += 4
+        0x66, 0x00,     //214: V6 = 0
+        0xD4, 0x65,     //216: draw at V4, V6
+        0x12, 0x02      //218: jump 202
+    };
+
+    const uint32_t baseSeed = 7;
+
+    //Enough for a pass of the loop every frame, so every frame draws a random digit
+    const int cyclesPerFrame = 20;
+
+    struct Settings
+    {
+        int numEnvironments = 16;
+        int numThreads = 0;
+        int numSteps = 200;
+    };
+
+    int numFailed = 0;
+
+    void report(bool passed, const std::string& check)
+    {
+        std::cout << (passed ? "ok     " : "FAIL   ") << check << std::endl;
+
+        if(!passed)
+        {
+            ++numFailed;
+        }
+    }
+
+    uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+
+        for(size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3;
+        }
+
+        return hash;
+    }
+
+    const uint64_t emptyHash = 0xCBF29CE484222325;
+
+    //Key 0 some of the time, and different for each environment so they don't all run the same
+    uint16_t keysFor(int step, int environment)
+    {
+        return ((step + environment) % 3 == 0) ? 0x0001 : 0x0000;
+    }
+
+    int stepsPerEpisode(int maxEpisodeFrames, int frameskip)
+    {
+        return (maxEpisodeFrames + frameskip - 1) / frameskip;
+    }
+
+    //Folds every observation and reward of a run into one hash
+    uint64_t runEnvironment(Chip8Environment& environment, uint32_t seed, int numSteps)
+    {
+        uint64_t hash = hashBytes(emptyHash, environment.reset(seed).data(), sizeof(Chip8Core::Framebuffer));
+
+        for(int step = 0; step < numSteps; ++step)
+        {
+            const Chip8Environment::StepResult result = environment.step(keysFor(step, 0));
+            hash = hashBytes(hash, environment.getObservation().data(), sizeof(Chip8Core::Framebuffer));
+            hash = hashBytes(hash, &result.reward, sizeof(result.reward));
+        }
+
+        return hash;
+    }
+
+    //One hash per environment, of every observation and reward it gave
+    std::vector<uint64_t> runBatch(Chip8EnvironmentBatch& environments, int numSteps)
+    {
+        const int numEnvironments = environments.getNumEnvironments();
+        std::vector<uint64_t> hashes(numEnvironments, emptyHash);
+        std::vector<uint16_t> keys(numEnvironments);
+
+        for(int step = 0; step < numSteps; ++step)
+        {
+            for(int environment = 0; environment < numEnvironments; ++environment)
+            {
+                keys[environment] = keysFor(step, environment);
+            }
+
+            environments.step(keys.data());
+
+            for(int environment = 0; environment < numEnvironments; ++environment)
+            {
+                hashes[environment] = hashBytes(hashes[environment], environments.getObservation(environment), Chip8Batch::heightPixels * sizeof(uint64_t));
+                hashes[environment] = hashBytes(hashes[environment], environments.getRewards() + environment, sizeof(float));
+            }
+        }
+
+        return hashes;
+    }
+
+    float rewardFromCore(const Chip8Core& core)
+    {
+        return float(core.getRegister(4));
+    }
+
+    float rewardFromBatch(const Chip8Batch& batch, int environment)
+    {
+        return float(batch.getRegister(environment, 4));
+    }
+
+    void checkEnvironment(const Settings& settings)
+    {
+        Chip8Environment environment(builtInRom);
+        environment.setCyclesPerFrame(cyclesPerFrame);
+        environment.setRewardFunction(rewardFromCore);
+
+        const uint64_t firstRun = runEnvironment(environment, baseSeed, settings.numSteps);
+        report(runEnvironment(environment, baseSeed, settings.numSteps) == firstRun, "Chip8Environment: resetting with the same seed repeats the run");
+
+        Chip8Environment freshEnvironment(builtInRom);
+        freshEnvironment.setCyclesPerFrame(cyclesPerFrame);
+        freshEnvironment.setRewardFunction(rewardFromCore);
+        report(runEnvironment(freshEnvironment, baseSeed, settings.numSteps) == firstRun, "Chip8Environment: a new environment with the same seed repeats the run");
+
+        report(runEnvironment(environment, baseSeed + 1, settings.numSteps) != firstRun, "Chip8Environment: a different seed gives a different run");
+
+        //A limit that isn't a multiple of the frameskip still ends on the step that reaches it
+        const int limits[][2] {{10, 1}, {10, 3}, {9, 3}, {1, 4}};
+
+        for(const auto& limit : limits)
+        {
+            const int maxEpisodeFrames = limit[0];
+            const int frameskip = limit[1];
+
+            environment.setMaxEpisodeFrames(maxEpisodeFrames);
+            environment.reset(baseSeed);
+
+            //Gives up one step past the most it could take
+            int numSteps = 1;
+
+            while(!environment.step(0, frameskip).done && numSteps <= maxEpisodeFrames)
+            {
+                ++numSteps;
+            }
+
+            const int expectedSteps = stepsPerEpisode(maxEpisodeFrames, frameskip);
+            report(numSteps == expectedSteps && environment.getEpisodeFrame() == expectedSteps * frameskip,
+                   "Chip8Environment: a limit of " + std::to_string(maxEpisodeFrames) + " frames with frameskip " + std::to_string(frameskip)
+                   + " ends after " + std::to_string(expectedSteps) + " steps, took " + std::to_string(numSteps));
+        }
+    }
+
+    void checkBatch(const Settings& settings)
+    {
+        const int numEnvironments = settings.numEnvironments;
+
+        Chip8EnvironmentBatch environments(builtInRom, numEnvironments, settings.numThreads);
+        environments.setCyclesPerFrame(cyclesPerFrame);
+        environments.setRewardFunction(rewardFromBatch);
+
+        environments.reset(baseSeed);
+        const std::vector<uint64_t> firstRun = runBatch(environments, settings.numSteps);
+
+        environments.reset(baseSeed);
+        report(runBatch(environments, settings.numSteps) == firstRun, "Chip8EnvironmentBatch: resetting with the same seed repeats every environment's run");
+
+        //Environment n of reset(seed) is the same as reset(n, seed + n)
+        for(int environment = 0; environment < numEnvironments; ++environment)
+        {
+            environments.reset(environment, baseSeed + uint32_t(environment));
+        }
+
+        report(runBatch(environments, settings.numSteps) == firstRun, "Chip8EnvironmentBatch: resetting each environment on its own with seed + n repeats the run");
+
+        //Moves every environment on to a seed none of them had before, with the same keys
+        environments.reset(baseSeed + uint32_t(numEnvironments));
+        const std::vector<uint64_t> otherSeedRun = runBatch(environments, settings.numSteps);
+
+        bool allDiffer = true;
+
+        for(int environment = 0; environment < numEnvironments; ++environment)
+        {
+            allDiffer &= otherSeedRun[environment] != firstRun[environment];
+        }
+
+        report(allDiffer, "Chip8EnvironmentBatch: a different seed gives every environment a different run");
+
+        const int limits[][2] {{10, 1}, {10, 3}, {9, 3}, {1, 4}};
+
+        for(const auto& limit : limits)
+        {
+            const int maxEpisodeFrames = limit[0];
+            const int frameskip = limit[1];
+            const int episodeSteps = stepsPerEpisode(maxEpisodeFrames, frameskip);
+            const int numEpisodes = 3;
+            const int numSteps = numEpisodes * episodeSteps + 1;
+
+            //The extra step starts the next episode, and ends it too if episodes are one step long
+            const int expectedDones = numSteps / episodeSteps;
+
+            Chip8EnvironmentBatch autoReset(builtInRom, numEnvironments, settings.numThreads);
+            autoReset.setCyclesPerFrame(cyclesPerFrame);
+            autoReset.setMaxEpisodeFrames(maxEpisodeFrames);
+            autoReset.reset(baseSeed);
+
+            std::vector<uint16_t> keys(numEnvironments);
+            std::vector<int> numDones(numEnvironments, 0);
+
+            //Run whole episodes, then one step into the next. Each automatic reset should carry on with seed + n + k * count
+            for(int step = 0; step < numSteps; ++step)
+            {
+                for(int environment = 0; environment < numEnvironments; ++environment)
+                {
+                    keys[environment] = keysFor(step, environment);
+                }
+
+                autoReset.step(keys.data(), frameskip);
+
+                for(int environment = 0; environment < numEnvironments; ++environment)
+                {
+                    numDones[environment] += autoReset.getDones()[environment];
+                }
+            }
+
+            const std::string limitName = "a limit of " + std::to_string(maxEpisodeFrames) + " frames with frameskip " + std::to_string(frameskip);
+            report(numDones == std::vector<int>(numEnvironments, expectedDones),
+                   "Chip8EnvironmentBatch: " + limitName + " ends " + std::to_string(expectedDones) + " episodes in " + std::to_string(numSteps) + " steps");
+
+            Chip8EnvironmentBatch explicitReset(builtInRom, numEnvironments, settings.numThreads);
+            explicitReset.setCyclesPerFrame(cyclesPerFrame);
+
+            for(int environment = 0; environment < numEnvironments; ++environment)
+            {
+                explicitReset.reset(environment, baseSeed + uint32_t(environment + numEpisodes * numEnvironments));
+            }
+
+            explicitReset.step(keys.data(), frameskip);
+
+            bool matched = true;
+
+            for(int environment = 0; environment < numEnvironments; ++environment)
+            {
+                for(int registerIndex = 0; registerIndex < 16; ++registerIndex)
+                {
+                    matched &= autoReset.getBatch().getRegister(environment, registerIndex) == explicitReset.getBatch().getRegister(environment, registerIndex);
+                }
+
+                for(int row = 0; row < Chip8Batch::heightPixels; ++row)
+                {
+                    matched &= autoReset.getObservation(environment)[row] == explicitReset.getObservation(environment)[row];
+                }
+            }
+
+            report(matched, "Chip8EnvironmentBatch: " + limitName + " resets with the same seeds as resetting by hand");
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+
+    for(int arg = 1; arg < argc; ++arg)
+    {
+        const std::string option = argv[arg];
+
+        if(option == "--environments" && arg + 1 < argc)
+        {
+            settings.numEnvironments = std::max(1, std::stoi(argv[++arg]));
+        }
+        else if(option == "--threads" && arg + 1 < argc)
+        {
+            settings.numThreads = std::stoi(argv[++arg]);
+        }
+        else if(option == "--steps" && arg + 1 < argc)
+        {
+            settings.numSteps = std::max(1, std::stoi(argv[++arg]));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--environments <count>] [--threads <count>] [--steps <count>]" << std::endl;
+            return 1;
+        }
+    }
+
+    checkEnvironment(settings);
+    checkBatch(settings);
+
+    std::cout << numFailed << " failed" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
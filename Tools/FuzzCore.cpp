@@ -0,0 +1,250 @@
+/*
+  ==============================================================================
+
+    FuzzCore.cpp
+    Created: 18 Jun 2022 3:26:09pm
+    Author:  Max Walley
+
+    libFuzzer entry point for the headless core. The first byte picks the
+    profile, the rest is loaded as the ROM and run for a bounded number of
+    cycles. CHIP-8 runs are stepped in lockstep with the reference chip8
+    class and any divergence aborts, so libFuzzer saves it like a crash.
+
+    Build with clang -fsanitize=fuzzer,address, or with -DFUZZ_STANDALONE
+    to get a main() that replays the files given on the command line.
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Core.h"
+#include "../Source/RomAnalyser.h"
+#include "../Source/chip8.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+    constexpr int maxCycles = 4096;
+
+    //The core also has the hi-res font at 0x50, ten bytes for each of the sixteen digits, which the reference leaves empty
+    constexpr int hiResFontEnd = Chip8Core::hiResFontStart + 16 * 10;
+
+    bool overlapsHiResFont(int start, int length)
+    {
+        return start < hiResFontEnd && start + length > Chip8Core::hiResFontStart;
+    }
+
+    //The reference differs by design on some opcodes, and indexes out of bounds on others.
+    //Comparison stops at the first of them, as the two machines can legitimately differ from there on
+    bool referenceCanRun(const chip8& reference)
+    {
+        const int pc = reference.getPC();
+
+        //Running the font would fetch different opcodes
+        if(pc + 1 >= 4096 || overlapsHiResFont(pc, 2))
+        {
+            return false;
+        }
+
+        const uint16_t opcode = uint16_t((reference.getMemory(pc) << 8) | reference.getMemory(pc + 1));
+        const int x = (0x0F00 & opcode) >> 8;
+        const int y = (0x00F0 & opcode) >> 4;
+        const int n = 0x000F & opcode;
+        const int nn = 0x00FF & opcode;
+        const int index = reference.getI();
+
+        switch(0xF000 & opcode)
+        {
+            case 0x0000:
+            {
+                //The reference only looks at the last digit
+                return opcode == 0x00E0 || (opcode == 0x00EE && reference.getSP() > 0);
+            }
+
+            case 0x2000:
+            {
+                return reference.getSP() < 16;
+            }
+
+            case 0x8000:
+            {
+                //The reference writes VF before the result, so the ops that set it come out differently with VF as X or Y
+                const bool setsFlag = n >= 0x4;
+                return (n <= 0x7 || n == 0xE) && !(setsFlag && (x == 0xF || y == 0xF));
+            }
+
+            case 0xC000:
+            {
+                //Different random sources
+                return false;
+            }
+
+            case 0xD000:
+            {
+                //The reference doesn't wrap or clip sprites, and would draw the hi-res font as blank rows
+                return reference.getV(x) + 8 <= 64 && reference.getV(y) + n <= 32 && index + n <= 4096 && !overlapsHiResFont(index, n);
+            }
+
+            case 0xE000:
+            {
+                //No keys are ever down, so only the key index needs checking
+                return (nn == 0x9E || nn == 0xA1) && reference.getV(x) < 16;
+            }
+
+            case 0xF000:
+            {
+                //FX1E sets VF, FX55 and FX65 move I, FX0A polls instead of waiting
+                switch(nn)
+                {
+                    case 0x07:
+                    case 0x15:
+                    case 0x18:
+                    case 0x29:
+                        return true;
+
+                    case 0x33:
+                        return index + 2 < 4096;
+
+                    default:
+                        return false;
+                }
+            }
+
+            default:
+            {
+                return true;
+            }
+        }
+    }
+
+    void reportDivergence(const char* what, int cycle, int expected, int actual)
+    {
+        std::cerr << "Divergence from reference in " << what << " after cycle " << cycle
+                  << ": expected 0x" << std::hex << expected << ", got 0x" << actual << std::dec << std::endl;
+        std::abort();
+    }
+
+    void compareRegisters(const Chip8Core& core, const chip8& reference, int cycle)
+    {
+        if(core.getProgramCounter() != reference.getPC())
+        {
+            reportDivergence("PC", cycle, reference.getPC(), core.getProgramCounter());
+        }
+
+        if(core.getIndexRegister() != reference.getI())
+        {
+            reportDivergence("I", cycle, reference.getI(), core.getIndexRegister());
+        }
+
+        for(int registerIndex = 0; registerIndex < 16; ++registerIndex)
+        {
+            if(core.getRegister(registerIndex) != reference.getV(registerIndex))
+            {
+                reportDivergence("V register", cycle, reference.getV(registerIndex), core.getRegister(registerIndex));
+            }
+        }
+    }
+
+    void compareMemoryAndDisplay(const Chip8Core& core, const chip8& reference, int cycle)
+    {
+        for(int address = 0; address < 4096; ++address)
+        {
+            if(!overlapsHiResFont(address, 1) && core.getMemory()[address] != reference.getMemory(address))
+            {
+                reportDivergence("memory", cycle, reference.getMemory(address), core.getMemory()[address]);
+            }
+        }
+
+        for(int y = 0; y < Chip8Core::loResHeightPixels; ++y)
+        {
+            for(int x = 0; x < Chip8Core::loResWidthPixels; ++x)
+            {
+                if(core.getPixel(x, y) != (reference.gfx[y * 64 + x] != 0))
+                {
+                    reportDivergence("display", cycle, reference.gfx[y * 64 + x], core.getPixel(x, y));
+                }
+            }
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if(size < 1)
+    {
+        return 0;
+    }
+
+    const Chip8Profile profile = Chip8Profile(data[0] % 3);
+    const uint8_t* program = data + 1;
+    const size_t programSize = size - 1;
+
+    RomAnalyser::analyseProgram(program, programSize, profile);
+
+    Chip8Core core;
+    core.setProfile(profile);
+    core.setSeed(0);
+    core.load(program, programSize);
+
+    //The reference ticks its timers every instruction
+    core.setCyclesPerFrame(1);
+
+    if(profile != Chip8Profile::chip8)
+    {
+        for(int cycle = 0; cycle < maxCycles && !core.isHalted(); ++cycle)
+        {
+            core.runCycle();
+        }
+
+        return 0;
+    }
+
+    static chip8 reference;
+    reference.loadProgram(program, int(std::min(programSize, size_t(4096))));
+
+    int cycle = 0;
+
+    for(; cycle < maxCycles; ++cycle)
+    {
+        if(!referenceCanRun(reference))
+        {
+            break;
+        }
+
+        core.runCycle();
+        reference.emulateCycle();
+
+        compareRegisters(core, reference, cycle);
+    }
+
+    compareMemoryAndDisplay(core, reference, cycle);
+
+    //Keep going on the core alone, it should survive anything
+    for(; cycle < maxCycles; ++cycle)
+    {
+        core.runCycle();
+    }
+
+    return 0;
+}
+
+#if defined(FUZZ_STANDALONE)
+int main(int argc, char* argv[])
+{
+    for(int arg = 1; arg < argc; ++arg)
+    {
+        std::ifstream fileStream(argv[arg], std::ios::binary);
+        const std::vector<uint8_t> input {std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>()};
+
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        std::cout << argv[arg] << ": ok" << std::endl;
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,212 @@
+/*
+  ==============================================================================
+
+    FuzzDriver.cpp
+    Created: 18 Jun 2022 5:48:31pm
+    Author:  Max Walley
+
+    Runs a libFuzzer binary on every core against one shared corpus
+    directory. A worker that finds a crash or divergence is restarted until
+    the time is up, then every new artifact is minimised alongside the
+    original. POSIX only.
+
+    Usage: FuzzDriver <fuzzer> <corpusDir> <artifactDir> [seconds] [jobs]
+
+  ==============================================================================
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    //Starts the fuzzer with its output going to logPath, returns the child's pid or -1
+    pid_t launch(const std::vector<std::string>& arguments, const std::string& logPath)
+    {
+        const pid_t pid = fork();
+
+        if(pid != 0)
+        {
+            return pid;
+        }
+
+        const int logFile = open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+        if(logFile >= 0)
+        {
+            dup2(logFile, STDOUT_FILENO);
+            dup2(logFile, STDERR_FILENO);
+            close(logFile);
+        }
+
+        std::vector<char*> argv;
+
+        for(const auto& argument : arguments)
+        {
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        }
+
+        argv.push_back(nullptr);
+
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    std::set<std::string> listArtifacts(const fs::path& artifactDir)
+    {
+        std::set<std::string> artifacts;
+
+        for(const auto& entry : fs::directory_iterator(artifactDir))
+        {
+            const std::string name = entry.path().filename().string();
+
+            //crash-, leak-, timeout- and oom- are what libFuzzer writes
+            const bool isArtifact = name.rfind("crash-", 0) == 0 || name.rfind("leak-", 0) == 0
+                                 || name.rfind("timeout-", 0) == 0 || name.rfind("oom-", 0) == 0;
+
+            if(isArtifact)
+            {
+                artifacts.insert(name);
+            }
+        }
+
+        return artifacts;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <fuzzer> <corpusDir> <artifactDir> [seconds] [jobs]" << std::endl;
+        return 1;
+    }
+
+    const std::string fuzzer = fs::absolute(argv[1]).string();
+    const fs::path corpusDir = argv[2];
+    const fs::path artifactDir = argv[3];
+    const int seconds = argc > 4 ? std::max(std::stoi(argv[4]), 1) : 600;
+    const int jobs = argc > 5 ? std::max(std::stoi(argv[5]), 1) : int(std::max(std::thread::hardware_concurrency(), 1u));
+
+    fs::create_directories(corpusDir);
+    fs::create_directories(artifactDir);
+
+    const std::set<std::string> existingArtifacts = listArtifacts(artifactDir);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    std::map<pid_t, int> workers;
+    int restarts = 0;
+
+    auto startWorker = [&](int worker)
+    {
+        const auto remaining = std::chrono::duration_cast<std::chrono::seconds>(deadline - std::chrono::steady_clock::now()).count();
+
+        if(remaining <= 0)
+        {
+            return;
+        }
+
+        //Each run gets its own seed, -reload picks up what the other workers add to the corpus
+        const std::vector<std::string> arguments {
+            fuzzer,
+            corpusDir.string(),
+            "-artifact_prefix=" + (artifactDir / "").string(),
+            "-seed=" + std::to_string(1 + worker + jobs * restarts),
+            "-max_total_time=" + std::to_string(remaining),
+            "-reload=1",
+            "-close_fd_mask=1"
+        };
+
+        const pid_t pid = launch(arguments, (artifactDir / ("worker-" + std::to_string(worker) + ".log")).string());
+
+        if(pid > 0)
+        {
+            workers[pid] = worker;
+        }
+    };
+
+    for(int worker = 0; worker < jobs; ++worker)
+    {
+        startWorker(worker);
+    }
+
+    std::cout << "Fuzzing with " << jobs << " workers for " << seconds << "s" << std::endl;
+
+    while(!workers.empty())
+    {
+        int status = 0;
+        const pid_t pid = wait(&status);
+
+        if(pid < 0)
+        {
+            break;
+        }
+
+        const auto worker = workers.find(pid);
+
+        if(worker == workers.end())
+        {
+            continue;
+        }
+
+        const int workerIndex = worker->second;
+        workers.erase(worker);
+
+        //libFuzzer stops at the first crash, so put the worker straight back to work
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ++restarts;
+            startWorker(workerIndex);
+        }
+    }
+
+    int numFound = 0;
+
+    for(const auto& name : listArtifacts(artifactDir))
+    {
+        if(existingArtifacts.count(name) != 0)
+        {
+            continue;
+        }
+
+        ++numFound;
+
+        const fs::path artifact = artifactDir / name;
+        const fs::path minimised = artifactDir / ("minimised-" + name);
+
+        const std::vector<std::string> arguments {
+            fuzzer,
+            "-minimize_crash=1",
+            "-runs=20000",
+            "-exact_artifact_path=" + minimised.string(),
+            artifact.string()
+        };
+
+        const pid_t pid = launch(arguments, (artifactDir / ("minimise-" + name + ".log")).string());
+        int status = 0;
+
+        if(pid > 0)
+        {
+            waitpid(pid, &status, 0);
+        }
+
+        std::cout << artifact.string() << (fs::exists(minimised) ? " -> " + minimised.string() : " (couldn't minimise)") << std::endl;
+    }
+
+    std::cout << numFound << " new artifacts, corpus has " << std::distance(fs::directory_iterator(corpusDir), fs::directory_iterator()) << " inputs" << std::endl;
+
+    return numFound == 0 ? 0 : 1;
+}
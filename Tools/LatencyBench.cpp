@@ -0,0 +1,397 @@
+/*
+  ==============================================================================
+
+    LatencyBench.cpp
+    Created: 3 Aug 2022 8:20:44pm
+    Author:  Max Walley
+
+    Measures input to frame latency without a keyboard or display. Presses a
+    key at random times between 60Hz ticks and times how long it takes to
+    reach a frame handed to the renderer, under the emulator's timer (with
+    and without run-ahead) and turbo scheduling. A change is only put down to
+    the key if a fork of the machine that never saw it doesn't make it too.
+    With no ROMs given, three built in ones cover EX9E/EXA1 polling, polling
+    once every few frames and FX0A.
+
+    Usage: LatencyBench [--schip | --xo] [--events <count>] [--rates <hz,...>]
+                        [--ahead <frames,...>] [--key <0-F>] [--seed <seed>] [rom...]
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Core.h"
+#include "../Source/Chip8RunAhead.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //As Chip8Emulator schedules things
+    constexpr int timerRateHz = 60;
+    constexpr double tickMs = 1000.0 / timerRateHz;
+    constexpr int turboFramesPerCheck = 64;
+    constexpr double publishMs = tickMs / 2.0;
+
+    //A quick tap, and how long a ROM gets to show it before the press counts as missed
+    constexpr int keyHoldTicks = 6;
+    constexpr int maxTicksToReact = 120;
+    constexpr int maxTurboBatches = 256;
+
+    //Enough frames of warm up to land anywhere in a ROM's polling cycle
+    constexpr int minWarmUpFrames = 30;
+    constexpr int maxWarmUpFrames = 90;
+
+    struct BenchRom
+    {
+        std::string name;
+        std::vector<uint8_t> program;
+        Chip8Profile profile;
+    };
+
+    //Each waits on key 5 and draws somewhere new when it sees it
+    std::vector<BenchRom> getBuiltInRoms()
+    {
+        return
+        {
+            //Spins on EX9E, draws, spins on EXA1 until it's let go and rubs it out
+            {"poll", {0x60, 0x05, 0xA2, 0x12, 0xE0, 0x9E, 0x12, 0x04, 0xD1, 0x25, 0xE0, 0xA1, 0x12, 0x0A, 0xD1, 0x25,
+                      0x12, 0x04, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0}, Chip8Profile::chip8},
+
+            //Only looks at the keys when the delay timer runs out, every 4 frames like most games' main loops,
+            //then draws one place along and waits for the key to go up
+            {"lagged", {0x60, 0x05, 0xA2, 0x1C, 0x63, 0x04, 0xF3, 0x15, 0xF4, 0x07, 0x34, 0x00, 0x12, 0x08, 0xE0, 0x9E,
+                        0x12, 0x04, 0x71, 0x08, 0xD1, 0x25, 0xE0, 0xA1, 0x12, 0x16, 0x12, 0x04, 0xF0, 0xF0, 0xF0, 0xF0,
+                        0xF0}, Chip8Profile::chip8},
+
+            //Waits in FX0A, then clears the screen and draws the key's digit one place along
+            {"wait", {0xF1, 0x0A, 0x00, 0xE0, 0xF1, 0x29, 0x72, 0x08, 0xD2, 0x35, 0x12, 0x00}, Chip8Profile::chip8}
+        };
+    }
+
+    std::vector<int> parseList(const std::string& list)
+    {
+        std::vector<int> values;
+        std::stringstream stream(list);
+        std::string value;
+
+        while(std::getline(stream, value, ','))
+        {
+            values.push_back(std::stoi(value));
+        }
+
+        return values;
+    }
+
+    bool framebuffersDiffer(const Chip8Core& a, const Chip8Core& b)
+    {
+        return a.getFramebuffer() != b.getFramebuffer() || a.isHiRes() != b.isHiRes();
+    }
+
+    //Nearest rank
+    double percentile(const std::vector<double>& sorted, double fraction)
+    {
+        const size_t rank = size_t(std::ceil(fraction * sorted.size()));
+        return sorted[std::max<size_t>(rank, 1) - 1];
+    }
+
+    class LatencyBench
+    {
+    public:
+        LatencyBench(const BenchRom& rom, int rateHz, int key, uint32_t randomSeed)
+            : keyBit(uint16_t(1 << key)), seed(randomSeed)
+        {
+            for(Chip8Core* core : {&pressed, &control})
+            {
+                core->setProfile(rom.profile);
+                core->setCyclesPerFrame(std::max(int(std::lround(rateHz / double(timerRateHz))), 1));
+                core->setSeed(seed);
+            }
+
+            pressed.load(rom.program.data(), rom.program.size());
+        }
+
+        //Milliseconds from each press to the first frame shown that it changed, -1 where nothing changed in time
+        std::vector<double> runTimer(int numEvents, int framesAhead)
+        {
+            pressedAhead.setFramesAhead(framesAhead);
+            controlAhead.setFramesAhead(framesAhead);
+
+            //Every mode gets the same presses
+            random.seed(seed);
+            std::vector<double> latencies;
+
+            for(int event = 0; event < numEvents; ++event)
+            {
+                //The press lands somewhere between the last tick and the next, which is the first to see it
+                const double eventMs = startEvent();
+                latencies.push_back(-1.0);
+
+                for(int tick = 1; tick <= maxTicksToReact; ++tick)
+                {
+                    pressed.setKeyState(tick <= keyHoldTicks ? keyBit : 0);
+                    pressed.runFrame();
+                    control.runFrame();
+
+                    const Chip8Core* shownPressed = &pressed;
+                    const Chip8Core* shownControl = &control;
+
+                    if(framesAhead > 0)
+                    {
+                        pressedAhead.update(pressed);
+                        controlAhead.update(control);
+                        shownPressed = &pressedAhead.getCore();
+                        shownControl = &controlAhead.getCore();
+                    }
+
+                    if(framebuffersDiffer(*shownPressed, *shownControl))
+                    {
+                        latencies.back() = tick * tickMs - eventMs;
+                        break;
+                    }
+                }
+            }
+
+            return latencies;
+        }
+
+        //The turbo thread runs batches of frames as fast as it can, picking up keys between them and publishing
+        //to the next tick every half tick. Only the batches after the press are run, the rest of the timeline
+        //follows from how long a frame of this ROM takes here
+        std::vector<double> runTurbo(int numEvents)
+        {
+            const double batchMs = turboFramesPerCheck * measureFrameMs();
+            const int batchesPerPublish = std::max(int(std::ceil(publishMs / batchMs)), 1);
+
+            std::uniform_real_distribution<double> phase(0.0, 1.0);
+            std::uniform_int_distribution<int> publishPhase(0, batchesPerPublish - 1);
+
+            random.seed(seed);
+            std::vector<double> latencies;
+
+            for(int event = 0; event < numEvents; ++event)
+            {
+                const double eventMs = startEvent();
+                const double firstBatchMs = eventMs + phase(random) * batchMs;
+                const int firstPublish = publishPhase(random);
+
+                latencies.push_back(-1.0);
+
+                for(int batch = 0; batch < maxTurboBatches; ++batch)
+                {
+                    const double batchStartMs = firstBatchMs + batch * batchMs;
+
+                    if(batchStartMs > eventMs + maxTicksToReact * tickMs)
+                    {
+                        break;
+                    }
+
+                    pressed.setKeyState(batchStartMs < eventMs + keyHoldTicks * tickMs ? keyBit : 0);
+
+                    for(int frame = 0; frame < turboFramesPerCheck; ++frame)
+                    {
+                        pressed.runFrame();
+                        control.runFrame();
+                    }
+
+                    if(framebuffersDiffer(pressed, control))
+                    {
+                        const int publishBatch = batch + (batchesPerPublish - (batch + firstPublish) % batchesPerPublish) % batchesPerPublish;
+                        const double publishedMs = firstBatchMs + (publishBatch + 1) * batchMs;
+
+                        latencies.back() = std::ceil(publishedMs / tickMs) * tickMs - eventMs;
+                        break;
+                    }
+                }
+            }
+
+            return latencies;
+        }
+
+    private:
+        //Takes the machine somewhere into its run with no keys down, forks the control from it and
+        //returns when the press comes, after the tick just run
+        double startEvent()
+        {
+            std::uniform_int_distribution<int> warmUpFrames(minWarmUpFrames, maxWarmUpFrames);
+            std::uniform_real_distribution<double> eventPhase(0.0, tickMs);
+
+            pressed.reset();
+            pressed.setKeyState(0);
+
+            for(int frame = warmUpFrames(random); frame > 0; --frame)
+            {
+                pressed.runFrame();
+            }
+
+            control.restore(pressed.fork());
+
+            return eventPhase(random);
+        }
+
+        //Wall time of a frame spent waiting for a key, which is what the turbo thread is doing when one comes
+        double measureFrameMs()
+        {
+            using Clock = std::chrono::steady_clock;
+
+            pressed.reset();
+            pressed.setKeyState(0);
+
+            const auto start = Clock::now();
+            int numFrames = 0;
+
+            while(Clock::now() - start < std::chrono::milliseconds(50))
+            {
+                for(int frame = 0; frame < turboFramesPerCheck; ++frame)
+                {
+                    pressed.runFrame();
+                }
+
+                numFrames += turboFramesPerCheck;
+            }
+
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / numFrames;
+        }
+
+        Chip8Core pressed;
+        Chip8Core control;
+        Chip8RunAhead pressedAhead;
+        Chip8RunAhead controlAhead;
+
+        const uint16_t keyBit;
+        const uint32_t seed;
+        std::mt19937 random;
+    };
+
+    void printRow(const std::string& rom, int rateHz, const std::string& mode, std::vector<double> latencies)
+    {
+        const size_t numEvents = latencies.size();
+        latencies.erase(std::remove(latencies.begin(), latencies.end(), -1.0), latencies.end());
+        std::sort(latencies.begin(), latencies.end());
+
+        std::cout << std::left << std::setw(16) << rom << std::right << std::setw(6) << rateHz << "  " << std::left << std::setw(9) << mode << std::right;
+
+        if(latencies.empty())
+        {
+            std::cout << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(9) << "-";
+        }
+        else
+        {
+            double total = 0.0;
+
+            for(const double latency : latencies)
+            {
+                total += latency;
+            }
+
+            std::cout << std::fixed << std::setprecision(1) << std::setw(9) << percentile(latencies, 0.5) << std::setw(9) << percentile(latencies, 0.99)
+                      << std::setw(9) << total / latencies.size();
+        }
+
+        std::cout << std::setw(8) << numEvents - latencies.size() << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Chip8Profile profile = Chip8Profile::chip8;
+    int numEvents = 1000;
+    std::vector<int> rates {300, 1000};
+    std::vector<int> framesAhead {0, 1, 2};
+    int key = 5;
+    uint32_t seed = 1;
+    std::vector<BenchRom> roms;
+
+    const std::string usage = std::string("Usage: ") + argv[0]
+                              + " [--schip | --xo] [--events <count>] [--rates <hz,...>] [--ahead <frames,...>] [--key <0-F>] [--seed <seed>] [rom...]";
+
+    for(int arg = 1; arg < argc; ++arg)
+    {
+        const std::string option = argv[arg];
+        const bool hasValue = arg + 1 < argc;
+
+        if(option == "--schip")
+        {
+            profile = Chip8Profile::superChip;
+        }
+        else if(option == "--xo")
+        {
+            profile = Chip8Profile::xoChip;
+        }
+        else if(option == "--events" && hasValue)
+        {
+            numEvents = std::max(std::stoi(argv[++arg]), 1);
+        }
+        else if(option == "--rates" && hasValue)
+        {
+            rates = parseList(argv[++arg]);
+        }
+        else if(option == "--ahead" && hasValue)
+        {
+            framesAhead = parseList(argv[++arg]);
+        }
+        else if(option == "--key" && hasValue)
+        {
+            key = std::stoi(argv[++arg], nullptr, 16) & 0xF;
+        }
+        else if(option == "--seed" && hasValue)
+        {
+            seed = uint32_t(std::stoul(argv[++arg]));
+        }
+        else if(option.rfind("--", 0) == 0)
+        {
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+        else
+        {
+            std::ifstream romStream(option, std::ios::binary);
+
+            if(!romStream)
+            {
+                std::cerr << "Couldn't open " << option << std::endl;
+                return 1;
+            }
+
+            roms.push_back({option.substr(option.find_last_of("/\\") + 1), std::vector<uint8_t>(std::istreambuf_iterator<char>(romStream), {}), profile});
+        }
+    }
+
+    //The built in ROMs all wait on key 5
+    if(roms.empty())
+    {
+        roms = getBuiltInRoms();
+        key = 5;
+    }
+
+    std::cout << numEvents << " presses of key " << std::hex << std::uppercase << key << std::dec << " each, held for " << keyHoldTicks
+              << " ticks. Latency in ms to the frame handed to the renderer" << std::endl << std::endl;
+
+    std::cout << std::left << std::setw(16) << "ROM" << std::right << std::setw(6) << "Hz" << "  " << std::left << std::setw(9) << "Mode" << std::right
+              << std::setw(9) << "p50" << std::setw(9) << "p99" << std::setw(9) << "mean" << std::setw(8) << "missed" << std::endl;
+
+    for(const BenchRom& rom : roms)
+    {
+        for(const int rateHz : rates)
+        {
+            LatencyBench bench(rom, rateHz, key, seed);
+
+            for(const int frames : framesAhead)
+            {
+                printRow(rom.name, rateHz, frames > 0 ? "ahead " + std::to_string(frames) : "timer", bench.runTimer(numEvents, frames));
+            }
+
+            printRow(rom.name, rateHz, "turbo", bench.runTurbo(numEvents));
+        }
+    }
+
+    return 0;
+}
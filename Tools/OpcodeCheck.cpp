@@ -0,0 +1,354 @@
+/*
+  ==============================================================================
+
+    OpcodeCheck.cpp
+    Created: 2 Sep 2022 7:40:12pm
+    Author:  Max Walley
+
+    Runs short hand written programs and checks the registers, memory and
+    pixels they leave against values worked out by hand, so the flag and
+    quirk behaviour is pinned by something other than the core's own
+    output. chip8 cases are run on a Chip8Batch as well. Exits with 1 if
+    any check fails.
+
+    Each line of the case file is
+        <name> <chip8 | schip | xo> <opcode>... : <check>...
+    Opcodes are 4 hex digits, loaded from 0x200 with a jump to itself added
+    on the end. A check is one of V<x>=<hh>, I=<hhhh>, PC=<hhhh>,
+    M<hhhh>=<hh> or P<x>,<y>=<0 | 1>, in hex apart from the pixel
+    coordinates. Lines starting with # are comments.
+
+    Usage: OpcodeCheck <case file>
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Batch.h"
+#include "../Source/Chip8Core.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //Enough for every case to reach its closing jump, and under a frame so the timers never tick
+    const int numCycles = 500;
+    const int cyclesPerFrame = 1000;
+
+    struct Check
+    {
+        enum Kind {vRegister, indexRegister, programCounter, memory, pixel};
+
+        std::string text;
+        Kind kind = vRegister;
+        int first = 0;
+        int second = 0;
+        int expected = 0;
+    };
+
+    struct Case
+    {
+        std::string name;
+        Chip8Profile profile = Chip8Profile::chip8;
+        std::vector<uint8_t> program;
+        std::vector<Check> checks;
+    };
+
+    bool parseProfile(const std::string& name, Chip8Profile& profile)
+    {
+        if(name == "chip8")
+        {
+            profile = Chip8Profile::chip8;
+        }
+        else if(name == "schip")
+        {
+            profile = Chip8Profile::superChip;
+        }
+        else if(name == "xo")
+        {
+            profile = Chip8Profile::xoChip;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool parseHex(const std::string& text, int maxDigits, int& value)
+    {
+        if(text.empty() || int(text.size()) > maxDigits || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+        {
+            return false;
+        }
+
+        value = std::stoi(text, nullptr, 16);
+        return true;
+    }
+
+    bool parseCheck(const std::string& text, Check& check)
+    {
+        const size_t equals = text.find('=');
+
+        if(equals == std::string::npos || equals == 0)
+        {
+            return false;
+        }
+
+        const std::string target = text.substr(0, equals);
+        const std::string value = text.substr(equals + 1);
+        check.text = text;
+
+        if(target == "I" || target == "PC")
+        {
+            check.kind = target == "I" ? Check::indexRegister : Check::programCounter;
+            return parseHex(value, 4, check.expected);
+        }
+
+        switch(target[0])
+        {
+            case 'V':
+            {
+                check.kind = Check::vRegister;
+                return parseHex(target.substr(1), 1, check.first) && parseHex(value, 2, check.expected);
+            }
+
+            case 'M':
+            {
+                check.kind = Check::memory;
+                return parseHex(target.substr(1), 4, check.first) && parseHex(value, 2, check.expected);
+            }
+
+            case 'P':
+            {
+                const size_t comma = target.find(',');
+
+                if(comma == std::string::npos || (value != "0" && value != "1"))
+                {
+                    return false;
+                }
+
+                check.kind = Check::pixel;
+                check.first = std::stoi(target.substr(1, comma - 1));
+                check.second = std::stoi(target.substr(comma + 1));
+                check.expected = value == "1";
+                return true;
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    bool parseCase(const std::string& line, Case& testCase)
+    {
+        std::istringstream fields(line);
+        std::string profileName;
+
+        if(!(fields >> testCase.name >> profileName) || !parseProfile(profileName, testCase.profile))
+        {
+            return false;
+        }
+
+        std::string field;
+        bool readChecks = false;
+
+        while(fields >> field)
+        {
+            if(field == ":")
+            {
+                readChecks = true;
+                continue;
+            }
+
+            if(readChecks)
+            {
+                Check check;
+
+                if(!parseCheck(field, check))
+                {
+                    return false;
+                }
+
+                testCase.checks.push_back(check);
+                continue;
+            }
+
+            int opcode = 0;
+
+            if(field.size() != 4 || !parseHex(field, 4, opcode))
+            {
+                return false;
+            }
+
+            testCase.program.push_back(uint8_t(opcode >> 8));
+            testCase.program.push_back(uint8_t(opcode));
+        }
+
+        if(!readChecks || testCase.program.empty() || testCase.checks.empty())
+        {
+            return false;
+        }
+
+        //Park on a jump to itself, so the checks see the state the last opcode left
+        const uint16_t endAddress = uint16_t(Chip8Core::programStart + testCase.program.size());
+        testCase.program.push_back(uint8_t(0x10 | (endAddress >> 8)));
+        testCase.program.push_back(uint8_t(endAddress));
+
+        return true;
+    }
+
+    //Reads the value a check is on from either machine, so both go through the same comparison
+    template <typename ReadRegister, typename ReadMemory, typename ReadPixel>
+    int readActual(const Check& check, uint16_t indexRegister, uint16_t programCounter,
+                   const ReadRegister& readRegister, const ReadMemory& readMemory, const ReadPixel& readPixel)
+    {
+        switch(check.kind)
+        {
+            case Check::vRegister:      return readRegister(check.first);
+            case Check::indexRegister:  return indexRegister;
+            case Check::programCounter: return programCounter;
+            case Check::memory:         return readMemory(check.first);
+            default:                    return readPixel(check.first, check.second);
+        }
+    }
+
+    int reportFailures(const Case& testCase, const std::string& machineName, const std::vector<int>& actualValues)
+    {
+        int numFailed = 0;
+
+        for(size_t index = 0; index < testCase.checks.size(); ++index)
+        {
+            const Check& check = testCase.checks[index];
+
+            if(actualValues[index] != check.expected)
+            {
+                std::cout << "FAIL   " << testCase.name << " on " << machineName << ": expected " << check.text
+                          << " got " << std::hex << actualValues[index] << std::dec << std::endl;
+                ++numFailed;
+            }
+        }
+
+        return numFailed;
+    }
+
+    int runOnCore(const Case& testCase)
+    {
+        Chip8Core core;
+        core.setProfile(testCase.profile);
+        core.setCyclesPerFrame(cyclesPerFrame);
+        core.load(testCase.program.data(), testCase.program.size());
+
+        for(int cycle = 0; cycle < numCycles; ++cycle)
+        {
+            core.runCycle();
+        }
+
+        std::vector<int> actualValues;
+
+        for(const Check& check : testCase.checks)
+        {
+            actualValues.push_back(readActual(check, core.getIndexRegister(), core.getProgramCounter(),
+                                              [&core](int registerIndex) {return int(core.getRegister(registerIndex));},
+                                              [&core](int address) {return address < int(core.getMemory().size()) ? int(core.getMemory()[address]) : -1;},
+                                              [&core](int x, int y) {return int(core.getPixel(x, y));}));
+        }
+
+        return reportFailures(testCase, "core", actualValues);
+    }
+
+    int runOnBatch(const Case& testCase)
+    {
+        Chip8Batch batch(1, 1);
+        batch.setCyclesPerFrame(cyclesPerFrame);
+        batch.load(testCase.program.data(), testCase.program.size());
+        batch.runCycles(numCycles);
+
+        std::vector<int> actualValues;
+
+        for(const Check& check : testCase.checks)
+        {
+            actualValues.push_back(readActual(check, batch.getIndexRegister(0), batch.getProgramCounter(0),
+                                              [&batch](int registerIndex) {return int(batch.getRegister(0, registerIndex));},
+                                              [&batch](int address) {return address < int(Chip8Batch::memorySize) ? int(batch.getMemory(0)[address]) : -1;},
+                                              [&batch](int x, int y) {return int(batch.getPixel(0, x, y));}));
+        }
+
+        return reportFailures(testCase, "batch", actualValues);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <case file>" << std::endl;
+        return 1;
+    }
+
+    const std::string casePath = argv[1];
+    std::ifstream caseStream(casePath);
+
+    if(!caseStream)
+    {
+        std::cerr << "Couldn't open " << casePath << std::endl;
+        return 1;
+    }
+
+    std::vector<Case> cases;
+    int lineNumber = 0;
+
+    for(std::string line; std::getline(caseStream, line);)
+    {
+        ++lineNumber;
+
+        const size_t firstChar = line.find_first_not_of(" \t\r");
+
+        if(firstChar == std::string::npos || line[firstChar] == '#')
+        {
+            continue;
+        }
+
+        Case testCase;
+
+        if(!parseCase(line, testCase))
+        {
+            std::cerr << casePath << ":" << lineNumber << ": can't read \"" << line << "\"" << std::endl;
+            return 1;
+        }
+
+        cases.push_back(std::move(testCase));
+    }
+
+    int numPassed = 0;
+    int numFailed = 0;
+    int numChecks = 0;
+
+    for(const Case& testCase : cases)
+    {
+        int numCaseFailures = runOnCore(testCase);
+        numChecks += int(testCase.checks.size());
+
+        if(testCase.profile == Chip8Profile::chip8)
+        {
+            numCaseFailures += runOnBatch(testCase);
+            numChecks += int(testCase.checks.size());
+        }
+
+        if(numCaseFailures == 0)
+        {
+            ++numPassed;
+        }
+        else
+        {
+            ++numFailed;
+        }
+    }
+
+    std::cout << numPassed << " passed, " << numFailed << " failed. " << cases.size() << " cases, " << numChecks << " checks" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
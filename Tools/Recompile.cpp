@@ -0,0 +1,476 @@
+/*
+  ==============================================================================
+
+    Recompile.cpp
+    Created: 30 Jul 2022 2:36:08pm
+    Author:  Max Walley
+
+    Compiles a ROM ahead of time into a C++ translation unit implementing
+    Chip8RecompiledAbi.h. Every instruction reachable from 0x200 gets a label
+    and straight line code; jumps, calls and skips become gotos. Anything that
+    touches the display, the random generator or the key wait, and computed
+    BNNN jumps, hand the PC back to the interpreter. Build the output as a
+    shared library and give it to Chip8Core::setRecompiledProgram().
+
+    Usage: Recompile [--schip | --xo] <rom> <output.cpp>
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Disassembler.h"
+#include "../Source/Chip8RecompiledAbi.h"
+#include "../Source/RomAnalyser.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    std::string hex(unsigned value, int digits)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), "0x%0*X", digits, value);
+        return text;
+    }
+
+    std::string label(uint16_t address)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), "op_%04X", address);
+        return text;
+    }
+
+    class Recompiler
+    {
+    public:
+        Recompiler(const std::vector<uint8_t>& machineMemory, Chip8Profile programProfile)
+            : memory(machineMemory), profile(programProfile), analysis(RomAnalyser::analyse(machineMemory, programProfile))
+        {
+        }
+
+        bool isCompiled(uint16_t address) const
+        {
+            return address < memory.size() && analysis.isInstructionStart(address) && canCompile(getOpcode(address));
+        }
+
+        //Every reachable instruction gets a label, the ones that can't be compiled just hand back to the interpreter
+        bool hasLabel(uint16_t address) const
+        {
+            return address < memory.size() && analysis.isInstructionStart(address);
+        }
+
+        //The label written after address's, or memory.size() if it's the last
+        uint32_t getNextLabel(uint16_t address) const
+        {
+            uint32_t next = uint32_t(address) + 1;
+
+            while(next < memory.size() && !hasLabel(uint16_t(next)))
+            {
+                ++next;
+            }
+
+            return next;
+        }
+
+        std::string generate(const std::string& romName, uint64_t romHash) const
+        {
+            std::ostringstream out;
+
+            out << "//Generated by Tools/Recompile from " << romName << ", do not edit\n\n"
+                << "#include \"Chip8RecompiledAbi.h\"\n\n"
+                << "extern \"C\" const uint32_t chip8RecompiledAbiVersion = " << chip8RecompiledCurrentAbiVersion << ";\n"
+                << "extern \"C\" const uint64_t chip8RecompiledRomHash = " << hex(unsigned(romHash >> 32), 8) << "ULL << 32 | " << hex(unsigned(romHash & 0xFFFFFFFF), 8) << "ULL;\n"
+                << "extern \"C\" const uint32_t chip8RecompiledProfile = " << uint32_t(profile) << ";\n"
+                << "extern \"C\" const uint32_t chip8RecompiledMemorySize = " << memory.size() << ";\n\n";
+
+            writeCodeMap(out);
+            writeRunFunction(out);
+
+            return out.str();
+        }
+
+    private:
+        uint16_t getOpcode(uint32_t address) const
+        {
+            return uint16_t((memory[address & (memory.size() - 1)] << 8) | memory[(address + 1) & (memory.size() - 1)]);
+        }
+
+        bool canCompile(uint16_t opcode) const
+        {
+            if(!RomAnalyser::isRecognisedOpcode(opcode, profile))
+            {
+                return false;
+            }
+
+            switch(0xF000 & opcode)
+            {
+                case 0x0000: return opcode == 0x00EE;
+                case 0xB000:
+                case 0xC000:
+                case 0xD000: return false;
+
+                case 0xF000:
+                {
+                    switch(0x00FF & opcode)
+                    {
+                        case 0x0007:
+                        case 0x0015:
+                        case 0x0018:
+                        case 0x001E:
+                        case 0x0029:
+                        case 0x0030:
+                        case 0x0033:
+                        case 0x0055:
+                        case 0x0065:
+                            return true;
+
+                        default:
+                            return false;
+                    }
+                }
+
+                default: return true;
+            }
+        }
+
+        //Any store the program makes over these bytes means the compiled code is out of date
+        void writeCodeMap(std::ostringstream& out) const
+        {
+            out << "extern \"C\" const uint8_t chip8RecompiledCodeMap[" << memory.size() / 8 << "] =\n{";
+
+            for(size_t byte = 0; byte < memory.size() / 8; ++byte)
+            {
+                uint8_t bits = 0;
+
+                for(int bit = 0; bit < 8; ++bit)
+                {
+                    bits |= uint8_t(analysis.isCode(uint16_t(byte * 8 + bit))) << bit;
+                }
+
+                out << (byte % 16 == 0 ? "\n    " : " ") << hex(bits, 2) << ",";
+            }
+
+            out << "\n};\n\n"
+                << "namespace\n{\n"
+                << "    bool storeHitsCode(uint32_t address, int numBytes, uint32_t addressMask)\n    {\n"
+                << "        for(int offset = 0; offset < numBytes; ++offset)\n        {\n"
+                << "            const uint32_t storedTo = (address + offset) & addressMask;\n\n"
+                << "            if((chip8RecompiledCodeMap[storedTo >> 3] >> (storedTo & 7)) & 1)\n            {\n"
+                << "                return true;\n            }\n        }\n\n"
+                << "        return false;\n    }\n}\n\n";
+        }
+
+        void writeRunFunction(std::ostringstream& out) const
+        {
+            out << "extern \"C\" int chip8RecompiledRun(Chip8RecompiledState* state, int maxCycles)\n{\n"
+                << "    uint8_t* const memory = state->memory;\n"
+                << "    const uint32_t addressMask = state->addressMask;\n"
+                << "    uint8_t* const V = state->registers;\n"
+                << "    uint16_t& I = *state->indexRegister;\n"
+                << "    uint16_t& pc = *state->programCounter;\n"
+                << "    uint16_t* const stack = state->stack;\n"
+                << "    uint16_t& sp = *state->stackPointer;\n"
+                << "    uint8_t& delayTimer = *state->delayTimer;\n"
+                << "    uint8_t& soundTimer = *state->soundTimer;\n"
+                << "    const uint16_t keyState = *state->keyState;\n"
+                << "    uint32_t& sideEffectCount = *state->sideEffectCount;\n"
+                << "    int cycles = 0;\n\n"
+                << "dispatch:\n"
+                << "    switch(pc)\n    {\n";
+
+            for(uint32_t address = 0; address < memory.size(); ++address)
+            {
+                if(isCompiled(uint16_t(address)))
+                {
+                    out << "        case " << hex(address, 4) << ": goto " << label(uint16_t(address)) << ";\n";
+                }
+            }
+
+            out << "        default: return cycles;\n    }\n";
+
+            for(uint32_t address = 0; address < memory.size(); ++address)
+            {
+                if(hasLabel(uint16_t(address)))
+                {
+                    writeInstruction(out, uint16_t(address));
+                }
+            }
+
+            out << "}\n";
+        }
+
+        //Leaves the compiled code for target, or carries straight on if it is compiled too
+        std::string jumpTo(uint32_t target) const
+        {
+            target &= 0xFFFF;
+
+            if(hasLabel(uint16_t(target)))
+            {
+                return "goto " + label(uint16_t(target)) + ";";
+            }
+
+            return "pc = " + hex(target, 4) + "; return cycles;";
+        }
+
+        //Matches Chip8Core::skipNextInstruction(), the bytes it looks at are compiled code so can't change unnoticed
+        uint32_t getSkipTarget(uint16_t address) const
+        {
+            const bool nextIsLongLoad = profile == Chip8Profile::xoChip && getOpcode(address + 2) == 0xF000;
+            return address + (nextIsLongLoad ? 6 : 4);
+        }
+
+        void writeInstruction(std::ostringstream& out, uint16_t address) const
+        {
+            const uint16_t opcode = getOpcode(address);
+
+            out << "\n" << label(address) << ": //" << hex(opcode, 4).substr(2) << "  "
+                << Chip8Disassembler::disassemble(opcode, getOpcode(address + 2), profile) << "\n";
+
+            if(!canCompile(opcode))
+            {
+                out << "    pc = " << hex(address, 4) << "; return cycles;\n";
+                return;
+            }
+
+            out << "    if(cycles == maxCycles) {pc = " << hex(address, 4) << "; return cycles;}\n"
+                << "    ++cycles;\n";
+
+            const int x = (0x0F00 & opcode) >> 8;
+            const int y = (0x00F0 & opcode) >> 4;
+            const std::string vx = "V[" + std::to_string(x) + "]";
+            const std::string vy = "V[" + std::to_string(y) + "]";
+            const std::string nn = hex(0x00FF & opcode, 2);
+            const uint16_t nnn = 0x0FFF & opcode;
+            const uint32_t next = address + 2u;
+
+            auto statement = [&out](const std::string& line)
+            {
+                out << "    " << line << "\n";
+            };
+
+            auto skipIf = [&](const std::string& condition)
+            {
+                statement("if(" + condition + ") {" + jumpTo(getSkipTarget(address)) + "}");
+                statement(jumpTo(next));
+            };
+
+            auto storeCheck = [&](const std::string& startAddress, int numBytes)
+            {
+                statement("++sideEffectCount;");
+                statement("if(storeHitsCode(" + startAddress + ", " + std::to_string(numBytes) + ", addressMask)) {state->codeModified = true; pc = " + hex(next & 0xFFFF, 4) + "; return cycles;}");
+            };
+
+            switch(0xF000 & opcode)
+            {
+                case 0x0000:
+                {
+                    statement("sp = (sp - 1) & 0xF;");
+                    statement("pc = uint16_t(stack[sp] + 2);");
+                    statement("goto dispatch;");
+                    return;
+                }
+
+                case 0x1000:
+                {
+                    //Backward jumps go past the core's idle loop check, so spinning ends the frame like it does when interpreted
+                    if(nnn <= address)
+                    {
+                        statement("pc = " + hex(address, 4) + ";");
+                        statement("if(state->checkForIdleLoop(state->core, " + hex(nnn, 3) + ")) {pc = " + hex(nnn, 3) + "; return cycles;}");
+                    }
+
+                    statement(jumpTo(nnn));
+                    return;
+                }
+
+                case 0x2000:
+                {
+                    statement("stack[sp] = " + hex(address, 4) + ";");
+                    statement("sp = (sp + 1) & 0xF;");
+                    statement(jumpTo(nnn));
+                    return;
+                }
+
+                case 0x3000: skipIf(vx + " == " + nn); return;
+                case 0x4000: skipIf(vx + " != " + nn); return;
+
+                case 0x5000:
+                {
+                    const int n = 0x000F & opcode;
+
+                    if(profile == Chip8Profile::xoChip && (n == 0x2 || n == 0x3))
+                    {
+                        const int step = y >= x ? 1 : -1;
+                        int offset = 0;
+
+                        for(int registerIndex = x; ; registerIndex += step, ++offset)
+                        {
+                            const std::string location = "memory[(I + " + std::to_string(offset) + ") & addressMask]";
+                            const std::string reg = "V[" + std::to_string(registerIndex) + "]";
+
+                            statement(n == 0x2 ? location + " = " + reg + ";" : reg + " = " + location + ";");
+
+                            if(registerIndex == y)
+                            {
+                                break;
+                            }
+                        }
+
+                        if(n == 0x2)
+                        {
+                            storeCheck("I", offset + 1);
+                        }
+
+                        statement(jumpTo(next));
+                        return;
+                    }
+
+                    skipIf(vx + " == " + vy);
+                    return;
+                }
+
+                case 0x6000: statement(vx + " = " + nn + ";"); break;
+                case 0x7000: statement(vx + " += " + nn + ";"); break;
+
+                case 0x8000:
+                {
+                    //Like the interpreter, the flag is worked out from the operands first and written last
+                    switch(0x000F & opcode)
+                    {
+                        case 0x0: statement(vx + " = " + vy + ";"); break;
+                        case 0x1: statement(vx + " |= " + vy + ";"); break;
+                        case 0x2: statement(vx + " &= " + vy + ";"); break;
+                        case 0x3: statement(vx + " ^= " + vy + ";"); break;
+                        case 0x4: statement("{const uint8_t flag = " + vx + " + " + vy + " > 0xFF; " + vx + " += " + vy + "; V[15] = flag;}"); break;
+                        case 0x5: statement("{const uint8_t flag = !(" + vy + " > " + vx + "); " + vx + " -= " + vy + "; V[15] = flag;}"); break;
+                        case 0x6: statement("{const uint8_t flag = " + vx + " & 0x1; " + vx + " >>= 1; V[15] = flag;}"); break;
+                        case 0x7: statement("{const uint8_t flag = !(" + vx + " > " + vy + "); " + vx + " = " + vy + " - " + vx + "; V[15] = flag;}"); break;
+                        default:  statement("{const uint8_t flag = (" + vx + " & 0x80) >> 7; " + vx + " <<= 1; V[15] = flag;}"); break;
+                    }
+
+                    break;
+                }
+
+                case 0x9000: skipIf(vx + " != " + vy); return;
+                case 0xA000: statement("I = " + hex(nnn, 3) + ";"); break;
+
+                case 0xE000:
+                {
+                    //Neither skips for a key index past F, so EXA1 isn't just EX9E negated
+                    const std::string keyBit = "(" + vx + " < 16 && ((keyState >> " + vx + ") & 1) ";
+                    skipIf(keyBit + ((0x00FF & opcode) == 0x009E ? "!= 0)" : "== 0)"));
+                    return;
+                }
+
+                default:
+                {
+                    switch(0x00FF & opcode)
+                    {
+                        case 0x0007: statement(vx + " = delayTimer;"); break;
+                        case 0x0015: statement("delayTimer = " + vx + ";"); statement("++sideEffectCount;"); break;
+                        case 0x0018: statement("soundTimer = " + vx + ";"); statement("++sideEffectCount;"); break;
+                        case 0x001E: statement("I += " + vx + ";"); break;
+                        case 0x0029: statement("I = " + vx + " * 0x5;"); break;
+                        case 0x0030: statement("I = " + hex(Chip8Core::hiResFontStart, 2) + " + (0x0F & " + vx + ") * 10;"); break;
+
+                        case 0x0033:
+                        {
+                            statement("memory[I & addressMask] = " + vx + " / 100;");
+                            statement("memory[(I + 1) & addressMask] = (" + vx + " / 10) % 10;");
+                            statement("memory[(I + 2) & addressMask] = " + vx + " % 10;");
+                            storeCheck("I", 3);
+                            break;
+                        }
+
+                        case 0x0055:
+                        {
+                            for(int registerIndex = 0; registerIndex <= x; ++registerIndex)
+                            {
+                                statement("memory[(I + " + std::to_string(registerIndex) + ") & addressMask] = V[" + std::to_string(registerIndex) + "];");
+                            }
+
+                            storeCheck("I", x + 1);
+                            break;
+                        }
+
+                        default:
+                        {
+                            for(int registerIndex = 0; registerIndex <= x; ++registerIndex)
+                            {
+                                statement("V[" + std::to_string(registerIndex) + "] = memory[(I + " + std::to_string(registerIndex) + ") & addressMask];");
+                            }
+
+                            break;
+                        }
+                    }
+
+                    break;
+                }
+            }
+
+            //Falling into the next label needs no jump, as long as no instruction starting at an odd address sits in between
+            if(getNextLabel(address) != next)
+            {
+                statement(jumpTo(next));
+            }
+        }
+
+        const std::vector<uint8_t>& memory;
+        const Chip8Profile profile;
+        const RomAnalysis analysis;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    Chip8Profile profile = Chip8Profile::chip8;
+    int romArg = 1;
+
+    if(argc > 1 && std::string(argv[1]) == "--schip")
+    {
+        profile = Chip8Profile::superChip;
+        romArg = 2;
+    }
+    else if(argc > 1 && std::string(argv[1]) == "--xo")
+    {
+        profile = Chip8Profile::xoChip;
+        romArg = 2;
+    }
+
+    if(argc != romArg + 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--schip | --xo] <rom> <output.cpp>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream romStream(argv[romArg], std::ios::binary);
+
+    if(!romStream.is_open())
+    {
+        std::cerr << "Couldn't open " << argv[romArg] << std::endl;
+        return 1;
+    }
+
+    const std::vector<uint8_t> program {std::istreambuf_iterator<char>(romStream), std::istreambuf_iterator<char>()};
+
+    //Analyse the machine image the core will actually run, fonts and all
+    Chip8Core core;
+    core.setProfile(profile);
+    core.load(program.data(), program.size());
+
+    const Recompiler recompiler(core.getMemory(), profile);
+
+    std::ofstream output(argv[romArg + 1]);
+    output << recompiler.generate(argv[romArg], chip8RecompiledHash(program.data(), program.size()));
+
+    if(!output)
+    {
+        std::cerr << "Couldn't write " << argv[romArg + 1] << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
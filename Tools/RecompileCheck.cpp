@@ -0,0 +1,212 @@
+/*
+  ==============================================================================
+
+    RecompileCheck.cpp
+    Created: 6 Aug 2022 11:14:52am
+    Author:  Max Walley
+
+    Runs a ROM interpreted and through a library built from Tools/Recompile
+    output side by side, with frame hashing on, and reports the first frame
+    their hashes differ on. The keys change every few frames from a fixed
+    sequence so both sides of EX9E, EXA1 and FX0A get taken. Exits with 1 on
+    a difference, or if the library can't run the ROM.
+
+    Usage: RecompileCheck [--schip | --xo] [--frames <count>] [--cycles <per frame>] <rom> <library>
+
+  ==============================================================================
+*/
+
+#include "../Source/RecompiledProgram.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //Mostly one key at a time with the odd chord and stretches of nothing, like someone playing
+    uint16_t nextKeyState(uint32_t& generatorState)
+    {
+        generatorState = generatorState * 1664525u + 1013904223u;
+        const uint32_t bits = generatorState >> 16;
+
+        switch(bits % 4)
+        {
+            case 0:  return 0;
+            case 1:  return uint16_t(bits >> 2);
+            default: return uint16_t(1 << ((bits >> 2) % 16));
+        }
+    }
+
+    void printDifference(const char* what, int interpreted, int recompiled)
+    {
+        std::cout << "    " << what << ": interpreted 0x" << std::hex << interpreted << ", recompiled 0x" << recompiled << std::dec << std::endl;
+    }
+
+    void printDifferences(const Chip8Core& interpreted, const Chip8Core& recompiled)
+    {
+        if(interpreted.getProgramCounter() != recompiled.getProgramCounter())
+        {
+            printDifference("PC", interpreted.getProgramCounter(), recompiled.getProgramCounter());
+        }
+
+        if(interpreted.getIndexRegister() != recompiled.getIndexRegister())
+        {
+            printDifference("I", interpreted.getIndexRegister(), recompiled.getIndexRegister());
+        }
+
+        for(int registerIndex = 0; registerIndex < 16; ++registerIndex)
+        {
+            if(interpreted.getRegister(registerIndex) != recompiled.getRegister(registerIndex))
+            {
+                const std::string name = "V" + std::string(1, "0123456789ABCDEF"[registerIndex]);
+                printDifference(name.c_str(), interpreted.getRegister(registerIndex), recompiled.getRegister(registerIndex));
+            }
+        }
+
+        if(interpreted.getStackPointer() != recompiled.getStackPointer() || interpreted.getStack() != recompiled.getStack())
+        {
+            printDifference("SP", interpreted.getStackPointer(), recompiled.getStackPointer());
+        }
+
+        if(interpreted.getDelayTimer() != recompiled.getDelayTimer() || interpreted.getSoundTimer() != recompiled.getSoundTimer())
+        {
+            printDifference("DT", interpreted.getDelayTimer(), recompiled.getDelayTimer());
+            printDifference("ST", interpreted.getSoundTimer(), recompiled.getSoundTimer());
+        }
+
+        const std::vector<uint8_t>& interpretedMemory = interpreted.getMemory();
+        const std::vector<uint8_t>& recompiledMemory = recompiled.getMemory();
+
+        for(size_t address = 0; address < interpretedMemory.size(); ++address)
+        {
+            if(interpretedMemory[address] != recompiledMemory[address])
+            {
+                std::cout << "    memory from 0x" << std::hex << address << std::dec << std::endl;
+                break;
+            }
+        }
+
+        if(interpreted.getFramebuffer() != recompiled.getFramebuffer())
+        {
+            std::cout << "    display" << std::endl;
+        }
+
+        if(interpreted.getCycleCount() != recompiled.getCycleCount())
+        {
+            std::cout << "    cycles: interpreted " << interpreted.getCycleCount() << ", recompiled " << recompiled.getCycleCount() << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Chip8Profile profile = Chip8Profile::chip8;
+    int numFrames = 3600;
+    int cyclesPerFrame = 20;
+    int firstPath = 1;
+
+    for(; firstPath < argc - 2; ++firstPath)
+    {
+        const std::string option = argv[firstPath];
+
+        if(option == "--schip")
+        {
+            profile = Chip8Profile::superChip;
+        }
+        else if(option == "--xo")
+        {
+            profile = Chip8Profile::xoChip;
+        }
+        else if(option == "--frames" && firstPath + 3 < argc)
+        {
+            numFrames = std::stoi(argv[++firstPath]);
+        }
+        else if(option == "--cycles" && firstPath + 3 < argc)
+        {
+            cyclesPerFrame = std::max(std::stoi(argv[++firstPath]), 1);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if(firstPath != argc - 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--schip | --xo] [--frames <count>] [--cycles <per frame>] <rom> <library>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream romStream(argv[firstPath], std::ios::binary);
+
+    if(!romStream)
+    {
+        std::cerr << "Couldn't open " << argv[firstPath] << std::endl;
+        return 1;
+    }
+
+    const std::vector<uint8_t> program {std::istreambuf_iterator<char>(romStream), std::istreambuf_iterator<char>()};
+
+    RecompiledProgram recompiledProgram;
+
+    if(!recompiledProgram.open(argv[firstPath + 1]))
+    {
+        std::cerr << "Couldn't open " << argv[firstPath + 1] << " as a recompiled program" << std::endl;
+        return 1;
+    }
+
+    Chip8Core interpreted;
+    Chip8Core recompiled;
+
+    //Same seed, so CXNN draws the same numbers on both
+    for(Chip8Core* core : {&interpreted, &recompiled})
+    {
+        core->setProfile(profile);
+        core->setCyclesPerFrame(cyclesPerFrame);
+        core->setSeed(0);
+        core->load(program.data(), program.size());
+        core->setFrameHashing(true);
+    }
+
+    recompiled.setRecompiledProgram(&recompiledProgram);
+
+    if(!recompiled.isRunningRecompiled())
+    {
+        std::cerr << argv[firstPath + 1] << " wasn't compiled from " << argv[firstPath] << " for this profile" << std::endl;
+        return 1;
+    }
+
+    uint32_t keyGenerator = 0;
+    uint16_t keyState = 0;
+
+    for(int frame = 0; frame < numFrames; ++frame)
+    {
+        if(frame % 5 == 0)
+        {
+            keyState = nextKeyState(keyGenerator);
+        }
+
+        interpreted.setKeyState(keyState);
+        recompiled.setKeyState(keyState);
+
+        interpreted.runFrame();
+        recompiled.runFrame();
+
+        if(interpreted.getFrameHash() != recompiled.getFrameHash())
+        {
+            std::cout << argv[firstPath] << ": differs on frame " << frame << ", keys 0x" << std::hex << std::setw(4) << std::setfill('0') << keyState << std::dec << std::endl;
+            printDifferences(interpreted, recompiled);
+            return 1;
+        }
+    }
+
+    //Self modifying code hands everything back to the interpreter, which says nothing about the compiled code after it
+    std::cout << argv[firstPath] << ": ok, " << interpreted.getCycleCount() << " cycles"
+              << (recompiled.isRunningRecompiled() ? "" : ", the ROM modified itself so the end ran interpreted") << std::endl;
+
+    return 0;
+}
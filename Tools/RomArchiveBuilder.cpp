@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    RomArchiveBuilder.cpp
+    Created: 2 May 2022 9:41:55pm
+    Author:  Max Walley
+
+    Packs every file in a directory into a single ROM archive. Names too long
+    for an entry are truncated, and it fails if two files end up with the
+    same name.
+
+    Usage: RomArchiveBuilder <romDirectory> <outputFile> [quirkProfile]
+
+  ==============================================================================
+*/
+
+#include "../Source/RomArchive.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <romDirectory> <outputFile> [quirkProfile]" << std::endl;
+        return 1;
+    }
+    
+    const std::filesystem::path romDirectory(argv[1]);
+    const uint32_t quirkProfile = argc > 3 ? uint32_t(std::stoul(argv[3])) : 0;
+    
+    if(!std::filesystem::is_directory(romDirectory))
+    {
+        std::cerr << romDirectory << " is not a directory" << std::endl;
+        return 1;
+    }
+    
+    std::vector<RomArchive::SourceRom> roms;
+    
+    //Stored name to the file name it came from
+    std::map<std::string, std::string> storedNames;
+    bool namesCollide = false;
+    
+    for(const auto& dirEntry : std::filesystem::directory_iterator(romDirectory))
+    {
+        if(!dirEntry.is_regular_file())
+        {
+            continue;
+        }
+        
+        std::ifstream fileStream(dirEntry.path(), std::ios::binary);
+        
+        RomArchive::SourceRom rom;
+        rom.name = dirEntry.path().filename().string();
+        rom.data.assign(std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>());
+        rom.quirkProfile = quirkProfile;
+        
+        const std::string storedName = RomArchive::getStoredName(rom.name);
+        
+        if(storedName != rom.name)
+        {
+            std::cerr << "Warning: name of " << rom.name << " will be truncated" << std::endl;
+        }
+        
+        const auto [existing, inserted] = storedNames.emplace(storedName, rom.name);
+        
+        if(!inserted)
+        {
+            std::cerr << "Error: " << existing->second << " and " << rom.name << " would both be stored as " << storedName << std::endl;
+            namesCollide = true;
+        }
+        
+        roms.push_back(std::move(rom));
+    }
+    
+    if(namesCollide)
+    {
+        std::cerr << "Rename the files so their first " << sizeof(RomArchiveEntry::name) << " characters differ" << std::endl;
+        return 1;
+    }
+    
+    const size_t numRoms = roms.size();
+    
+    if(!RomArchive::write(argv[2], std::move(roms)))
+    {
+        std::cerr << "Failed to write " << argv[2] << std::endl;
+        return 1;
+    }
+    
+    std::cout << "Packed " << numRoms << " ROMs into " << argv[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    RomCheck.cpp
+    Created: 8 May 2022 5:02:47pm
+    Author:  Max Walley
+
+    Statically analyses ROMs and reports anything that would go wrong at run
+    time. Exits with 1 if any ROM isn't runnable.
+
+    Usage: RomCheck [--schip | --xo] <rom> [rom...]
+
+  ==============================================================================
+*/
+
+#include "../Source/RomAnalyser.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace
+{
+    void printAddresses(const char* label, const std::vector<uint16_t>& addresses)
+    {
+        if(addresses.empty())
+        {
+            return;
+        }
+        
+        std::cout << "    " << label << ":" << std::hex;
+        
+        for(const uint16_t address : addresses)
+        {
+            std::cout << " 0x" << address;
+        }
+        
+        std::cout << std::dec << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Chip8Profile profile = Chip8Profile::chip8;
+    int firstRom = 1;
+    
+    if(argc > 1 && std::string(argv[1]) == "--schip")
+    {
+        profile = Chip8Profile::superChip;
+        firstRom = 2;
+    }
+    else if(argc > 1 && std::string(argv[1]) == "--xo")
+    {
+        profile = Chip8Profile::xoChip;
+        firstRom = 2;
+    }
+    
+    if(argc <= firstRom)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--schip | --xo] <rom> [rom...]" << std::endl;
+        return 1;
+    }
+
+    bool allRunnable = true;
+    
+    for(int arg = firstRom; arg < argc; ++arg)
+    {
+        std::ifstream fileStream(argv[arg], std::ios::binary);
+        
+        if(!fileStream.is_open())
+        {
+            std::cerr << "Couldn't open " << argv[arg] << std::endl;
+            allRunnable = false;
+            continue;
+        }
+        
+        const std::vector<uint8_t> program {std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>()};
+        const RomAnalysis analysis = RomAnalyser::analyseProgram(program.data(), program.size(), profile);
+        
+        int numCodeBytes = 0;
+        
+        for(size_t address = Chip8Core::programStart; address < analysis.byteFlags.size(); ++address)
+        {
+            numCodeBytes += analysis.isCode(address);
+        }
+        
+        std::cout << argv[arg] << ": " << (analysis.isRunnable() ? "ok" : "BROKEN") << ", " << numCodeBytes << " of " << program.size() << " bytes reachable as code" << std::endl;
+        
+        printAddresses("Unrecognised opcodes", analysis.unrecognisedOpcodeAddresses);
+        printAddresses("Fetches past end of memory", analysis.outOfBoundsAddresses);
+        printAddresses("Self modifying stores", analysis.selfModifyingWriteAddresses);
+        printAddresses("Computed jumps", analysis.computedJumpAddresses);
+        
+        if(analysis.hasUnresolvedWrites)
+        {
+            std::cout << "    Has stores through an unknown I" << std::endl;
+        }
+        
+        allRunnable &= analysis.isRunnable();
+    }
+    
+    return allRunnable ? 0 : 1;
+}
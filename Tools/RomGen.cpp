@@ -0,0 +1,398 @@
+/*
+  ==============================================================================
+
+    RomGen.cpp
+    Created: 6 Aug 2022 3:40:27pm
+    Author:  Max Walley
+
+    Writes random but valid ROMs for a profile, for the conformance golden
+    file and for checking one way of running a ROM against another. Every
+    instruction decodes for the profile, direct jumps land on instructions,
+    calls go to subroutines that always return, BNNN stays inside the
+    program whatever V0 is, and I mostly points at the fonts or a block of
+    data after the code, so the ROMs keep drawing and branching instead of
+    dying on the first bad opcode. A seed always gives the same ROM on any
+    platform, so only the seeds need keeping. --no-random leaves out CXNN,
+    for runs against Chip8Batch, which has its own generator.
+
+    Each ROM is named <profile>-<seed>.ch8, and a golden file line for it is
+    printed with a hash of - and keys that change every second or so, ready
+    for Conformance --update.
+
+    Usage: RomGen [--schip | --xo] [--no-random] [--seed <first seed>] <count> <output directory>
+
+  ==============================================================================
+*/
+
+#include "../Source/Chip8Core.h"
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    enum class OpKind
+    {
+        clear, jump, call, skipEqualByte, skipNotEqualByte, skipEqual, setByte, addByte, alu, skipNotEqual,
+        setIndex, jumpOffset, random, draw, skipKey, waitKey, timers, addIndex, digit, bcd, store, loadRegisters,
+        scrollDown, scrollSideways, resolution, bigDigit, saveFlags, loadFlags,
+        storeRange, loadRange, longLoad, selectPlanes, scrollUp
+    };
+
+    class RomGenerator
+    {
+    public:
+        RomGenerator(uint32_t seed, Chip8Profile romProfile, bool useRandomOpcode) : random(seed), profile(romProfile)
+        {
+            //Weights are how many times each kind appears, so roughly how often it turns up in a ROM.
+            //00EE only ends subroutines, a stray one would return through an empty stack
+            addKind(OpKind::clear, 1);
+            addKind(OpKind::jump, 3);
+            addKind(OpKind::call, 2);
+            addKind(OpKind::skipEqualByte, 3);
+            addKind(OpKind::skipNotEqualByte, 3);
+            addKind(OpKind::skipEqual, 2);
+            addKind(OpKind::setByte, 6);
+            addKind(OpKind::addByte, 6);
+            addKind(OpKind::alu, 8);
+            addKind(OpKind::skipNotEqual, 2);
+            addKind(OpKind::setIndex, 4);
+            addKind(OpKind::jumpOffset, 1);
+            addKind(OpKind::random, useRandomOpcode ? 2 : 0);
+            addKind(OpKind::draw, 6);
+            addKind(OpKind::skipKey, 4);
+            addKind(OpKind::waitKey, 1);
+            addKind(OpKind::timers, 3);
+            addKind(OpKind::addIndex, 2);
+            addKind(OpKind::digit, 2);
+            addKind(OpKind::bcd, 1);
+            addKind(OpKind::store, 1);
+            addKind(OpKind::loadRegisters, 1);
+
+            //00FD is left out, a ROM that exits early has nothing left to check
+            if(profile != Chip8Profile::chip8)
+            {
+                addKind(OpKind::scrollDown, 1);
+                addKind(OpKind::scrollSideways, 1);
+                addKind(OpKind::resolution, 1);
+                addKind(OpKind::bigDigit, 1);
+                addKind(OpKind::saveFlags, 1);
+                addKind(OpKind::loadFlags, 1);
+            }
+
+            if(profile == Chip8Profile::xoChip)
+            {
+                addKind(OpKind::storeRange, 1);
+                addKind(OpKind::loadRange, 1);
+                addKind(OpKind::longLoad, 1);
+                addKind(OpKind::selectPlanes, 2);
+                addKind(OpKind::scrollUp, 1);
+            }
+        }
+
+        //The main code, then the subroutines it calls, then a block of data
+        std::vector<uint8_t> generate()
+        {
+            //At least 128 past where BNNN can go, V0 reaches 255 bytes further
+            numInstructions = 160 + int(below(352));
+
+            int subroutineSlot = numInstructions;
+            std::vector<int> subroutineLengths;
+
+            for(int subroutine = 0; subroutine < numSubroutines; ++subroutine)
+            {
+                subroutineLengths.push_back(2 + int(below(7)));
+                subroutineStarts[subroutine] = slotAddress(subroutineSlot);
+                subroutineSlot += subroutineLengths.back() + 1;
+            }
+
+            dataStart = slotAddress(subroutineSlot);
+
+            std::vector<uint8_t> program;
+            program.reserve(size_t(dataStart - Chip8Core::programStart) + dataSize);
+
+            //The last two slots jump back to the start, so nothing runs off the end even after a skip
+            for(int instruction = 0; instruction < numInstructions - 2; ++instruction)
+            {
+                const uint16_t opcode = generateOpcode(kinds);
+                pushWord(program, opcode);
+
+                //The long load's address takes the next slot
+                if(opcode == 0xF000 && instruction + 1 < numInstructions - 2)
+                {
+                    pushWord(program, randomIndex());
+                    ++instruction;
+                }
+            }
+
+            pushWord(program, 0x1000 | Chip8Core::programStart);
+            pushWord(program, 0x1000 | Chip8Core::programStart);
+
+            for(const int length : subroutineLengths)
+            {
+                for(int instruction = 0; instruction < length; ++instruction)
+                {
+                    pushWord(program, generateOpcode(straightKinds));
+                }
+
+                pushWord(program, 0x00EE);
+            }
+
+            //Sprites to draw and room for stores, so they mostly leave the code alone
+            for(int byte = 0; byte < dataSize; ++byte)
+            {
+                program.push_back(uint8_t(below(0x100)));
+            }
+
+            return program;
+        }
+
+        //Frames to run for, cycles per frame and the key changes for the golden file line
+        std::string generateGoldenFields(int numFrames)
+        {
+            static constexpr int cycleRates[] = {7, 15, 30};
+            std::string fields = std::to_string(numFrames) + " " + std::to_string(cycleRates[below(3)]) + " -";
+
+            for(int frame = int(below(60)); frame < numFrames; frame += 20 + int(below(60)))
+            {
+                char keyChange[16];
+                std::snprintf(keyChange, sizeof(keyChange), " %d:%x", frame, unsigned(randomKeyState()));
+                fields += keyChange;
+            }
+
+            return fields;
+        }
+
+    private:
+        static constexpr int numSubroutines = 8;
+        static constexpr int dataSize = 256;
+
+        //Subroutines run straight through to their 00EE, so they can't skip or jump past it.
+        //The long load is left out too, its address word would be run as an instruction
+        static bool isStraightLine(OpKind kind)
+        {
+            switch(kind)
+            {
+                case OpKind::jump:
+                case OpKind::call:
+                case OpKind::skipEqualByte:
+                case OpKind::skipNotEqualByte:
+                case OpKind::skipEqual:
+                case OpKind::skipNotEqual:
+                case OpKind::jumpOffset:
+                case OpKind::skipKey:
+                case OpKind::longLoad:
+                    return false;
+
+                default:
+                    return true;
+            }
+        }
+
+        void addKind(OpKind kind, int weight)
+        {
+            kinds.insert(kinds.end(), size_t(weight), kind);
+
+            if(isStraightLine(kind))
+            {
+                straightKinds.insert(straightKinds.end(), size_t(weight), kind);
+            }
+        }
+
+        static void pushWord(std::vector<uint8_t>& program, int word)
+        {
+            program.push_back(uint8_t(word >> 8));
+            program.push_back(uint8_t(word & 0xFF));
+        }
+
+        static uint16_t slotAddress(int slot)
+        {
+            return uint16_t(Chip8Core::programStart + slot * 2);
+        }
+
+        //The raw output is the same everywhere, unlike the standard distributions
+        uint32_t below(uint32_t limit)
+        {
+            return uint32_t(random() % limit);
+        }
+
+        //Somewhere in the main code, leaving slotsAfter slots after it
+        uint16_t target(int slotsAfter = 0)
+        {
+            return slotAddress(int(below(uint32_t(numInstructions - slotsAfter))));
+        }
+
+        uint16_t randomIndex()
+        {
+            switch(below(8))
+            {
+                case 0:  return uint16_t(below(profile == Chip8Profile::xoChip ? 0x10000 : 0x1000));
+                case 1:  return uint16_t(Chip8Core::programStart + below(uint32_t(dataStart - Chip8Core::programStart)));
+                case 2:
+                case 3:  return uint16_t(below(Chip8Core::hiResFontStart + 160));
+                default: return uint16_t(dataStart + below(dataSize));
+            }
+        }
+
+        uint16_t randomKeyState()
+        {
+            switch(below(4))
+            {
+                case 0:  return 0;
+                case 1:  return uint16_t(below(0x10000));
+                default: return uint16_t(1 << below(16));
+            }
+        }
+
+        uint16_t generateOpcode(const std::vector<OpKind>& from)
+        {
+            static constexpr uint16_t aluOps[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+            static constexpr uint16_t timerOps[] = {0x07, 0x15, 0x18};
+
+            //Every field is drawn up front, a statement each, since the order operands are evaluated in isn't fixed
+            const OpKind kind = from[below(uint32_t(from.size()))];
+            const uint16_t x = uint16_t(below(16) << 8);
+            const uint16_t y = uint16_t(below(16) << 4);
+            const uint16_t n = uint16_t(below(16));
+            const uint16_t byte = uint16_t(below(0x100));
+            const bool coin = below(2) == 0;
+            const uint16_t address = target();
+            const uint16_t offsetAddress = target(128);
+            const uint16_t subroutine = subroutineStarts[below(numSubroutines)];
+            const uint16_t index = randomIndex();
+
+            //Small values so equality skips go both ways
+            const uint16_t smallByte = n & 0x3;
+
+            switch(kind)
+            {
+                case OpKind::clear:            return 0x00E0;
+                case OpKind::jump:             return uint16_t(0x1000 | address);
+                case OpKind::call:             return uint16_t(0x2000 | subroutine);
+                case OpKind::skipEqualByte:    return uint16_t(0x3000 | x | smallByte);
+                case OpKind::skipNotEqualByte: return uint16_t(0x4000 | x | smallByte);
+                case OpKind::skipEqual:        return uint16_t(0x5000 | x | y);
+                case OpKind::setByte:          return uint16_t(0x6000 | x | (coin ? smallByte : byte));
+                case OpKind::addByte:          return uint16_t(0x7000 | x | byte);
+                case OpKind::alu:              return uint16_t(0x8000 | x | y | aluOps[n % 9]);
+                case OpKind::skipNotEqual:     return uint16_t(0x9000 | x | y);
+                case OpKind::setIndex:         return uint16_t(0xA000 | (index & 0x0FFF));
+                case OpKind::jumpOffset:       return uint16_t(0xB000 | offsetAddress);
+                case OpKind::random:           return uint16_t(0xC000 | x | byte);
+                case OpKind::draw:             return uint16_t(0xD000 | x | y | n);
+                case OpKind::skipKey:          return uint16_t(0xE000 | x | (coin ? 0x9E : 0xA1));
+                case OpKind::waitKey:          return uint16_t(0xF00A | x);
+                case OpKind::timers:           return uint16_t(0xF000 | x | timerOps[n % 3]);
+                case OpKind::addIndex:         return uint16_t(0xF01E | x);
+                case OpKind::digit:            return uint16_t(0xF029 | x);
+                case OpKind::bcd:              return uint16_t(0xF033 | x);
+                case OpKind::store:            return uint16_t(0xF055 | x);
+                case OpKind::loadRegisters:    return uint16_t(0xF065 | x);
+                case OpKind::scrollDown:       return uint16_t(0x00C0 | n);
+                case OpKind::scrollSideways:   return uint16_t(coin ? 0x00FB : 0x00FC);
+                case OpKind::resolution:       return uint16_t(coin ? 0x00FE : 0x00FF);
+                case OpKind::bigDigit:         return uint16_t(0xF030 | x);
+                case OpKind::saveFlags:        return uint16_t(0xF075 | ((n & 0x7) << 8));
+                case OpKind::loadFlags:        return uint16_t(0xF085 | ((n & 0x7) << 8));
+                case OpKind::storeRange:       return uint16_t(0x5002 | x | y);
+                case OpKind::loadRange:        return uint16_t(0x5003 | x | y);
+                case OpKind::longLoad:         return 0xF000;
+                case OpKind::selectPlanes:     return uint16_t(0xF001 | ((n & 0x3) << 8));
+                case OpKind::scrollUp:         return uint16_t(0x00D0 | n);
+            }
+
+            return 0x00E0;
+        }
+
+        std::mt19937 random;
+        Chip8Profile profile;
+        std::vector<OpKind> kinds;
+        std::vector<OpKind> straightKinds;
+
+        int numInstructions = 0;
+        std::array<uint16_t, numSubroutines> subroutineStarts {};
+        uint16_t dataStart = 0;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    Chip8Profile profile = Chip8Profile::chip8;
+    std::string profileName = "chip8";
+    bool useRandomOpcode = true;
+    uint32_t firstSeed = 1;
+    int firstArg = 1;
+
+    for(; firstArg < argc - 2; ++firstArg)
+    {
+        const std::string option = argv[firstArg];
+
+        if(option == "--schip")
+        {
+            profile = Chip8Profile::superChip;
+            profileName = "schip";
+        }
+        else if(option == "--xo")
+        {
+            profile = Chip8Profile::xoChip;
+            profileName = "xo";
+        }
+        else if(option == "--no-random")
+        {
+            useRandomOpcode = false;
+        }
+        else if(option == "--seed" && firstArg + 3 < argc)
+        {
+            firstSeed = uint32_t(std::stoul(argv[++firstArg]));
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if(firstArg != argc - 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--schip | --xo] [--no-random] [--seed <first seed>] <count> <output directory>" << std::endl;
+        return 1;
+    }
+
+    const int numRoms = std::stoi(argv[firstArg]);
+    std::string outputDirectory = argv[firstArg + 1];
+
+    if(!outputDirectory.empty() && outputDirectory.back() != '/' && outputDirectory.back() != '\\')
+    {
+        outputDirectory += '/';
+    }
+
+    //Ten seconds at 60Hz
+    constexpr int numFrames = 600;
+
+    for(int romIndex = 0; romIndex < numRoms; ++romIndex)
+    {
+        const uint32_t seed = firstSeed + uint32_t(romIndex);
+
+        char romName[32];
+        std::snprintf(romName, sizeof(romName), "%s-%04u.ch8", profileName.c_str(), unsigned(seed));
+
+        RomGenerator generator(seed, profile, useRandomOpcode);
+        const std::vector<uint8_t> program = generator.generate();
+
+        std::ofstream romStream(outputDirectory + romName, std::ios::binary);
+        romStream.write(reinterpret_cast<const char*>(program.data()), std::streamsize(program.size()));
+
+        if(!romStream)
+        {
+            std::cerr << "Couldn't write " << outputDirectory + romName << std::endl;
+            return 1;
+        }
+
+        std::cout << romName << " " << profileName << " " << generator.generateGoldenFields(numFrames) << std::endl;
+    }
+
+    return 0;
+}
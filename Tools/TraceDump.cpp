@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    TraceDump.cpp
+    Created: 2 Jul 2022 6:35:21pm
+    Author:  Max Walley
+
+    Decodes an instruction trace written by TraceRecorder into one line per
+    instruction: cycle, PC, opcode, I and the register it changed.
+
+    Usage: TraceDump [--last <count>] <trace>
+
+  ==============================================================================
+*/
+
+#include "../Source/TraceRecorder.h"
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+    size_t lastCount = 0;
+    int traceArg = 1;
+
+    if(argc > 2 && std::string(argv[1]) == "--last")
+    {
+        lastCount = std::stoul(argv[2]);
+        traceArg = 3;
+    }
+
+    if(argc <= traceArg)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--last <count>] <trace>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream traceStream(argv[traceArg], std::ios::binary);
+    TraceFileHeader header;
+
+    if(!traceStream.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "C8TR", 4) != 0
+       || header.version != TraceRecorder::currentVersion || header.recordSize != sizeof(uint64_t))
+    {
+        std::cerr << argv[traceArg] << " isn't a version " << TraceRecorder::currentVersion << " trace" << std::endl;
+        return 1;
+    }
+
+    //With --last only the tail is kept, so huge traces don't all have to fit in memory
+    std::deque<std::string> lines;
+    uint64_t cycle = 0;
+    uint64_t numInstructions = 0;
+    uint64_t record;
+
+    auto output = [&lines, lastCount](std::string line)
+    {
+        if(lastCount == 0)
+        {
+            std::cout << line << '\n';
+            return;
+        }
+
+        lines.push_back(std::move(line));
+
+        if(lines.size() > lastCount)
+        {
+            lines.pop_front();
+        }
+    };
+
+    while(traceStream.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        const uint64_t kind = record >> traceKindShift;
+        const uint64_t payload = record & ((uint64_t(1) << traceKindShift) - 1);
+
+        if(kind == traceSyncKind)
+        {
+            cycle = payload;
+            continue;
+        }
+
+        if(kind == traceDroppedKind)
+        {
+            output("-- " + std::to_string(payload) + " records dropped while tracing --");
+            continue;
+        }
+
+        std::ostringstream line;
+        line << std::setw(12) << cycle << std::hex << std::uppercase << std::setfill('0')
+             << "  " << std::setw(4) << (record & 0xFFFF)
+             << "  " << std::setw(4) << ((record >> 16) & 0xFFFF)
+             << "  I=" << std::setw(4) << ((record >> 32) & 0xFFFF);
+
+        if((record & traceRegisterChangedBit) != 0)
+        {
+            line << "  V" << ((record >> 48) & 0xF) << "=" << std::setw(2) << ((record >> 52) & 0xFF);
+        }
+
+        output(line.str());
+
+        ++cycle;
+        ++numInstructions;
+    }
+
+    for(const auto& line : lines)
+    {
+        std::cout << line << '\n';
+    }
+
+    std::cout << numInstructions << " instructions" << std::endl;
+
+    return 0;
+}